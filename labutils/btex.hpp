@@ -0,0 +1,62 @@
+#pragma once
+
+// Simple container for block-compressed textures with a full mip chain.
+//
+// The file is produced offline by the texconv tool (see tools/texconv) and
+// consumed by load_image_textures2d(). This header is shared by both, and
+// therefore must not depend on Vulkan.
+//
+// Layout (all values little-endian):
+//   - BtexHeader
+//   - BtexLevel[mipCount], level 0 = full resolution
+//   - Mip level data, at the offsets given by each BtexLevel
+//
+// Images are stored bottom row first, i.e., flipped vertically, matching
+// what load_image_texture2d() uploads for regular images.
+
+#include <cstdint>
+
+namespace labutils
+{
+	namespace btex
+	{
+		constexpr char kMagic[4] = { 'B', 'T', 'E', 'X' };
+		constexpr std::uint32_t kVersion = 1;
+
+		// Texture file extension; appended to the source image path (e.g.,
+		// "brick.jpg" -> "brick.jpg.btex").
+		constexpr char const* kExtension = ".btex";
+
+		enum class Format : std::uint32_t
+		{
+			bc1RgbaSrgb = 1, // VK_FORMAT_BC1_RGBA_SRGB_BLOCK; 8 bytes per 4x4 block
+		};
+
+		struct Header
+		{
+			char magic[4];
+			std::uint32_t version;
+			Format format;
+			std::uint32_t width;
+			std::uint32_t height;
+			std::uint32_t mipCount;
+		};
+
+		struct Level
+		{
+			std::uint64_t offset; // From the start of the file
+			std::uint64_t size;
+			std::uint32_t width;
+			std::uint32_t height;
+		};
+
+		static_assert( sizeof(Header) == 24 );
+		static_assert( sizeof(Level) == 24 );
+
+		// Size in bytes of a BC1 compressed level
+		constexpr std::uint64_t bc1_level_size( std::uint32_t aWidth, std::uint32_t aHeight )
+		{
+			return std::uint64_t((aWidth+3)/4) * std::uint64_t((aHeight+3)/4) * 8;
+		}
+	}
+}
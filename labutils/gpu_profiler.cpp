@@ -0,0 +1,252 @@
+#include "gpu_profiler.hpp"
+
+#include <limits>
+#include <cassert>
+#include <algorithm>
+
+#include "error.hpp"
+#include "to_string.hpp"
+
+
+
+namespace labutils
+{
+	GpuProfiler::GpuProfiler( VulkanContext const& aContext, std::uint32_t aFrameCount, std::uint32_t aMaxScopesPerFrame )
+		: mDevice( aContext.device )
+	{
+		assert( aFrameCount > 0 );
+
+		mFrame.name = "Frame";
+		mFrame.history.resize( kHistoryLength, 0.f );
+
+		// Timestamps must be supported by the queue that the frames are
+		// submitted to
+		std::uint32_t familyCount = 0;
+		vkGetPhysicalDeviceQueueFamilyProperties( aContext.physicalDevice, &familyCount, nullptr );
+
+		std::vector<VkQueueFamilyProperties> families( familyCount );
+		vkGetPhysicalDeviceQueueFamilyProperties( aContext.physicalDevice, &familyCount, families.data() );
+
+		assert( aContext.graphicsFamilyIndex < familyCount );
+		std::uint32_t const validBits = families[aContext.graphicsFamilyIndex].timestampValidBits;
+		if( 0 == validBits )
+			return;
+
+		mTimestampMask = validBits >= 64 ? ~std::uint64_t(0) : (std::uint64_t(1) << validBits) - 1;
+
+		VkPhysicalDeviceProperties props{};
+		vkGetPhysicalDeviceProperties( aContext.physicalDevice, &props );
+
+		// timestampPeriod is in nanoseconds per tick
+		mMsPerTick = props.limits.timestampPeriod * 1e-6f;
+
+		// Two queries for the frame, two per scope
+		mQueriesPerFrame = 2 + 2 * aMaxScopesPerFrame;
+
+		VkQueryPoolCreateInfo poolInfo{};
+		poolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+		poolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+		poolInfo.queryCount = mQueriesPerFrame * aFrameCount;
+
+		VkQueryPool pool = VK_NULL_HANDLE;
+		if( auto const res = vkCreateQueryPool( aContext.device, &poolInfo, nullptr, &pool ); VK_SUCCESS != res )
+		{
+			throw Error( "Unable to create timestamp query pool\n" "vkCreateQueryPool() returned %s", to_string(res).c_str() );
+		}
+
+		mPool = QueryPool( aContext.device, pool );
+
+		mQueriesUsed.resize( aFrameCount, 0 );
+		mRecorded.resize( aFrameCount );
+	}
+
+	bool GpuProfiler::enabled() const noexcept
+	{
+		return VK_NULL_HANDLE != mPool.handle;
+	}
+
+	void GpuProfiler::begin_frame( VkCommandBuffer aCmdBuff, std::uint32_t aFrame )
+	{
+		if( !enabled() )
+			return;
+
+		assert( aFrame < mQueriesUsed.size() );
+
+		collect( aFrame );
+
+		mCurrentFrame = aFrame;
+
+		std::uint32_t const base = aFrame * mQueriesPerFrame;
+		vkCmdResetQueryPool( aCmdBuff, mPool.handle, base, mQueriesPerFrame );
+
+		vkCmdWriteTimestamp( aCmdBuff, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, mPool.handle, base );
+		mQueriesUsed[aFrame] = 1;
+	}
+
+	void GpuProfiler::end_frame( VkCommandBuffer aCmdBuff )
+	{
+		if( !enabled() )
+			return;
+
+		// The frame's end timestamp has a fixed slot, so that scopes can be
+		// allocated from the remaining queries in order
+		std::uint32_t const base = mCurrentFrame * mQueriesPerFrame;
+		vkCmdWriteTimestamp( aCmdBuff, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, mPool.handle, base + 1 );
+
+		mQueriesUsed[mCurrentFrame] = std::max<std::uint32_t>( mQueriesUsed[mCurrentFrame], 2 );
+	}
+
+	std::uint32_t GpuProfiler::begin_scope( VkCommandBuffer aCmdBuff, char const* aName )
+	{
+		if( !enabled() )
+			return kInvalidScope;
+
+		auto& recorded = mRecorded[mCurrentFrame];
+
+		std::uint32_t const query = 2 + 2 * std::uint32_t(recorded.size());
+		if( query + 2 > mQueriesPerFrame )
+			return kInvalidScope;
+
+		std::uint32_t const base = mCurrentFrame * mQueriesPerFrame;
+		vkCmdWriteTimestamp( aCmdBuff, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, mPool.handle, base + query );
+
+		recorded.emplace_back( Recorded_{ find_scope_( aName ), query } );
+		mQueriesUsed[mCurrentFrame] = query + 2;
+
+		return std::uint32_t(recorded.size() - 1);
+	}
+
+	void GpuProfiler::end_scope( VkCommandBuffer aCmdBuff, std::uint32_t aScope )
+	{
+		if( !enabled() || kInvalidScope == aScope )
+			return;
+
+		auto const& recorded = mRecorded[mCurrentFrame];
+		assert( aScope < recorded.size() );
+
+		std::uint32_t const base = mCurrentFrame * mQueriesPerFrame;
+		vkCmdWriteTimestamp( aCmdBuff, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, mPool.handle, base + recorded[aScope].query + 1 );
+	}
+
+	std::vector<GpuProfiler::ScopeStats> const& GpuProfiler::scopes() const noexcept
+	{
+		return mScopes;
+	}
+
+	GpuProfiler::ScopeStats const& GpuProfiler::frame() const noexcept
+	{
+		return mFrame;
+	}
+
+	bool GpuProfiler::collect( std::uint32_t aFrame )
+	{
+		if( !enabled() )
+			return false;
+
+		assert( aFrame < mQueriesUsed.size() );
+
+		bool collected = false;
+
+		std::uint32_t const used = mQueriesUsed[aFrame];
+		auto& recorded = mRecorded[aFrame];
+
+		// Only complete frames are collected; the slot may also be unused so
+		// far (first frames)
+		if( used >= 2 )
+		{
+			std::vector<std::uint64_t> ticks( used );
+
+			// Without VK_QUERY_RESULT_WAIT_BIT, so this never blocks. The
+			// frame's fence has been waited on, so the results are ready.
+			auto const res = vkGetQueryPoolResults( mDevice, mPool.handle,
+				aFrame * mQueriesPerFrame, used,
+				ticks.size() * sizeof(std::uint64_t), ticks.data(), sizeof(std::uint64_t),
+				VK_QUERY_RESULT_64_BIT
+			);
+
+			if( VK_SUCCESS == res )
+			{
+				auto const to_ms = [&] (std::uint32_t aBegin) {
+					std::uint64_t const delta = (ticks[aBegin + 1] - ticks[aBegin]) & mTimestampMask;
+					return float(double(delta) * double(mMsPerTick));
+				};
+
+				add_sample_( mFrame, to_ms( 0 ) );
+
+				// Scopes with the same name are summed
+				std::vector<float> sums( mScopes.size(), 0.f );
+				std::vector<bool> seen( mScopes.size(), false );
+				for( auto const& scope : recorded )
+				{
+					sums[scope.stat] += to_ms( scope.query );
+					seen[scope.stat] = true;
+				}
+
+				for( std::size_t i = 0; i < mScopes.size(); ++i )
+				{
+					if( seen[i] )
+						add_sample_( mScopes[i], sums[i] );
+				}
+
+				collected = true;
+			}
+			else if( VK_NOT_READY != res )
+			{
+				throw Error( "Unable to read timestamp queries\n" "vkGetQueryPoolResults() returned %s", to_string(res).c_str() );
+			}
+		}
+
+		mQueriesUsed[aFrame] = 0;
+		recorded.clear();
+
+		return collected;
+	}
+
+	std::uint32_t GpuProfiler::find_scope_( char const* aName )
+	{
+		assert( aName );
+
+		for( std::size_t i = 0; i < mScopes.size(); ++i )
+		{
+			if( mScopes[i].name == aName )
+				return std::uint32_t(i);
+		}
+
+		ScopeStats stats;
+		stats.name = aName;
+		stats.history.resize( kHistoryLength, 0.f );
+
+		mScopes.emplace_back( std::move(stats) );
+		return std::uint32_t(mScopes.size() - 1);
+	}
+
+	void GpuProfiler::add_sample_( ScopeStats& aStats, float aMs )
+	{
+		assert( kHistoryLength == aStats.history.size() );
+
+		// historyOffset points at the oldest sample, which is overwritten
+		// once the ring is full
+		std::uint32_t const slot = (aStats.historyOffset + aStats.historyCount) % kHistoryLength;
+		aStats.history[slot] = aMs;
+
+		if( aStats.historyCount < kHistoryLength )
+			++aStats.historyCount;
+		else
+			aStats.historyOffset = (aStats.historyOffset + 1) % kHistoryLength;
+
+		aStats.lastMs = aMs;
+
+		float minMs = std::numeric_limits<float>::max(), maxMs = 0.f, sum = 0.f;
+		for( std::uint32_t i = 0; i < aStats.historyCount; ++i )
+		{
+			float const sample = aStats.history[(aStats.historyOffset + i) % kHistoryLength];
+			minMs = std::min( minMs, sample );
+			maxMs = std::max( maxMs, sample );
+			sum += sample;
+		}
+
+		aStats.minMs = minMs;
+		aStats.maxMs = maxMs;
+		aStats.avgMs = sum / float(aStats.historyCount);
+	}
+}
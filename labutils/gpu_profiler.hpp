@@ -0,0 +1,121 @@
+#pragma once
+
+#include <volk/volk.h>
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+#include "vkobject.hpp"
+#include "vulkan_context.hpp"
+
+namespace labutils
+{
+	// GPU profiler based on timestamp queries.
+	//
+	// Each frame in flight owns a range of queries in a single query pool.
+	// The frame is bracketed by begin_frame() and end_frame(), and named
+	// scopes are recorded in between with begin_scope() and end_scope().
+	// Scopes with the same name are summed within a frame, so a scope may
+	// be recorded several times (e.g. once per render pass).
+	//
+	// Results are read back in begin_frame(), when the frame's range is
+	// reused. By then, the caller has waited on that frame's fence, so the
+	// results are available and reading them never stalls. The statistics
+	// thus lag behind by the number of frames in flight.
+	//
+	// Timestamps are written at the bottom of the pipe, i.e., a scope
+	// measures the time between the completion of the work recorded before
+	// it and the completion of its own work.
+	//
+	// If the graphics queue does not support timestamps, all functions are
+	// no-ops and enabled() returns false.
+	class GpuProfiler
+	{
+		public:
+			// Number of samples used for the rolling statistics and kept for
+			// plotting
+			static constexpr std::uint32_t kHistoryLength = 128;
+
+			static constexpr std::uint32_t kInvalidScope = ~std::uint32_t(0);
+
+			struct ScopeStats
+			{
+				std::string name;
+
+				// In milliseconds, over the last kHistoryLength frames
+				float lastMs = 0.f;
+				float minMs = 0.f;
+				float avgMs = 0.f;
+				float maxMs = 0.f;
+
+				// Ring buffer of the last samples; the oldest sample is at
+				// historyOffset
+				std::vector<float> history;
+				std::uint32_t historyOffset = 0;
+				std::uint32_t historyCount = 0;
+			};
+
+		public:
+			GpuProfiler() noexcept = default;
+
+			GpuProfiler( VulkanContext const&, std::uint32_t aFrameCount, std::uint32_t aMaxScopesPerFrame = 32 );
+
+			GpuProfiler( GpuProfiler&& ) noexcept = default;
+			GpuProfiler& operator= (GpuProfiler&&) noexcept = default;
+
+			bool enabled() const noexcept;
+
+			// Read back the previous results of frame aFrame, reset its
+			// queries and start timing the frame. Must be recorded outside
+			// of a render pass.
+			void begin_frame( VkCommandBuffer, std::uint32_t aFrame );
+			void end_frame( VkCommandBuffer );
+
+			// Read back the results of frame aFrame, if it was recorded since
+			// its results were last read. Returns true if a sample was added;
+			// frame() then holds its timings. The frame must have completed.
+			// Called by begin_frame(); call it directly to get the results of
+			// the last frames, after waiting for the device to become idle.
+			bool collect( std::uint32_t aFrame );
+
+			// Returns kInvalidScope if the frame has run out of queries; such
+			// scopes are ignored by end_scope().
+			std::uint32_t begin_scope( VkCommandBuffer, char const* aName );
+			void end_scope( VkCommandBuffer, std::uint32_t aScope );
+
+			// Statistics, in the order in which the scopes were first seen
+			std::vector<ScopeStats> const& scopes() const noexcept;
+
+			// Statistics of whole frames (begin_frame() to end_frame())
+			ScopeStats const& frame() const noexcept;
+
+		private:
+			struct Recorded_
+			{
+				std::uint32_t stat;  // Index into mScopes
+				std::uint32_t query; // First of two queries
+			};
+
+			std::uint32_t find_scope_( char const* aName );
+
+			static void add_sample_( ScopeStats&, float aMs );
+
+		private:
+			VkDevice mDevice = VK_NULL_HANDLE;
+			QueryPool mPool;
+
+			std::uint32_t mQueriesPerFrame = 0;
+			std::uint64_t mTimestampMask = 0;
+			float mMsPerTick = 0.f;
+
+			// Per frame in flight
+			std::vector<std::uint32_t> mQueriesUsed;
+			std::vector<std::vector<Recorded_>> mRecorded;
+
+			std::uint32_t mCurrentFrame = 0;
+
+			std::vector<ScopeStats> mScopes;
+			ScopeStats mFrame;
+	};
+}
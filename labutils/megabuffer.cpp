@@ -0,0 +1,39 @@
+#include "megabuffer.hpp"
+
+#include <cassert>
+
+#include "error.hpp"
+
+
+
+namespace labutils
+{
+	VkDeviceSize MegaBuffer::allocate( VkDeviceSize aSize, VkDeviceSize aAlignment )
+	{
+		assert( aAlignment > 0 );
+
+		VkDeviceSize const offset = (used + aAlignment - 1) / aAlignment * aAlignment;
+		if( offset + aSize > capacity )
+		{
+			throw Error( "MegaBuffer exhausted\n" "Requested %llu bytes at offset %llu, capacity is %llu bytes",
+				(unsigned long long)aSize, (unsigned long long)offset, (unsigned long long)capacity
+			);
+		}
+
+		used = offset + aSize;
+		return offset;
+	}
+}
+
+namespace labutils
+{
+	MegaBuffer create_mega_buffer( Allocator const& aAllocator, VkDeviceSize aCapacity, VkBufferUsageFlags aBufferUsage, VmaAllocationCreateFlags aMemoryFlags, VmaMemoryUsage aMemoryUsage )
+	{
+		// Zero-sized buffers are not allowed
+		MegaBuffer ret;
+		ret.buffer = create_buffer( aAllocator, aCapacity > 0 ? aCapacity : 1, aBufferUsage, aMemoryFlags, aMemoryUsage );
+		ret.capacity = aCapacity;
+		ret.used = 0;
+		return ret;
+	}
+}
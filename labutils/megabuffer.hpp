@@ -0,0 +1,38 @@
+#pragma once
+
+#include <volk/volk.h>
+#include <vk_mem_alloc.h>
+
+#include "vkbuffer.hpp"
+#include "allocator.hpp"
+
+namespace labutils
+{
+	// A single large buffer that is sub-allocated linearly. This replaces
+	// many small per-mesh buffers (and VMA allocations) with one buffer per
+	// attribute stream. Sub-allocations are never freed individually; the
+	// whole buffer is released at once.
+	class MegaBuffer
+	{
+		public:
+			MegaBuffer() noexcept = default;
+
+			MegaBuffer( MegaBuffer&& ) noexcept = default;
+			MegaBuffer& operator= (MegaBuffer&&) noexcept = default;
+
+			// Reserve aSize bytes and return the byte offset of the
+			// reservation. The offset is a multiple of aAlignment, which does
+			// not have to be a power of two. For vertex streams, pass the
+			// vertex stride, so that offset / stride can be used as the draw's
+			// vertexOffset. Throws if the buffer is too small.
+			VkDeviceSize allocate( VkDeviceSize aSize, VkDeviceSize aAlignment = 1 );
+
+		public:
+			Buffer buffer;
+
+			VkDeviceSize capacity = 0;
+			VkDeviceSize used = 0;
+	};
+
+	MegaBuffer create_mega_buffer( Allocator const&, VkDeviceSize aCapacity, VkBufferUsageFlags, VmaAllocationCreateFlags = 0, VmaMemoryUsage = VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE );
+}
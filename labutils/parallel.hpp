@@ -0,0 +1,78 @@
+#pragma once
+
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <utility>
+#include <exception>
+#include <algorithm>
+
+#include <cstddef>
+
+namespace labutils
+{
+	// Run aFn( i ) for each i in [0, aCount) on a set of worker threads.
+	//
+	// Work items are handed out one at a time through a shared counter, so
+	// items of very different cost (e.g., textures of different sizes) are
+	// balanced automatically. The calling thread participates in the work.
+	// The call returns once all items have completed. If any invocation
+	// throws, the remaining items are skipped and the first exception is
+	// rethrown on the calling thread.
+	//
+	// aThreadCount = 0 uses std::thread::hardware_concurrency() threads.
+	template< typename tFn >
+	void parallel_for( std::size_t aCount, tFn&& aFn, unsigned aThreadCount = 0 )
+	{
+		if( 0 == aCount )
+			return;
+
+		if( 0 == aThreadCount )
+			aThreadCount = std::max( 1u, std::thread::hardware_concurrency() );
+
+		auto const threadCount = std::size_t(std::min<std::size_t>( aThreadCount, aCount ));
+
+		std::atomic<std::size_t> next{ 0 };
+		std::atomic<bool> failed{ false };
+
+		std::mutex errorMutex;
+		std::exception_ptr error;
+
+		auto worker = [&] () {
+			for( ;; )
+			{
+				auto const i = next.fetch_add( 1, std::memory_order_relaxed );
+				if( i >= aCount || failed.load( std::memory_order_relaxed ) )
+					return;
+
+				try
+				{
+					aFn( i );
+				}
+				catch( ... )
+				{
+					std::lock_guard<std::mutex> lock( errorMutex );
+					if( !error )
+						error = std::current_exception();
+
+					failed.store( true, std::memory_order_relaxed );
+					return;
+				}
+			}
+		};
+
+		std::vector<std::thread> threads;
+		threads.reserve( threadCount-1 );
+		for( std::size_t i = 1; i < threadCount; ++i )
+			threads.emplace_back( worker );
+
+		worker();
+
+		for( auto& thread : threads )
+			thread.join();
+
+		if( error )
+			std::rethrow_exception( error );
+	}
+}
@@ -0,0 +1,149 @@
+#include "pipeline_cache.hpp"
+
+#include <string>
+#include <vector>
+#include <filesystem>
+#include <system_error>
+
+#include <cstdio>
+#include <cstring>
+#include <cassert>
+
+#include "error.hpp"
+#include "to_string.hpp"
+
+namespace
+{
+	// Read a whole file. Returns an empty vector on failure.
+	std::vector<std::uint8_t> read_file_( char const* aPath )
+	{
+		std::vector<std::uint8_t> ret;
+
+		std::FILE* fin = std::fopen( aPath, "rb" );
+		if( !fin )
+			return ret;
+
+		std::fseek( fin, 0, SEEK_END );
+		auto const bytes = std::ftell( fin );
+		std::fseek( fin, 0, SEEK_SET );
+
+		if( bytes > 0 )
+		{
+			ret.resize( std::size_t(bytes) );
+			if( 1 != std::fread( ret.data(), ret.size(), 1, fin ) )
+				ret.clear();
+		}
+
+		std::fclose( fin );
+		return ret;
+	}
+
+	// Check that the cache data was produced by this driver and device. The
+	// driver would reject mismatching data itself, but not all drivers are
+	// equally robust against stale or corrupted data.
+	bool validate_header_( labutils::VulkanContext const& aContext, std::vector<std::uint8_t> const& aData )
+	{
+		VkPipelineCacheHeaderVersionOne header{};
+		if( aData.size() < sizeof(header) )
+			return false;
+
+		std::memcpy( &header, aData.data(), sizeof(header) );
+
+		if( header.headerSize < sizeof(header) || header.headerSize > aData.size() )
+			return false;
+		if( VK_PIPELINE_CACHE_HEADER_VERSION_ONE != header.headerVersion )
+			return false;
+
+		VkPhysicalDeviceProperties props{};
+		vkGetPhysicalDeviceProperties( aContext.physicalDevice, &props );
+
+		return header.vendorID == props.vendorID
+			&& header.deviceID == props.deviceID
+			&& 0 == std::memcmp( header.pipelineCacheUUID, props.pipelineCacheUUID, VK_UUID_SIZE )
+		;
+	}
+}
+
+namespace labutils
+{
+	PipelineCache create_pipeline_cache( VulkanContext const& aContext, char const* aPath, bool* aWarm )
+	{
+		assert( aPath );
+
+		auto data = read_file_( aPath );
+		if( !data.empty() && !validate_header_( aContext, data ) )
+		{
+			std::fprintf( stderr, "Pipeline cache '%s' was created by a different driver or device; ignoring it\n", aPath );
+			data.clear();
+		}
+
+		VkPipelineCacheCreateInfo cacheInfo{};
+		cacheInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+		cacheInfo.initialDataSize = data.size();
+		cacheInfo.pInitialData = data.empty() ? nullptr : data.data();
+
+		VkPipelineCache cache = VK_NULL_HANDLE;
+		if( auto const res = vkCreatePipelineCache( aContext.device, &cacheInfo, nullptr, &cache ); VK_SUCCESS != res )
+		{
+			throw Error( "Unable to create pipeline cache\n" "vkCreatePipelineCache() returned %s", to_string(res).c_str() );
+		}
+
+		if( aWarm )
+			*aWarm = !data.empty();
+
+		return PipelineCache( aContext.device, cache );
+	}
+
+	bool save_pipeline_cache( VulkanContext const& aContext, VkPipelineCache aCache, char const* aPath )
+	{
+		assert( aPath );
+
+		std::size_t bytes = 0;
+		if( auto const res = vkGetPipelineCacheData( aContext.device, aCache, &bytes, nullptr ); VK_SUCCESS != res )
+		{
+			std::fprintf( stderr, "Unable to query pipeline cache size: vkGetPipelineCacheData() returned %s\n", to_string(res).c_str() );
+			return false;
+		}
+
+		std::vector<std::uint8_t> data( bytes );
+		if( auto const res = vkGetPipelineCacheData( aContext.device, aCache, &bytes, data.data() ); VK_SUCCESS != res )
+		{
+			std::fprintf( stderr, "Unable to retrieve pipeline cache data: vkGetPipelineCacheData() returned %s\n", to_string(res).c_str() );
+			return false;
+		}
+
+		data.resize( bytes );
+
+		// Write to a temporary file first, so that an interrupted write never
+		// leaves a truncated cache behind.
+		auto const tempPath = std::string(aPath) + ".tmp";
+
+		std::FILE* fout = std::fopen( tempPath.c_str(), "wb" );
+		if( !fout )
+		{
+			std::fprintf( stderr, "Unable to open '%s' for writing\n", tempPath.c_str() );
+			return false;
+		}
+
+		bool const written = data.empty() || 1 == std::fwrite( data.data(), data.size(), 1, fout );
+		bool const closed = 0 == std::fclose( fout );
+
+		std::error_code ec;
+		if( !written || !closed )
+		{
+			std::fprintf( stderr, "Unable to write pipeline cache to '%s'\n", tempPath.c_str() );
+			std::filesystem::remove( tempPath, ec );
+			return false;
+		}
+
+		std::filesystem::rename( tempPath, aPath, ec );
+		if( ec )
+		{
+			std::fprintf( stderr, "Unable to replace '%s': %s\n", aPath, ec.message().c_str() );
+			std::filesystem::remove( tempPath, ec );
+			return false;
+		}
+
+		return true;
+	}
+}
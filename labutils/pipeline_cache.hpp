@@ -0,0 +1,20 @@
+#pragma once
+
+#include <volk/volk.h>
+
+#include "vkobject.hpp"
+#include "vulkan_context.hpp"
+
+namespace labutils
+{
+	// Create a pipeline cache that is seeded with the data stored in aPath,
+	// if that file exists and was written by the same driver and device (as
+	// identified by the vendor ID, device ID and pipeline cache UUID in the
+	// cache header). Otherwise, an empty cache is created. If aWarm is not
+	// null, it is set to true if existing data was used.
+	PipelineCache create_pipeline_cache( VulkanContext const&, char const* aPath, bool* aWarm = nullptr );
+
+	// Write the contents of a pipeline cache to aPath. Returns false if the
+	// file could not be written; this is not a fatal error.
+	bool save_pipeline_cache( VulkanContext const&, VkPipelineCache, char const* aPath );
+}
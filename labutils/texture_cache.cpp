@@ -0,0 +1,157 @@
+#include "texture_cache.hpp"
+
+#include <algorithm>
+#include <filesystem>
+#include <system_error>
+
+#include <cassert>
+
+#include "error.hpp"
+#include "vkutil.hpp"
+
+
+
+namespace
+{
+	std::string canonical_key_( char const* aPath )
+	{
+		// Fall back to the path as given if it cannot be canonicalized;
+		// loading the texture will then report a proper error.
+		std::error_code ec;
+		auto const canonical = std::filesystem::weakly_canonical( aPath, ec );
+		if( ec )
+			return aPath;
+
+		return canonical.generic_string();
+	}
+}
+
+namespace labutils
+{
+	TextureCache::TextureCache( VulkanContext const& aContext, Allocator const& aAllocator, VkCommandPool aCmdPool )
+		: mContext( &aContext )
+		, mAllocator( &aAllocator )
+		, mCmdPool( aCmdPool )
+	{}
+
+	TextureCache::Handle TextureCache::acquire( char const* aPath )
+	{
+		assert( aPath );
+
+		// A batch of one, so that single textures are loaded exactly like
+		// batched ones (including .btex files and their formats)
+		Handle handle;
+		acquire( &aPath, 1, &handle );
+		return handle;
+	}
+
+	void TextureCache::acquire( char const* const aPaths[], std::size_t aCount, Handle aHandles[] )
+	{
+		assert( aPaths || 0 == aCount );
+		assert( aHandles || 0 == aCount );
+
+		// Resolve all paths first. Each texture that needs loading is listed
+		// once, even if it appears several times in the batch. Reference
+		// counts and statistics are only updated once the whole batch has
+		// loaded, so that a failed load does not leave referenced entries
+		// without an image behind.
+		std::vector<char const*> loadPaths;
+		std::vector<Handle> loadHandles;
+
+		std::uint32_t batchHits = 0;
+
+		for( std::size_t i = 0; i < aCount; ++i )
+		{
+			auto key = canonical_key_( aPaths[i] );
+
+			auto it = mLookup.find( key );
+			if( mLookup.end() == it )
+			{
+				Entry_ entry;
+				entry.key = key;
+
+				it = mLookup.emplace( std::move(key), Handle(mEntries.size()) ).first;
+				mEntries.emplace_back( std::move(entry) );
+			}
+
+			auto const handle = it->second;
+			auto& entry = mEntries[handle];
+
+			bool const pending = !loadHandles.empty() && std::find( loadHandles.begin(), loadHandles.end(), handle ) != loadHandles.end();
+			if( entry.refCount > 0 || pending )
+			{
+				++batchHits;
+			}
+			else
+			{
+				loadPaths.emplace_back( aPaths[i] );
+				loadHandles.emplace_back( handle );
+			}
+
+			aHandles[i] = handle;
+		}
+
+		if( !loadPaths.empty() )
+		{
+			std::vector<VkFormat> formats( loadPaths.size() );
+			auto images = load_image_textures2d( loadPaths.data(), loadPaths.size(), *mContext, mCmdPool, *mAllocator, formats.data() );
+			assert( images.size() == loadHandles.size() );
+
+			std::vector<ImageView> views;
+			views.reserve( images.size() );
+			for( std::size_t i = 0; i < images.size(); ++i )
+				views.emplace_back( create_image_view_texture2d( *mContext, images[i].image, formats[i] ) );
+
+			for( std::size_t i = 0; i < images.size(); ++i )
+			{
+				auto& entry = mEntries[loadHandles[i]];
+				entry.image = std::move(images[i]);
+				entry.view = std::move(views[i]);
+			}
+
+			mResident += images.size();
+		}
+
+		for( std::size_t i = 0; i < aCount; ++i )
+			++mEntries[aHandles[i]].refCount;
+
+		hits += batchHits;
+		misses += std::uint32_t(loadHandles.size());
+	}
+
+	void TextureCache::release( Handle aHandle )
+	{
+		assert( aHandle < mEntries.size() );
+
+		auto& entry = mEntries[aHandle];
+		assert( entry.refCount > 0 );
+
+		if( 0 == --entry.refCount )
+		{
+			// The caller must ensure that the GPU no longer uses the texture
+			entry.view = ImageView();
+			entry.image = Image();
+			--mResident;
+		}
+	}
+
+	VkImage TextureCache::image( Handle aHandle ) const
+	{
+		assert( aHandle < mEntries.size() );
+		assert( mEntries[aHandle].refCount > 0 );
+		return mEntries[aHandle].image.image;
+	}
+
+	VkImageView TextureCache::view( Handle aHandle ) const
+	{
+		assert( aHandle < mEntries.size() );
+		assert( mEntries[aHandle].refCount > 0 );
+		return mEntries[aHandle].view.handle;
+	}
+
+	std::uint32_t TextureCache::ref_count( Handle aHandle ) const
+	{
+		assert( aHandle < mEntries.size() );
+		return mEntries[aHandle].refCount;
+	}
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <volk/volk.h>
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+#include <cstdint>
+
+#include "vkimage.hpp"
+#include "vkobject.hpp"
+#include "allocator.hpp"
+#include "vulkan_context.hpp"
+
+namespace labutils
+{
+	// Loads each texture file at most once.
+	//
+	// Textures are keyed by their canonical path, so that different spellings
+	// of the same path (e.g., "a/../b.jpg" and "b.jpg") share one image. Each
+	// acquire() increments the texture's reference count; release() decrements
+	// it and destroys the image once it is no longer referenced. Handles stay
+	// valid (and are not reused) for the lifetime of the cache.
+	class TextureCache
+	{
+		public:
+			using Handle = std::uint32_t;
+
+			TextureCache( VulkanContext const&, Allocator const&, VkCommandPool );
+
+			TextureCache( TextureCache const& ) = delete;
+			TextureCache& operator= (TextureCache const&) = delete;
+
+			Handle acquire( char const* aPath );
+
+			// Acquire several textures at once. Textures that are not yet
+			// resident are loaded together with load_image_textures2d(), i.e.,
+			// decoded in parallel and uploaded in a single submission.
+			void acquire( char const* const aPaths[], std::size_t aCount, Handle aHandles[] );
+			void release( Handle );
+
+			VkImage image( Handle ) const;
+			VkImageView view( Handle ) const;
+			std::uint32_t ref_count( Handle ) const;
+
+			// Number of textures currently resident
+			std::size_t resident_count() const noexcept { return mResident; }
+
+		public:
+			// Statistics
+			std::uint32_t hits = 0;
+			std::uint32_t misses = 0;
+
+		private:
+			struct Entry_
+			{
+				std::string key;
+
+				Image image;
+				ImageView view;
+
+				std::uint32_t refCount = 0;
+			};
+
+			VulkanContext const* mContext;
+			Allocator const* mAllocator;
+			VkCommandPool mCmdPool;
+
+			std::vector<Entry_> mEntries;
+			std::unordered_map<std::string, Handle> mLookup;
+
+			std::size_t mResident = 0;
+	};
+}
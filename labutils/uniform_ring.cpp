@@ -0,0 +1,84 @@
+#include "uniform_ring.hpp"
+
+#include <cassert>
+#include <cstring>
+
+#include "error.hpp"
+#include "to_string.hpp"
+
+
+
+namespace labutils
+{
+	UniformRing::UniformRing( VulkanContext const& aContext, Allocator const& aAllocator, VkDeviceSize aFrameSize, std::uint32_t aFrameCount )
+		: frameCount( aFrameCount )
+		, mAllocator( aAllocator.allocator )
+	{
+		assert( aFrameSize > 0 );
+		assert( aFrameCount > 0 );
+
+		VkPhysicalDeviceProperties props{};
+		vkGetPhysicalDeviceProperties( aContext.physicalDevice, &props );
+
+		// Slices start at an aligned offset, so that offsets returned by
+		// push() are valid dynamic offsets
+		alignment = props.limits.minUniformBufferOffsetAlignment;
+		if( 0 == alignment )
+			alignment = 1;
+
+		frameSize = (aFrameSize + alignment - 1) / alignment * alignment;
+
+		// Prefer device-local memory if it is host-visible (e.g. ReBAR or
+		// integrated GPUs); VMA falls back to host memory otherwise.
+		buffer = create_buffer(
+			aAllocator,
+			frameSize * aFrameCount,
+			VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+			VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT | VMA_ALLOCATION_CREATE_MAPPED_BIT
+		);
+
+		VmaAllocationInfo allocInfo{};
+		vmaGetAllocationInfo( mAllocator, buffer.allocation, &allocInfo );
+		assert( allocInfo.pMappedData );
+
+		mMapped = static_cast<std::uint8_t*>(allocInfo.pMappedData);
+	}
+
+	void UniformRing::begin_frame( std::uint32_t aFrame )
+	{
+		assert( aFrame < frameCount );
+
+		mFrameBegin = frameSize * aFrame;
+		mCursor = mFrameBegin;
+	}
+
+	std::uint32_t UniformRing::push( void const* aData, VkDeviceSize aSize )
+	{
+		assert( mMapped );
+		assert( aData || 0 == aSize );
+
+		VkDeviceSize const offset = (mCursor + alignment - 1) / alignment * alignment;
+		if( offset + aSize > mFrameBegin + frameSize )
+		{
+			throw Error( "UniformRing slice exhausted\n" "Requested %llu bytes, slice size is %llu bytes",
+				(unsigned long long)aSize, (unsigned long long)frameSize
+			);
+		}
+
+		std::memcpy( mMapped + offset, aData, std::size_t(aSize) );
+		mCursor = offset + aSize;
+
+		return std::uint32_t(offset);
+	}
+
+	void UniformRing::flush()
+	{
+		if( mCursor == mFrameBegin )
+			return;
+
+		if( auto const res = vmaFlushAllocation( mAllocator, buffer.allocation, mFrameBegin, mCursor - mFrameBegin ); VK_SUCCESS != res )
+		{
+			throw Error( "Unable to flush uniform ring\n" "vmaFlushAllocation() returned %s", to_string(res).c_str() );
+		}
+	}
+}
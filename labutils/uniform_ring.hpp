@@ -0,0 +1,69 @@
+#pragma once
+
+#include <volk/volk.h>
+#include <vk_mem_alloc.h>
+
+#include <cstdint>
+
+#include "vkbuffer.hpp"
+#include "allocator.hpp"
+#include "vulkan_context.hpp"
+
+namespace labutils
+{
+	// Host-visible, persistently mapped uniform buffer, split into one slice
+	// per frame in flight.
+	//
+	// Each frame writes its uniform data directly into its own slice with
+	// push(), which returns the offset of the data. The offsets are meant to
+	// be used as dynamic offsets with VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC
+	// descriptors, so a single descriptor set covers all frames and all
+	// pushed blocks. No transfer commands or barriers are needed: the host
+	// writes are made visible by the queue submission.
+	//
+	// The caller must ensure that the GPU has finished the previous frame
+	// that used a slice before begin_frame() is called for it, typically by
+	// waiting on that frame's fence.
+	class UniformRing
+	{
+		public:
+			UniformRing() noexcept = default;
+
+			UniformRing( VulkanContext const&, Allocator const&, VkDeviceSize aFrameSize, std::uint32_t aFrameCount );
+
+			UniformRing( UniformRing&& ) noexcept = default;
+			UniformRing& operator= (UniformRing&&) noexcept = default;
+
+			// Start writing into the slice of frame aFrame.
+			void begin_frame( std::uint32_t aFrame );
+
+			// Copy aSize bytes into the current slice. The returned offset is
+			// relative to the start of the buffer and is a multiple of
+			// minUniformBufferOffsetAlignment. Throws if the slice is full.
+			std::uint32_t push( void const* aData, VkDeviceSize aSize );
+
+			template< typename tType >
+			std::uint32_t push( tType const& aData )
+			{
+				return push( &aData, sizeof(tType) );
+			}
+
+			// Flush the writes of the current frame. This is a no-op for
+			// host-coherent memory. Call before submitting the frame.
+			void flush();
+
+		public:
+			Buffer buffer;
+
+			VkDeviceSize alignment = 0;
+			VkDeviceSize frameSize = 0;
+			std::uint32_t frameCount = 0;
+
+		private:
+			VmaAllocator mAllocator = VK_NULL_HANDLE;
+			std::uint8_t* mMapped = nullptr;
+
+			VkDeviceSize mFrameBegin = 0;
+			VkDeviceSize mCursor = 0;
+	};
+}
@@ -0,0 +1,209 @@
+#include "upload_batcher.hpp"
+
+#include <limits>
+#include <algorithm>
+
+#include <cassert>
+#include <cstring>
+
+#include "error.hpp"
+#include "vkutil.hpp"
+#include "to_string.hpp"
+
+
+
+namespace labutils
+{
+	UploadBatcher::UploadBatcher( VulkanContext const& aContext, Allocator const& aAllocator, VkDeviceSize aChunkSize, std::uint32_t aChunkCount, VkAccessFlags aDstAccessMask, VkPipelineStageFlags aDstStageMask )
+		: mDevice( aContext.device )
+		, mQueue( aContext.graphicsQueue )
+		, mAllocator( aAllocator.allocator )
+		, mChunkSize( aChunkSize )
+		, mDstAccessMask( aDstAccessMask )
+		, mDstStageMask( aDstStageMask )
+	{
+		assert( aChunkSize > 0 );
+		assert( aChunkCount > 0 );
+
+		// Command buffers are re-recorded each time a chunk is reused
+		mPool = create_command_pool( aContext, VK_COMMAND_POOL_CREATE_TRANSIENT_BIT | VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT );
+
+		mChunks.resize( aChunkCount );
+		for( auto& chunk : mChunks )
+		{
+			// Staging memory remains mapped for the lifetime of the batcher
+			chunk.staging = create_buffer(
+				aAllocator,
+				aChunkSize,
+				VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+				VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT | VMA_ALLOCATION_CREATE_MAPPED_BIT
+			);
+
+			VmaAllocationInfo allocInfo{};
+			vmaGetAllocationInfo( mAllocator, chunk.staging.allocation, &allocInfo );
+			assert( allocInfo.pMappedData );
+
+			chunk.mapped = static_cast<std::uint8_t*>(allocInfo.pMappedData);
+			chunk.cmdBuffer = alloc_command_buffer( aContext, mPool.handle );
+			chunk.fence = create_fence( aContext );
+		}
+	}
+
+	UploadBatcher::~UploadBatcher()
+	{
+		// Staging buffers must not be destroyed while copies are in flight.
+		// Errors cannot be reported from here, so just wait for the device.
+		bool anyPending = false;
+		for( auto const& chunk : mChunks )
+			anyPending = anyPending || chunk.inFlight || chunk.recording;
+
+		if( anyPending )
+			vkDeviceWaitIdle( mDevice );
+	}
+
+	void UploadBatcher::upload( VkBuffer aDstBuffer, VkDeviceSize aDstOffset, void const* aData, VkDeviceSize aSize )
+	{
+		assert( VK_NULL_HANDLE != aDstBuffer );
+		assert( aData || 0 == aSize );
+
+		auto const* src = static_cast<std::uint8_t const*>(aData);
+		while( aSize > 0 )
+		{
+			auto* chunk = &mChunks[mCurrent];
+			if( chunk->used == mChunkSize )
+			{
+				// Chunk is full: submit it and continue with the next one
+				submit_chunk_( *chunk );
+
+				mCurrent = (mCurrent + 1) % mChunks.size();
+				chunk = &mChunks[mCurrent];
+			}
+
+			if( !chunk->recording )
+				begin_chunk_( *chunk );
+
+			VkDeviceSize const bytes = std::min( aSize, mChunkSize - chunk->used );
+			std::memcpy( chunk->mapped + chunk->used, src, std::size_t(bytes) );
+
+			VkBufferCopy copy{};
+			copy.srcOffset = chunk->used;
+			copy.dstOffset = aDstOffset;
+			copy.size = bytes;
+
+			vkCmdCopyBuffer( chunk->cmdBuffer, chunk->staging.buffer, aDstBuffer, 1, &copy );
+
+			chunk->used += bytes;
+			src += bytes;
+			aDstOffset += bytes;
+			aSize -= bytes;
+
+			bytesUploaded += bytes;
+			++copyCount;
+		}
+	}
+
+	void UploadBatcher::flush()
+	{
+		auto& current = mChunks[mCurrent];
+		if( current.recording )
+			submit_chunk_( current );
+
+		std::vector<VkFence> fences;
+		for( auto const& chunk : mChunks )
+		{
+			if( chunk.inFlight )
+				fences.emplace_back( chunk.fence.handle );
+		}
+
+		if( fences.empty() )
+			return;
+
+		if( auto const res = vkWaitForFences( mDevice, std::uint32_t(fences.size()), fences.data(), VK_TRUE, std::numeric_limits<std::uint64_t>::max() ); VK_SUCCESS != res )
+		{
+			throw Error( "Waiting for uploads to complete\n" "vkWaitForFences() returned %s", to_string(res).c_str() );
+		}
+
+		if( auto const res = vkResetFences( mDevice, std::uint32_t(fences.size()), fences.data() ); VK_SUCCESS != res )
+		{
+			throw Error( "Unable to reset upload fences\n" "vkResetFences() returned %s", to_string(res).c_str() );
+		}
+
+		for( auto& chunk : mChunks )
+			chunk.inFlight = false;
+	}
+
+	void UploadBatcher::begin_chunk_( Chunk_& aChunk )
+	{
+		// The ring has wrapped around to a chunk that may still be in use
+		if( aChunk.inFlight )
+			wait_chunk_( aChunk );
+
+		aChunk.used = 0;
+
+		VkCommandBufferBeginInfo beginInfo{};
+		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+		if( auto const res = vkBeginCommandBuffer( aChunk.cmdBuffer, &beginInfo ); VK_SUCCESS != res )
+		{
+			throw Error( "Beginning command buffer recording\n" "vkBeginCommandBuffer() returned %s", to_string(res).c_str() );
+		}
+
+		aChunk.recording = true;
+	}
+
+	void UploadBatcher::submit_chunk_( Chunk_& aChunk )
+	{
+		assert( aChunk.recording );
+
+		// One barrier for all copies in this chunk
+		VkMemoryBarrier barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = mDstAccessMask;
+
+		vkCmdPipelineBarrier( aChunk.cmdBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, mDstStageMask, 0, 1, &barrier, 0, nullptr, 0, nullptr );
+
+		if( auto const res = vkEndCommandBuffer( aChunk.cmdBuffer ); VK_SUCCESS != res )
+		{
+			throw Error( "Ending command buffer recording\n" "vkEndCommandBuffer() returned %s", to_string(res).c_str() );
+		}
+
+		// Staging memory is not necessarily host coherent
+		if( auto const res = vmaFlushAllocation( mAllocator, aChunk.staging.allocation, 0, aChunk.used ); VK_SUCCESS != res )
+		{
+			throw Error( "Unable to flush staging memory\n" "vmaFlushAllocation() returned %s", to_string(res).c_str() );
+		}
+
+		VkSubmitInfo submitInfo{};
+		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		submitInfo.commandBufferCount = 1;
+		submitInfo.pCommandBuffers = &aChunk.cmdBuffer;
+
+		if( auto const res = vkQueueSubmit( mQueue, 1, &submitInfo, aChunk.fence.handle ); VK_SUCCESS != res )
+		{
+			throw Error( "Submitting commands\n" "vkQueueSubmit() returned %s", to_string(res).c_str() );
+		}
+
+		aChunk.recording = false;
+		aChunk.inFlight = true;
+		++submitCount;
+	}
+
+	void UploadBatcher::wait_chunk_( Chunk_& aChunk )
+	{
+		assert( aChunk.inFlight );
+
+		if( auto const res = vkWaitForFences( mDevice, 1, &aChunk.fence.handle, VK_TRUE, std::numeric_limits<std::uint64_t>::max() ); VK_SUCCESS != res )
+		{
+			throw Error( "Waiting for upload chunk\n" "vkWaitForFences() returned %s", to_string(res).c_str() );
+		}
+
+		if( auto const res = vkResetFences( mDevice, 1, &aChunk.fence.handle ); VK_SUCCESS != res )
+		{
+			throw Error( "Unable to reset upload fence\n" "vkResetFences() returned %s", to_string(res).c_str() );
+		}
+
+		aChunk.inFlight = false;
+	}
+}
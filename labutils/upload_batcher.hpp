@@ -0,0 +1,92 @@
+#pragma once
+
+#include <volk/volk.h>
+#include <vk_mem_alloc.h>
+
+#include <vector>
+
+#include <cstdint>
+
+#include "vkobject.hpp"
+#include "vkbuffer.hpp"
+#include "allocator.hpp"
+#include "vulkan_context.hpp"
+
+namespace labutils
+{
+	// Batches many small buffer uploads into few submissions.
+	//
+	// Data is copied into a ring of persistently mapped staging chunks. Each
+	// chunk has its own command buffer and fence. Copies are recorded into
+	// the current chunk's command buffer; when the chunk is full, it is
+	// submitted (without waiting) and the next chunk is used. A chunk is only
+	// waited for when the ring wraps around to it while it is still in
+	// flight. flush() submits the last chunk and waits for all outstanding
+	// work with a single vkWaitForFences().
+	//
+	// Uploads larger than a chunk are split across several chunks. Each
+	// submission ends with a memory barrier that makes the transfer writes
+	// visible to the access/stages passed to the constructor.
+	class UploadBatcher
+	{
+		public:
+			explicit UploadBatcher(
+				VulkanContext const&,
+				Allocator const&,
+				VkDeviceSize aChunkSize = VkDeviceSize(8) << 20,
+				std::uint32_t aChunkCount = 4,
+				VkAccessFlags aDstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT,
+				VkPipelineStageFlags aDstStageMask = VK_PIPELINE_STAGE_VERTEX_INPUT_BIT
+			);
+			~UploadBatcher();
+
+			UploadBatcher( UploadBatcher const& ) = delete;
+			UploadBatcher& operator= (UploadBatcher const&) = delete;
+
+			// Copy aSize bytes from aData into aDstBuffer at aDstOffset. The
+			// source data is consumed immediately and may be released once
+			// the call returns. The destination must have been created with
+			// VK_BUFFER_USAGE_TRANSFER_DST_BIT.
+			void upload( VkBuffer aDstBuffer, VkDeviceSize aDstOffset, void const* aData, VkDeviceSize aSize );
+
+			// Submit pending copies and wait for all of them to complete.
+			void flush();
+
+		public:
+			// Statistics
+			std::uint64_t bytesUploaded = 0;
+			std::uint32_t copyCount = 0;
+			std::uint32_t submitCount = 0;
+
+		private:
+			struct Chunk_
+			{
+				Buffer staging;
+				std::uint8_t* mapped = nullptr;
+
+				VkCommandBuffer cmdBuffer = VK_NULL_HANDLE;
+				Fence fence;
+
+				VkDeviceSize used = 0;
+				bool recording = false;
+				bool inFlight = false;
+			};
+
+			void begin_chunk_( Chunk_& );
+			void submit_chunk_( Chunk_& );
+			void wait_chunk_( Chunk_& );
+
+		private:
+			VkDevice mDevice = VK_NULL_HANDLE;
+			VkQueue mQueue = VK_NULL_HANDLE;
+			VmaAllocator mAllocator = VK_NULL_HANDLE;
+
+			VkDeviceSize mChunkSize;
+			VkAccessFlags mDstAccessMask;
+			VkPipelineStageFlags mDstStageMask;
+
+			CommandPool mPool;
+			std::vector<Chunk_> mChunks;
+			std::size_t mCurrent = 0;
+	};
+}
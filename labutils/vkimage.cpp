@@ -1,7 +1,11 @@
 #include "vkimage.hpp"
 
+#include <chrono>
 #include <limits>
+#include <string>
 #include <vector>
+#include <filesystem>
+#include <system_error>
 #include <utility>
 #include <algorithm>
 
@@ -11,9 +15,11 @@
 
 #include <stb_image.h>
 
+#include "btex.hpp"
 #include "error.hpp"
 #include "vkutil.hpp"
 #include "vkbuffer.hpp"
+#include "parallel.hpp"
 #include "to_string.hpp"
 
 
@@ -45,6 +51,7 @@ namespace
 
 		return res;
 	}
+
 }
 
 namespace labutils
@@ -81,64 +88,159 @@ namespace labutils
 	}
 }
 
-namespace labutils
+namespace
 {
-	Image load_image_texture2d( char const* aPath, VulkanContext const& aContext, VkCommandPool aCmdPool, Allocator const& aAllocator )
+	// Check if BC1 textures can be sampled (with linear filtering)
+	bool supports_bc1_( labutils::VulkanContext const& aContext )
 	{
-		//Flip image vertically by default
-		stbi_set_flip_vertically_on_load(1);
+		VkPhysicalDeviceFeatures features{};
+		vkGetPhysicalDeviceFeatures( aContext.physicalDevice, &features );
+		if( !features.textureCompressionBC )
+			return false;
 
-		//Load base image
-		int baseWidthi, baseHeighti, baseChannelsi;
-		stbi_uc* data = stbi_load(aPath, &baseWidthi, &baseHeighti, &baseChannelsi, 4); //We want 4 channels - RGBA
+		VkFormatProperties props{};
+		vkGetPhysicalDeviceFormatProperties( aContext.physicalDevice, VK_FORMAT_BC1_RGBA_SRGB_BLOCK, &props );
 
-		if (!data)
+		VkFormatFeatureFlags const required = VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT | VK_FORMAT_FEATURE_TRANSFER_DST_BIT;
+		return required == (props.optimalTilingFeatures & required);
+	}
+
+	// Read and validate the header of a .btex file. Returns false if the
+	// file does not exist, is older than its source image, or is not usable.
+	bool read_btex_header_( char const* aPath, char const* aSourcePath, std::uint32_t& aWidth, std::uint32_t& aHeight, std::vector<labutils::btex::Level>& aLevels )
+	{
+		namespace btex = labutils::btex;
+
+		std::error_code ec;
+		auto const btexTime = std::filesystem::last_write_time( aPath, ec );
+		if( ec )
+			return false;
+
+		auto const sourceTime = std::filesystem::last_write_time( aSourcePath, ec );
+		if( !ec && sourceTime > btexTime )
 		{
-			throw Error("%s: unable to load texture base image (%s)", aPath, 0, stbi_failure_reason());
+			std::fprintf( stderr, "Warning: '%s' is older than its source image; ignoring it\n", aPath );
+			return false;
 		}
 
-		auto const baseWidth = std::uint32_t(baseWidthi);
-		auto const baseHeight = std::uint32_t(baseHeighti);
+		std::FILE* file = std::fopen( aPath, "rb" );
+		if( !file )
+			return false;
 
-		//Create staging buffer and immediately transfer image data to it
-		auto const sizeInBytes = baseWidth * baseHeight * 4;
+		btex::Header header{};
+		bool ok = 1 == std::fread( &header, sizeof(header), 1, file )
+			&& 0 == std::memcmp( header.magic, btex::kMagic, sizeof(header.magic) )
+			&& btex::kVersion == header.version
+			&& btex::Format::bc1RgbaSrgb == header.format
+			&& header.mipCount == labutils::compute_mip_level_count( header.width, header.height )
+		;
 
-		auto staging = create_buffer(aAllocator, sizeInBytes, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT);
+		if( ok )
+		{
+			aLevels.resize( header.mipCount );
+			ok = aLevels.size() == std::fread( aLevels.data(), sizeof(btex::Level), aLevels.size(), file );
+		}
 
-		void* sptr = nullptr;
-		if (auto const res = vmaMapMemory(aAllocator.allocator, staging.allocation, &sptr); VK_SUCCESS != res)
+		std::fclose( file );
+
+		for( std::size_t i = 0; ok && i < aLevels.size(); ++i )
 		{
-			throw Error("Mapping memory for writing\n" "vmaMapMemory() returned %s", to_string(res).c_str());
+			auto const& level = aLevels[i];
+			ok = level.width == std::max( 1u, header.width >> i )
+				&& level.height == std::max( 1u, header.height >> i )
+				&& level.size == btex::bc1_level_size( level.width, level.height )
+			;
 		}
 
-		std::memcpy(sptr, data, sizeInBytes);
-		vmaUnmapMemory(aAllocator.allocator, staging.allocation);
+		if( !ok )
+		{
+			std::fprintf( stderr, "Warning: '%s' is not a valid texture file; ignoring it\n", aPath );
+			return false;
+		}
 
-		//Free image data
-		stbi_image_free(data);
+		aWidth = header.width;
+		aHeight = header.height;
+		return true;
+	}
 
-		//Create image
-		Image ret = create_image_texture2d(aAllocator, baseWidth, baseHeight, VK_FORMAT_R8G8B8A8_SRGB,
-			VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT);
+	// Read all mip levels of a .btex file. Levels are packed at 16 byte
+	// aligned offsets, matching record_compressed_upload_().
+	void read_btex_levels_( char const* aPath, std::vector<labutils::btex::Level> const& aLevels, std::uint8_t* aOut )
+	{
+		std::FILE* file = std::fopen( aPath, "rb" );
+		if( !file )
+			throw labutils::Error( "%s: unable to open texture", aPath );
 
-		//Create command buffer for data upload and begin recording
-		VkCommandBuffer cbuff = alloc_command_buffer(aContext, aCmdPool);
+		std::size_t offset = 0;
+		for( auto const& level : aLevels )
+		{
+			if( 0 != std::fseek( file, long(level.offset), SEEK_SET ) || 1 != std::fread( aOut + offset, std::size_t(level.size), 1, file ) )
+			{
+				std::fclose( file );
+				throw labutils::Error( "%s: unable to read texture data", aPath );
+			}
 
-		VkCommandBufferBeginInfo beginInfo{};
-		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-		beginInfo.flags = 0;
-		beginInfo.pInheritanceInfo = nullptr;
+			offset += std::size_t(level.size + 15) / 16 * 16;
+		}
 
-		if (auto const res = vkBeginCommandBuffer(cbuff, &beginInfo); VK_SUCCESS != res)
+		std::fclose( file );
+	}
+
+	// Record the upload of all mip levels of a compressed image. The image
+	// ends up in SHADER_READ_ONLY_OPTIMAL layout.
+	void record_compressed_upload_( VkCommandBuffer aCmdBuff, VkImage aImage, VkBuffer aStaging, VkDeviceSize aStagingOffset, std::vector<labutils::btex::Level> const& aLevels )
+	{
+		auto const mipLevels = std::uint32_t(aLevels.size());
+
+		labutils::image_barrier( aCmdBuff, aImage,
+			0,
+			VK_ACCESS_TRANSFER_WRITE_BIT,
+			VK_IMAGE_LAYOUT_UNDEFINED,
+			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+			VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+			VK_PIPELINE_STAGE_TRANSFER_BIT,
+			VkImageSubresourceRange{ VK_IMAGE_ASPECT_COLOR_BIT, 0, mipLevels, 0, 1 }
+		);
+
+		std::vector<VkBufferImageCopy> copies( mipLevels );
+
+		VkDeviceSize offset = aStagingOffset;
+		for( std::uint32_t i = 0; i < mipLevels; ++i )
 		{
-			throw Error("Beginning command buffer recording\n" "vkBeginCommandBuffer() returned %s", to_string(res).c_str());
+			auto& copy = copies[i];
+			copy.bufferOffset = offset;
+			copy.bufferRowLength = 0;
+			copy.bufferImageHeight = 0;
+			copy.imageSubresource = VkImageSubresourceLayers{ VK_IMAGE_ASPECT_COLOR_BIT, i, 0, 1 };
+			copy.imageOffset = VkOffset3D{ 0, 0, 0 };
+			copy.imageExtent = VkExtent3D{ aLevels[i].width, aLevels[i].height, 1 };
+
+			offset += (aLevels[i].size + 15) / 16 * 16;
 		}
 
+		vkCmdCopyBufferToImage( aCmdBuff, aStaging, aImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, mipLevels, copies.data() );
+
+		labutils::image_barrier( aCmdBuff, aImage,
+			VK_ACCESS_TRANSFER_WRITE_BIT,
+			VK_ACCESS_SHADER_READ_BIT,
+			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+			VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+			VK_PIPELINE_STAGE_TRANSFER_BIT,
+			VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+			VkImageSubresourceRange{ VK_IMAGE_ASPECT_COLOR_BIT, 0, mipLevels, 0, 1 }
+		);
+	}
+
+	// Record the upload of a RGBA8 base level from a staging buffer and the
+	// generation of the remaining mip levels by successive blits. The whole
+	// image ends up in SHADER_READ_ONLY_OPTIMAL layout.
+	void record_texture_upload_( VkCommandBuffer cbuff, VkImage aImage, VkBuffer aStaging, VkDeviceSize aStagingOffset, std::uint32_t baseWidth, std::uint32_t baseHeight )
+	{
 		//Transition whole image layout
 		//When copying data to the image, the image's layout must be TRANSFER_DST_OPTIMAL. The current image layout is UNDEFINED (which is the initial layout the image was created in)
-		auto const mipLevels = compute_mip_level_count(baseWidth, baseHeight);
+		auto const mipLevels = labutils::compute_mip_level_count(baseWidth, baseHeight);
 
-		image_barrier(cbuff, ret.image,
+		labutils::image_barrier(cbuff, aImage,
 			0,
 			VK_ACCESS_TRANSFER_WRITE_BIT,
 			VK_IMAGE_LAYOUT_UNDEFINED,
@@ -152,7 +254,7 @@ namespace labutils
 		//We can now issue the copy
 		//Upload data from staging buffer to image
 		VkBufferImageCopy copy;
-		copy.bufferOffset = 0;
+		copy.bufferOffset = aStagingOffset;
 		copy.bufferRowLength = 0;
 		copy.bufferImageHeight = 0;
 		copy.imageSubresource = VkImageSubresourceLayers{
@@ -163,11 +265,11 @@ namespace labutils
 		copy.imageOffset = VkOffset3D{ 0,0,0 };
 		copy.imageExtent = VkExtent3D{ baseWidth, baseHeight, 1 };
 
-		vkCmdCopyBufferToImage(cbuff, staging.buffer, ret.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &copy);
+		vkCmdCopyBufferToImage(cbuff, aStaging, aImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &copy);
 
 		//Read from the base level and blit into the next smaller mipmap level
 		//Transition base level to TRANSFER_SRC_OPTIMAL
-		image_barrier(cbuff, ret.image,
+		labutils::image_barrier(cbuff, aImage,
 			VK_ACCESS_TRANSFER_WRITE_BIT,
 			VK_ACCESS_TRANSFER_READ_BIT,
 			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
@@ -209,14 +311,14 @@ namespace labutils
 			blit.dstOffsets[1] = { int32_t(width), int32_t(height), 1 };
 
 			vkCmdBlitImage(cbuff,
-				ret.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
-				ret.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+				aImage, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+				aImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
 				1, &blit,
 				VK_FILTER_LINEAR
 			);
 
 			//Transition mip level to TRANSFER_SRC_OPTIMAL for the next iteration
-			image_barrier(cbuff, ret.image,
+			labutils::image_barrier(cbuff, aImage,
 				VK_ACCESS_TRANSFER_WRITE_BIT,
 				VK_ACCESS_TRANSFER_READ_BIT,
 				VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
@@ -232,7 +334,7 @@ namespace labutils
 
 		//Whole image is currently in TRANSFER_SRC_OPTIMAL layout
 		//To use the image as a texture from which we sample, it must be in the SHADER_READ_ONLY_OPTIMAL layout
-		image_barrier(cbuff, ret.image,
+		labutils::image_barrier(cbuff, aImage,
 			VK_ACCESS_TRANSFER_READ_BIT,
 			VK_ACCESS_SHADER_READ_BIT,
 			VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
@@ -244,6 +346,64 @@ namespace labutils
 				0, mipLevels,
 				0, 1
 			});
+	}
+}
+
+namespace labutils
+{
+	Image load_image_texture2d( char const* aPath, VulkanContext const& aContext, VkCommandPool aCmdPool, Allocator const& aAllocator )
+	{
+		//Flip image vertically by default
+		stbi_set_flip_vertically_on_load(1);
+
+		//Load base image
+		int baseWidthi, baseHeighti, baseChannelsi;
+		stbi_uc* data = stbi_load(aPath, &baseWidthi, &baseHeighti, &baseChannelsi, 4); //We want 4 channels - RGBA
+
+		if (!data)
+		{
+			throw Error("%s: unable to load texture base image (%s)", aPath, 0, stbi_failure_reason());
+		}
+
+		auto const baseWidth = std::uint32_t(baseWidthi);
+		auto const baseHeight = std::uint32_t(baseHeighti);
+
+		//Create staging buffer and immediately transfer image data to it
+		auto const sizeInBytes = baseWidth * baseHeight * 4;
+
+		auto staging = create_buffer(aAllocator, sizeInBytes, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT);
+
+		void* sptr = nullptr;
+		if (auto const res = vmaMapMemory(aAllocator.allocator, staging.allocation, &sptr); VK_SUCCESS != res)
+		{
+			throw Error("Mapping memory for writing\n" "vmaMapMemory() returned %s", to_string(res).c_str());
+		}
+
+		std::memcpy(sptr, data, sizeInBytes);
+		vmaUnmapMemory(aAllocator.allocator, staging.allocation);
+
+		//Free image data
+		stbi_image_free(data);
+
+		//Create image
+		Image ret = create_image_texture2d(aAllocator, baseWidth, baseHeight, VK_FORMAT_R8G8B8A8_SRGB,
+			VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT);
+
+		//Create command buffer for data upload and begin recording
+		VkCommandBuffer cbuff = alloc_command_buffer(aContext, aCmdPool);
+
+		VkCommandBufferBeginInfo beginInfo{};
+		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		beginInfo.flags = 0;
+		beginInfo.pInheritanceInfo = nullptr;
+
+		if (auto const res = vkBeginCommandBuffer(cbuff, &beginInfo); VK_SUCCESS != res)
+		{
+			throw Error("Beginning command buffer recording\n" "vkBeginCommandBuffer() returned %s", to_string(res).c_str());
+		}
+
+		//Upload base level and generate the mipmap chain
+		record_texture_upload_(cbuff, ret.image, staging.buffer, 0, baseWidth, baseHeight);
 
 		//End command recording
 		if (auto const res = vkEndCommandBuffer(cbuff); VK_SUCCESS != res)
@@ -279,6 +439,221 @@ namespace labutils
 
 	}
 
+	std::vector<Image> load_image_textures2d( char const* const aPaths[], std::size_t aCount, VulkanContext const& aContext, VkCommandPool aCmdPool, Allocator const& aAllocator, VkFormat aFormats[] )
+	{
+		using Clock_ = std::chrono::steady_clock;
+		using Millis_ = std::chrono::duration<double, std::milli>;
+
+		if (0 == aCount)
+			return {};
+
+		//Use pre-compressed textures when available
+		bool const bcSupported = supports_bc1_(aContext);
+
+		//Query image sizes without decoding, so that all images can be
+		//written straight into a single staging buffer
+		struct TextureInfo_
+		{
+			std::uint32_t width, height;
+			VkDeviceSize offset;
+
+			bool compressed;
+			std::string compressedPath;
+			std::vector<btex::Level> levels;
+
+			double decodeMs, copyMs;
+		};
+
+		std::vector<TextureInfo_> infos(aCount);
+
+		//Staging offsets must be a multiple of the texel/block size
+		auto const align16 = [] (VkDeviceSize aSize) { return (aSize + 15) / 16 * 16; };
+
+		VkDeviceSize stagingSize = 0;
+		VkDeviceSize gpuBytes = 0;
+		for (std::size_t i = 0; i < aCount; ++i)
+		{
+			auto& info = infos[i];
+			info.offset = stagingSize;
+			info.compressedPath = std::string(aPaths[i]) + btex::kExtension;
+			info.compressed = bcSupported && read_btex_header_(info.compressedPath.c_str(), aPaths[i], info.width, info.height, info.levels);
+
+			if (info.compressed)
+			{
+				for (auto const& level : info.levels)
+				{
+					stagingSize += align16(level.size);
+					gpuBytes += level.size;
+				}
+
+				continue;
+			}
+
+			int w, h, channels;
+			if (!stbi_info(aPaths[i], &w, &h, &channels))
+			{
+				throw Error("%s: unable to read texture header (%s)", aPaths[i], stbi_failure_reason());
+			}
+
+			info.width = std::uint32_t(w);
+			info.height = std::uint32_t(h);
+
+			stagingSize += align16(VkDeviceSize(w) * VkDeviceSize(h) * 4);
+			gpuBytes += VkDeviceSize(w) * VkDeviceSize(h) * 4 * 4 / 3; // Including mipmaps
+		}
+
+		//Persistently mapped staging buffer for all textures
+		auto staging = create_buffer(aAllocator, stagingSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT | VMA_ALLOCATION_CREATE_MAPPED_BIT);
+
+		VmaAllocationInfo stagingInfo{};
+		vmaGetAllocationInfo(aAllocator.allocator, staging.allocation, &stagingInfo);
+
+		auto* const stagingPtr = static_cast<std::uint8_t*>(stagingInfo.pMappedData);
+		assert(stagingPtr);
+
+		//Flip image vertically by default. This is a global setting in
+		//stb_image, so it is set once before any worker thread starts.
+		stbi_set_flip_vertically_on_load(1);
+
+		//Decode all textures concurrently. Compressed textures are read as-is
+		//(they were flipped by the offline converter).
+		auto const decodeStart = Clock_::now();
+
+		parallel_for(aCount, [&] (std::size_t aIndex) {
+			auto& info = infos[aIndex];
+
+			auto const start = Clock_::now();
+
+			if (info.compressed)
+			{
+				read_btex_levels_(info.compressedPath.c_str(), info.levels, stagingPtr + info.offset);
+
+				info.decodeMs = 0.0;
+				info.copyMs = Millis_(Clock_::now() - start).count();
+				return;
+			}
+
+			int w, h, channels;
+			stbi_uc* data = stbi_load(aPaths[aIndex], &w, &h, &channels, 4); //We want 4 channels - RGBA
+			if (!data)
+			{
+				throw Error("%s: unable to load texture base image (%s)", aPaths[aIndex], stbi_failure_reason());
+			}
+
+			if (std::uint32_t(w) != info.width || std::uint32_t(h) != info.height)
+			{
+				stbi_image_free(data);
+				throw Error("%s: texture size changed while loading", aPaths[aIndex]);
+			}
+
+			auto const decoded = Clock_::now();
+
+			std::memcpy(stagingPtr + info.offset, data, std::size_t(info.width) * info.height * 4);
+			stbi_image_free(data);
+
+			info.decodeMs = Millis_(decoded - start).count();
+			info.copyMs = Millis_(Clock_::now() - decoded).count();
+		});
+
+		auto const decodeMs = Millis_(Clock_::now() - decodeStart).count();
+
+		if (auto const res = vmaFlushAllocation(aAllocator.allocator, staging.allocation, 0, VK_WHOLE_SIZE); VK_SUCCESS != res)
+		{
+			throw Error("Unable to flush staging memory\n" "vmaFlushAllocation() returned %s", to_string(res).c_str());
+		}
+
+		//Create images and record all uploads into a single command buffer
+		auto const uploadStart = Clock_::now();
+
+		std::vector<Image> ret;
+		ret.reserve(aCount);
+
+		VkCommandBuffer cbuff = alloc_command_buffer(aContext, aCmdPool);
+
+		VkCommandBufferBeginInfo beginInfo{};
+		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+		beginInfo.pInheritanceInfo = nullptr;
+
+		if (auto const res = vkBeginCommandBuffer(cbuff, &beginInfo); VK_SUCCESS != res)
+		{
+			throw Error("Beginning command buffer recording\n" "vkBeginCommandBuffer() returned %s", to_string(res).c_str());
+		}
+
+		std::size_t compressedCount = 0;
+		for (std::size_t i = 0; i < aCount; ++i)
+		{
+			auto const& info = infos[i];
+
+			if (info.compressed)
+			{
+				ret.emplace_back(create_image_texture2d(aAllocator, info.width, info.height, VK_FORMAT_BC1_RGBA_SRGB_BLOCK,
+					VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT));
+
+				//All mip levels are uploaded directly; no blits required
+				record_compressed_upload_(cbuff, ret.back().image, staging.buffer, info.offset, info.levels);
+
+				if (aFormats)
+					aFormats[i] = VK_FORMAT_BC1_RGBA_SRGB_BLOCK;
+
+				++compressedCount;
+				continue;
+			}
+
+			ret.emplace_back(create_image_texture2d(aAllocator, info.width, info.height, VK_FORMAT_R8G8B8A8_SRGB,
+				VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT));
+
+			record_texture_upload_(cbuff, ret.back().image, staging.buffer, info.offset, info.width, info.height);
+
+			if (aFormats)
+				aFormats[i] = VK_FORMAT_R8G8B8A8_SRGB;
+		}
+
+		if (auto const res = vkEndCommandBuffer(cbuff); VK_SUCCESS != res)
+		{
+			throw Error("Ending command buffer recording\n" "vkEndCommandBuffer() returned %s", to_string(res).c_str());
+		}
+
+		//Submit once, and wait before the staging buffer is destroyed
+		Fence uploadComplete = create_fence(aContext);
+
+		VkSubmitInfo submitInfo{};
+		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		submitInfo.commandBufferCount = 1;
+		submitInfo.pCommandBuffers = &cbuff;
+
+		if (auto const res = vkQueueSubmit(aContext.graphicsQueue, 1, &submitInfo, uploadComplete.handle); VK_SUCCESS != res)
+		{
+			throw Error("Submitting commands\n" "vkQueueSubmit() returned %s", to_string(res).c_str());
+		}
+
+		if (auto const res = vkWaitForFences(aContext.device, 1, &uploadComplete.handle, VK_TRUE, std::numeric_limits<uint64_t>::max()); VK_SUCCESS != res)
+		{
+			throw Error("Waiting for upload to complete\n" "vkWaitForFences() returned %s", to_string(res).c_str());
+		}
+
+		vkFreeCommandBuffers(aContext.device, aCmdPool, 1, &cbuff);
+
+		auto const uploadMs = Millis_(Clock_::now() - uploadStart).count();
+
+		//Report timings
+		for (std::size_t i = 0; i < aCount; ++i)
+		{
+			std::fprintf(stderr, "  %s: %ux%u%s, decode %.1f ms, staging copy %.1f ms\n",
+				aPaths[i], infos[i].width, infos[i].height, infos[i].compressed ? " BC1" : "", infos[i].decodeMs, infos[i].copyMs
+			);
+		}
+
+		std::fprintf(stderr, "Loaded %zu textures (%zu pre-compressed): decode %.1f ms (wall), GPU upload %.1f ms, %.1f MiB staging, %.1f MiB texture memory\n",
+			aCount, compressedCount, decodeMs, uploadMs, stagingSize / (1024.0 * 1024.0), gpuBytes / (1024.0 * 1024.0)
+		);
+
+		if (!bcSupported)
+			std::fprintf(stderr, "Note: BC1 textures are not supported by the device; using uncompressed textures\n");
+
+		return ret;
+	}
+
 	Image create_image_texture2d( Allocator const& aAllocator, std::uint32_t aWidth, std::uint32_t aHeight, VkFormat aFormat, VkImageUsageFlags aUsage )
 	{
 		auto const mipLevels = compute_mip_level_count(aWidth, aHeight);
@@ -3,9 +3,11 @@
 #include <volk/volk.h>
 #include <vk_mem_alloc.h>
 
+#include <vector>
 #include <utility>
 
 #include <cassert>
+#include <cstddef>
 
 #include "allocator.hpp"
 
@@ -36,6 +38,15 @@ namespace labutils
 
 	Image load_image_texture2d( char const* aPath, VulkanContext const&, VkCommandPool, Allocator const& );
 
+	// Load several textures at once. Images are decoded concurrently on
+	// worker threads, directly into one staging buffer; all uploads and mip
+	// generation then go through a single submission. Timings are logged.
+	//
+	// If an up-to-date "<path>.btex" file exists (see tools/texconv) and the
+	// device supports BC1, the pre-compressed mip chain is uploaded instead.
+	// The format of each image is returned in aFormats, if non-null.
+	std::vector<Image> load_image_textures2d( char const* const aPaths[], std::size_t aCount, VulkanContext const&, VkCommandPool, Allocator const&, VkFormat aFormats[] = nullptr );
+
 	Image create_image_texture2d( Allocator const&, std::uint32_t aWidth, std::uint32_t aHeight, VkFormat, VkImageUsageFlags = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT );
 
 	std::uint32_t compute_mip_level_count( std::uint32_t aWidth, std::uint32_t aHeight );
@@ -96,11 +96,14 @@ namespace labutils
 
 	using Pipeline = UniqueHandle< VkPipeline, VkDevice, vkDestroyPipeline >;
 	using PipelineLayout = UniqueHandle< VkPipelineLayout, VkDevice, vkDestroyPipelineLayout >;
+	using PipelineCache = UniqueHandle< VkPipelineCache, VkDevice, vkDestroyPipelineCache >;
 
 	using ShaderModule = UniqueHandle< VkShaderModule, VkDevice, vkDestroyShaderModule >;
 
 	using CommandPool = UniqueHandle< VkCommandPool, VkDevice, vkDestroyCommandPool >;
 
+	using QueryPool = UniqueHandle< VkQueryPool, VkDevice, vkDestroyQueryPool >;
+
 	using Fence = UniqueHandle< VkFence, VkDevice, vkDestroyFence >;
 	using Semaphore = UniqueHandle< VkSemaphore, VkDevice, vkDestroySemaphore >;
 
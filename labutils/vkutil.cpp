@@ -176,7 +176,11 @@ namespace labutils
 	{
 		VkDescriptorPoolSize const pools[] = {
 			{VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, aMaxDescriptors},
+			{VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, aMaxDescriptors},
 			{VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, aMaxDescriptors},
+			{VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, aMaxDescriptors},
+			{VK_DESCRIPTOR_TYPE_SAMPLER, aMaxDescriptors},
+			{VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, aMaxDescriptors},
 			{VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, aMaxDescriptors} //For the storage image
 		};
 
@@ -236,41 +240,25 @@ namespace labutils
 		return ImageView(aContext.device, view);
 	}
 
-	Sampler create_default_sampler(VulkanContext const& aContext, bool anisotropic)
+	Sampler create_sampler(VulkanContext const& aContext, SamplerDesc const& aDesc)
 	{
 		VkSamplerCreateInfo samplerInfo{};
-
 		samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
-		samplerInfo.magFilter = VK_FILTER_LINEAR;
-		samplerInfo.minFilter = VK_FILTER_LINEAR;
-		samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+		samplerInfo.magFilter = aDesc.filter;
+		samplerInfo.minFilter = aDesc.filter;
+		samplerInfo.mipmapMode = aDesc.mipmapMode;
 		samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
 		samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
 		samplerInfo.minLod = 0.f;
 		samplerInfo.maxLod = VK_LOD_CLAMP_NONE;
-		samplerInfo.mipLodBias = 0.5f;
-
+		samplerInfo.mipLodBias = aDesc.mipLodBias;
 
-		if (anisotropic)
+		if (aDesc.maxAnisotropy > 1.f)
 		{
-			//Check whether anisotropic filtering is enabled
-			VkPhysicalDeviceFeatures supportedFeatures;
-			vkGetPhysicalDeviceFeatures(aContext.physicalDevice, &supportedFeatures);
-
-			if (supportedFeatures.samplerAnisotropy)
-			{
-				samplerInfo.anisotropyEnable = VK_TRUE;
-
-				//Get the maximum anisotropy from the device
-				VkPhysicalDeviceProperties deviceProperties;
-				vkGetPhysicalDeviceProperties(aContext.physicalDevice, &deviceProperties);
-
-				samplerInfo.maxAnisotropy = deviceProperties.limits.maxSamplerAnisotropy;
-			}
+			samplerInfo.anisotropyEnable = VK_TRUE;
+			samplerInfo.maxAnisotropy = aDesc.maxAnisotropy;
 		}
-	
-	
-		
+
 		VkSampler sampler = VK_NULL_HANDLE;
 		if (auto const res = vkCreateSampler(aContext.device, &samplerInfo, nullptr, &sampler); VK_SUCCESS != res)
 		{
@@ -50,6 +50,19 @@ namespace labutils
 
 	ImageView create_image_view_texture2d(VulkanContext const&, VkImage, VkFormat);
 
-	Sampler create_default_sampler(VulkanContext const&, bool anisotropic);
+	// Texture sampler with configurable filtering. The defaults give the
+	// renderer's default sampler (trilinear, slightly blurred). Anisotropic
+	// filtering is enabled when maxAnisotropy is above 1; the caller must
+	// check that the samplerAnisotropy feature is enabled and clamp the
+	// values to the device limits.
+	struct SamplerDesc
+	{
+		VkFilter filter = VK_FILTER_LINEAR;
+		VkSamplerMipmapMode mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+		float maxAnisotropy = 1.f;
+		float mipLodBias = 0.5f;
+	};
+
+	Sampler create_sampler(VulkanContext const&, SamplerDesc const&);
 
 }
@@ -21,7 +21,8 @@ namespace
 
 	VkDevice create_device( 
 		VkPhysicalDevice,
-		std::uint32_t aQueueFamily
+		std::uint32_t aQueueFamily,
+		VkPhysicalDeviceVulkan12Features const* aFeatures12 = nullptr
 	);
 }
 
@@ -51,6 +52,8 @@ namespace labutils
 		, device( std::exchange( aOther.device, VK_NULL_HANDLE ) )
 		, graphicsFamilyIndex( aOther.graphicsFamilyIndex )
 		, graphicsQueue( std::exchange( aOther.graphicsQueue, VK_NULL_HANDLE ) )
+		, haveDrawIndirectCount( aOther.haveDrawIndirectCount )
+		, haveDescriptorIndexing( aOther.haveDescriptorIndexing )
 		, debugMessenger( std::exchange( aOther.debugMessenger, VK_NULL_HANDLE ) )
 	{}
 
@@ -72,6 +75,8 @@ namespace labutils
 		std::swap( device, aOther.device );
 		std::swap( graphicsFamilyIndex, aOther.graphicsFamilyIndex );
 		std::swap( graphicsQueue, aOther.graphicsQueue );
+		std::swap( haveDrawIndirectCount, aOther.haveDrawIndirectCount );
+		std::swap( haveDescriptorIndexing, aOther.haveDescriptorIndexing );
 		std::swap( debugMessenger, aOther.debugMessenger );
 		return *this;
 	}
@@ -149,7 +154,37 @@ namespace labutils
 			throw lut::Error( "No queue family with GRAPHICS" );
 		}
 
-		ret.device = create_device( ret.physicalDevice, ret.graphicsFamilyIndex );
+		// Enable optional Vulkan 1.2 features, like make_vulkan_window() does.
+		// The device selection ensures that the device supports Vulkan 1.2.
+		VkPhysicalDeviceVulkan12Features supported12{};
+		supported12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+
+		VkPhysicalDeviceFeatures2 features2{};
+		features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+		features2.pNext = &supported12;
+
+		vkGetPhysicalDeviceFeatures2( ret.physicalDevice, &features2 );
+
+		VkPhysicalDeviceVulkan12Features enabled12{};
+		enabled12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+
+		if( supported12.drawIndirectCount )
+		{
+			enabled12.drawIndirectCount = VK_TRUE;
+			ret.haveDrawIndirectCount = true;
+		}
+
+		if( supported12.runtimeDescriptorArray && supported12.descriptorBindingVariableDescriptorCount )
+		{
+			enabled12.runtimeDescriptorArray = VK_TRUE;
+			enabled12.descriptorBindingVariableDescriptorCount = VK_TRUE;
+			ret.haveDescriptorIndexing = true;
+		}
+
+		std::fprintf( stderr, "Feature drawIndirectCount: %s\n", ret.haveDrawIndirectCount ? "enabled" : "not supported" );
+		std::fprintf( stderr, "Feature descriptor indexing: %s\n", ret.haveDescriptorIndexing ? "enabled" : "not supported" );
+
+		ret.device = create_device( ret.physicalDevice, ret.graphicsFamilyIndex, &enabled12 );
 
 		// Retrieve VkQueue
 		vkGetDeviceQueue( ret.device, ret.graphicsFamilyIndex, 0, &ret.graphicsQueue );
@@ -182,7 +217,7 @@ namespace
 		return {};
 	}
 
-	VkDevice create_device( VkPhysicalDevice aPhysicalDev, std::uint32_t aQueueFamily )
+	VkDevice create_device( VkPhysicalDevice aPhysicalDev, std::uint32_t aQueueFamily, VkPhysicalDeviceVulkan12Features const* aFeatures12 )
 	{
 		float queuePriorities[1] = { 1.f };
 
@@ -192,11 +227,14 @@ namespace
 		queueInfo.queueCount        = 1;
 		queueInfo.pQueuePriorities  = queuePriorities;
 
+		// Enable all supported core features, as the renderer does not
+		// distinguish between a windowed and an offscreen device
 		VkPhysicalDeviceFeatures deviceFeatures{};
-		// No extra features for now.
+		vkGetPhysicalDeviceFeatures( aPhysicalDev, &deviceFeatures );
 		
 		VkDeviceCreateInfo deviceInfo{};
 		deviceInfo.sType  = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+		deviceInfo.pNext  = aFeatures12;
 
 		deviceInfo.queueCreateInfoCount  = 1;
 		deviceInfo.pQueueCreateInfos     = &queueInfo;
@@ -28,6 +28,10 @@ namespace labutils
 			std::uint32_t graphicsFamilyIndex = 0;
 			VkQueue graphicsQueue = VK_NULL_HANDLE;
 
+			// Optional features, enabled if the device supports them
+			bool haveDrawIndirectCount = false; // Vulkan 1.2 drawIndirectCount
+			bool haveDescriptorIndexing = false; // Vulkan 1.2 runtimeDescriptorArray and descriptorBindingVariableDescriptorCount
+
 			
 			//bool haveDebugUtils = false;
 			VkDebugUtilsMessengerEXT debugMessenger = VK_NULL_HANDLE;
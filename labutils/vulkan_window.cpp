@@ -30,7 +30,8 @@ namespace
 	VkDevice create_device( 
 		VkPhysicalDevice,
 		std::vector<std::uint32_t> const& aQueueFamilies,
-		std::vector<char const*> const& aEnabledDeviceExtensions = {}
+		std::vector<char const*> const& aEnabledDeviceExtensions = {},
+		VkPhysicalDeviceVulkan12Features const* aFeatures12 = nullptr
 	);
 
 	std::vector<VkSurfaceFormatKHR> get_surface_formats( VkPhysicalDevice, VkSurfaceKHR );
@@ -47,6 +48,8 @@ namespace
 
 	void get_swapchain_images( VkDevice, VkSwapchainKHR, std::vector<VkImage>& );
 	void create_swapchain_image_views( VkDevice, VkFormat, std::vector<VkImage> const&, std::vector<VkImageView>& );
+
+	void create_offscreen_images( VkPhysicalDevice, VkDevice, VkFormat, VkExtent2D, std::uint32_t aCount, std::vector<VkImage>&, std::vector<VkDeviceMemory>& );
 }
 
 namespace labutils
@@ -63,6 +66,17 @@ namespace labutils
 		if( VK_NULL_HANDLE != swapchain )
 			vkDestroySwapchainKHR( device, swapchain, nullptr );
 
+		// Offscreen windows own their images; swap chain images are owned by
+		// the swap chain
+		if( VK_NULL_HANDLE == surface )
+		{
+			for( auto const image : swapImages )
+				vkDestroyImage( device, image, nullptr );
+		}
+
+		for( auto const memory : offscreenMemory )
+			vkFreeMemory( device, memory, nullptr );
+
 		// Window and related objects
 		if( VK_NULL_HANDLE != surface )
 			vkDestroySurfaceKHR( instance, surface, nullptr );
@@ -92,6 +106,7 @@ namespace labutils
 		, swapViews( std::move( aOther.swapViews ) )
 		, swapchainFormat( aOther.swapchainFormat )
 		, swapchainExtent( aOther.swapchainExtent )
+		, offscreenMemory( std::move( aOther.offscreenMemory ) )
 	{}
 
 	VulkanWindow& VulkanWindow::operator=( VulkanWindow&& aOther ) noexcept
@@ -106,6 +121,7 @@ namespace labutils
 		std::swap( swapViews, aOther.swapViews );
 		std::swap( swapchainFormat, aOther.swapchainFormat );
 		std::swap( swapchainExtent, aOther.swapchainExtent );
+		std::swap( offscreenMemory, aOther.offscreenMemory );
 		return *this;
 	}
 
@@ -254,7 +270,37 @@ namespace labutils
 			queueFamilyIndices.emplace_back(*present);
 		}
 
-		ret.device = create_device( ret.physicalDevice, queueFamilyIndices, enabledDevExensions );
+		// Enable optional Vulkan 1.2 features. The device selection ensures
+		// that the device supports Vulkan 1.2.
+		VkPhysicalDeviceVulkan12Features supported12{};
+		supported12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+
+		VkPhysicalDeviceFeatures2 features2{};
+		features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+		features2.pNext = &supported12;
+
+		vkGetPhysicalDeviceFeatures2( ret.physicalDevice, &features2 );
+
+		VkPhysicalDeviceVulkan12Features enabled12{};
+		enabled12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+
+		if( supported12.drawIndirectCount )
+		{
+			enabled12.drawIndirectCount = VK_TRUE;
+			ret.haveDrawIndirectCount = true;
+		}
+
+		if( supported12.runtimeDescriptorArray && supported12.descriptorBindingVariableDescriptorCount )
+		{
+			enabled12.runtimeDescriptorArray = VK_TRUE;
+			enabled12.descriptorBindingVariableDescriptorCount = VK_TRUE;
+			ret.haveDescriptorIndexing = true;
+		}
+
+		std::fprintf( stderr, "Feature drawIndirectCount: %s\n", ret.haveDrawIndirectCount ? "enabled" : "not supported" );
+		std::fprintf( stderr, "Feature descriptor indexing: %s\n", ret.haveDescriptorIndexing ? "enabled" : "not supported" );
+
+		ret.device = create_device( ret.physicalDevice, queueFamilyIndices, enabledDevExensions, &enabled12 );
 
 		// Retrieve VkQueues
 		vkGetDeviceQueue( ret.device, ret.graphicsFamilyIndex, 0, &ret.graphicsQueue );
@@ -280,6 +326,30 @@ namespace labutils
 		return ret;
 	}
 
+	// make_offscreen_window()
+	VulkanWindow make_offscreen_window( VkExtent2D aExtent, std::uint32_t aImageCount )
+	{
+		VulkanWindow ret;
+
+		// The device does not need any surface or presentation support
+		static_cast<VulkanContext&>(ret) = make_vulkan_context();
+
+		ret.presentFamilyIndex = ret.graphicsFamilyIndex;
+		ret.presentQueue = ret.graphicsQueue;
+
+		// 8-bit sRGB, like the swap chain, so that the images can be written
+		// to disk as-is. This format supports colour attachments on all
+		// devices.
+		ret.swapchainFormat = VK_FORMAT_R8G8B8A8_SRGB;
+		ret.swapchainExtent = aExtent;
+
+		create_offscreen_images( ret.physicalDevice, ret.device, ret.swapchainFormat, ret.swapchainExtent, aImageCount, ret.swapImages, ret.offscreenMemory );
+		create_swapchain_image_views( ret.device, ret.swapchainFormat, ret.swapImages, ret.swapViews );
+
+		// Done
+		return ret;
+	}
+
 	SwapChanges recreate_swapchain( VulkanWindow& aWindow )
 	{
 		//Remember old formats and extents
@@ -541,6 +611,84 @@ namespace
 
 		assert( aViews.size() == aImages.size() );
 	}
+
+	void create_offscreen_images( VkPhysicalDevice aPhysicalDev, VkDevice aDevice, VkFormat aFormat, VkExtent2D aExtent, std::uint32_t aCount, std::vector<VkImage>& aImages, std::vector<VkDeviceMemory>& aMemory )
+	{
+		assert( 0 == aImages.size() && 0 == aMemory.size() );
+
+		VkPhysicalDeviceMemoryProperties memProps;
+		vkGetPhysicalDeviceMemoryProperties( aPhysicalDev, &memProps );
+
+		for( std::uint32_t i = 0; i < aCount; ++i )
+		{
+			VkImageCreateInfo imageInfo{};
+			imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+			imageInfo.imageType = VK_IMAGE_TYPE_2D;
+			imageInfo.format = aFormat;
+			imageInfo.extent = VkExtent3D{ aExtent.width, aExtent.height, 1 };
+			imageInfo.mipLevels = 1;
+			imageInfo.arrayLayers = 1;
+			imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+			imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+			imageInfo.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+			imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+			imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+			VkImage image = VK_NULL_HANDLE;
+			if( auto const res = vkCreateImage( aDevice, &imageInfo, nullptr, &image ); VK_SUCCESS != res )
+			{
+				throw lut::Error( "Unable to create offscreen image %u\n"
+					"vkCreateImage() returned %s", i, lut::to_string(res).c_str()
+				);
+			}
+
+			aImages.emplace_back( image );
+
+			// Prefer device-local memory. Software implementations may only
+			// expose a single, host-visible memory type.
+			VkMemoryRequirements memReqs;
+			vkGetImageMemoryRequirements( aDevice, image, &memReqs );
+
+			std::optional<std::uint32_t> memType;
+			for( std::uint32_t type = 0; type < memProps.memoryTypeCount; ++type )
+			{
+				if( !(memReqs.memoryTypeBits & (1u << type)) )
+					continue;
+
+				if( !memType || (VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT & memProps.memoryTypes[type].propertyFlags) )
+				{
+					memType = type;
+					if( VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT & memProps.memoryTypes[type].propertyFlags )
+						break;
+				}
+			}
+
+			if( !memType )
+				throw lut::Error( "No memory type for offscreen image %u", i );
+
+			VkMemoryAllocateInfo allocInfo{};
+			allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+			allocInfo.allocationSize = memReqs.size;
+			allocInfo.memoryTypeIndex = *memType;
+
+			VkDeviceMemory memory = VK_NULL_HANDLE;
+			if( auto const res = vkAllocateMemory( aDevice, &allocInfo, nullptr, &memory ); VK_SUCCESS != res )
+			{
+				throw lut::Error( "Unable to allocate memory for offscreen image %u\n"
+					"vkAllocateMemory() returned %s", i, lut::to_string(res).c_str()
+				);
+			}
+
+			aMemory.emplace_back( memory );
+
+			if( auto const res = vkBindImageMemory( aDevice, image, memory, 0 ); VK_SUCCESS != res )
+			{
+				throw lut::Error( "Unable to bind memory to offscreen image %u\n"
+					"vkBindImageMemory() returned %s", i, lut::to_string(res).c_str()
+				);
+			}
+		}
+	}
 }
 
 namespace
@@ -582,7 +730,7 @@ namespace
 		return {};
 	}
 
-	VkDevice create_device( VkPhysicalDevice aPhysicalDev, std::vector<std::uint32_t> const& aQueues, std::vector<char const*> const& aEnabledExtensions )
+	VkDevice create_device( VkPhysicalDevice aPhysicalDev, std::vector<std::uint32_t> const& aQueues, std::vector<char const*> const& aEnabledExtensions, VkPhysicalDeviceVulkan12Features const* aFeatures12 )
 	{
 		if( aQueues.empty() )
 			throw lut::Error( "create_device(): no queues requested" );
@@ -604,6 +752,7 @@ namespace
 		
 		VkDeviceCreateInfo deviceInfo{};
 		deviceInfo.sType  = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+		deviceInfo.pNext  = aFeatures12;
 
 		deviceInfo.queueCreateInfoCount     = std::uint32_t(queueInfos.size());
 		deviceInfo.pQueueCreateInfos        = queueInfos.data();
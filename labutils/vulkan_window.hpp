@@ -39,10 +39,20 @@ namespace labutils
 
 			VkFormat swapchainFormat;
 			VkExtent2D swapchainExtent;
+
+			// Backing memory of the images of an offscreen window
+			std::vector<VkDeviceMemory> offscreenMemory;
 	};
 
 	VulkanWindow make_vulkan_window();
 
+	// Create a window without GLFW, surface or swap chain, based on
+	// make_vulkan_context(). swapImages holds aImageCount offscreen images
+	// (colour attachment and transfer source) that are owned by the window.
+	// There is nothing to acquire or present; presentQueue is the graphics
+	// queue. Useful for benchmarks and on machines without a display.
+	VulkanWindow make_offscreen_window( VkExtent2D, std::uint32_t aImageCount );
+
 
 	struct SwapChanges
 	{
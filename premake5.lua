@@ -87,6 +87,14 @@ project "basic-vulkan"
 	dependson "x-glm" 
 	dependson "x-rapidobj"
 
+project "texconv"
+	kind "ConsoleApp"
+	location "tools/texconv"
+
+	files( "tools/texconv/**.cpp" )
+
+	links "x-stb"
+
 project "shaders"
 	local shaders = { 
 		"src/shaders/*.vert",
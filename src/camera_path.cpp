@@ -0,0 +1,185 @@
+#include "camera_path.hpp"
+
+#include <utility>
+#include <algorithm>
+
+#include <cmath>
+#include <cstdio>
+#include <cassert>
+#include <cstring>
+
+#include <glm/mat3x3.hpp>
+
+namespace
+{
+	// File layout:
+	//  - PathHeader_
+	//  - PathRecord_[sampleCount]
+	//
+	// Bump kPathVersion whenever the layout changes.
+	constexpr char kPathMagic[8] = { 'C', 'A', 'M', 'E', 'R', 'A', 'P', 'T' };
+	constexpr std::uint32_t kPathVersion = 1;
+
+	struct PathHeader_
+	{
+		char magic[8];
+		std::uint32_t version;
+		std::uint32_t sampleCount;
+	};
+
+	struct PathRecord_
+	{
+		float time;
+		std::uint32_t inputs;
+		float position[3];
+		float orientation[4]; // x, y, z, w
+	};
+
+	static_assert( sizeof(PathRecord_) == 36, "PathRecord_ must be packed" );
+}
+
+void add_camera_sample( CameraPath& aPath, float aTime, std::uint32_t aInputs, glm::mat4 const& aCamera2World )
+{
+	assert( aPath.samples.empty() || aPath.samples.back().time <= aTime );
+
+	CameraSample sample;
+	sample.time = aTime;
+	sample.inputs = aInputs;
+	sample.position = glm::vec3( aCamera2World[3] );
+	sample.orientation = glm::normalize( glm::quat_cast( glm::mat3( aCamera2World ) ) );
+
+	aPath.samples.emplace_back( sample );
+}
+
+float camera_path_duration( CameraPath const& aPath )
+{
+	return aPath.samples.empty() ? 0.f : aPath.samples.back().time;
+}
+
+glm::mat4 sample_camera_path( CameraPath const& aPath, float aTime, std::uint32_t* aInputs )
+{
+	assert( !aPath.samples.empty() );
+	auto const& samples = aPath.samples;
+
+	// First sample after aTime; the one before it is the last sample at or
+	// before aTime
+	auto const next = std::upper_bound( samples.begin(), samples.end(), aTime,
+		[] (float aValue, CameraSample const& aSample) { return aValue < aSample.time; }
+	);
+
+	CameraSample const& a = samples.begin() == next ? *next : *(next - 1);
+	CameraSample const& b = samples.end() == next ? a : *next;
+
+	if( aInputs )
+		*aInputs = a.inputs;
+
+	float const span = b.time - a.time;
+	float const t = span > 0.f ? std::clamp( (aTime - a.time) / span, 0.f, 1.f ) : 0.f;
+
+	// slerp() takes the shorter way around
+	glm::mat4 ret = glm::mat4_cast( glm::slerp( a.orientation, b.orientation, t ) );
+	ret[3] = glm::vec4( glm::mix( a.position, b.position, t ), 1.f );
+	return ret;
+}
+
+bool write_camera_path( char const* aFilePath, CameraPath const& aPath )
+{
+	assert( aFilePath );
+
+	PathHeader_ header{};
+	std::memcpy( header.magic, kPathMagic, sizeof(kPathMagic) );
+	header.version = kPathVersion;
+	header.sampleCount = std::uint32_t(aPath.samples.size());
+
+	std::vector<PathRecord_> records( aPath.samples.size() );
+	for( std::size_t i = 0; i < records.size(); ++i )
+	{
+		auto const& sample = aPath.samples[i];
+		auto& record = records[i];
+
+		record.time = sample.time;
+		record.inputs = sample.inputs;
+		record.position[0] = sample.position.x;
+		record.position[1] = sample.position.y;
+		record.position[2] = sample.position.z;
+		record.orientation[0] = sample.orientation.x;
+		record.orientation[1] = sample.orientation.y;
+		record.orientation[2] = sample.orientation.z;
+		record.orientation[3] = sample.orientation.w;
+	}
+
+	std::FILE* file = std::fopen( aFilePath, "wb" );
+	if( !file )
+		return false;
+
+	bool ok = 1 == std::fwrite( &header, sizeof(header), 1, file );
+	if( ok && !records.empty() )
+		ok = records.size() == std::fwrite( records.data(), sizeof(PathRecord_), records.size(), file );
+
+	ok = (0 == std::fclose( file )) && ok;
+	return ok;
+}
+
+bool load_camera_path( char const* aFilePath, CameraPath& aPath )
+{
+	assert( aFilePath );
+
+	std::FILE* file = std::fopen( aFilePath, "rb" );
+	if( !file )
+		return false;
+
+	PathHeader_ header{};
+	std::vector<PathRecord_> records;
+
+	bool ok = 1 == std::fread( &header, sizeof(header), 1, file )
+		&& 0 == std::memcmp( header.magic, kPathMagic, sizeof(kPathMagic) )
+		&& kPathVersion == header.version;
+
+	// The sample count must match the file size; this rejects corrupt
+	// counts before allocating any memory for them
+	if( ok )
+	{
+		long const dataStart = std::ftell( file );
+		ok = dataStart >= 0 && 0 == std::fseek( file, 0, SEEK_END );
+
+		long const fileEnd = ok ? std::ftell( file ) : -1;
+		ok = ok && fileEnd >= dataStart
+			&& std::uint64_t(fileEnd - dataStart) == std::uint64_t(header.sampleCount) * sizeof(PathRecord_)
+			&& 0 == std::fseek( file, dataStart, SEEK_SET );
+	}
+
+	if( ok )
+	{
+		records.resize( header.sampleCount );
+		ok = records.empty() || records.size() == std::fread( records.data(), sizeof(PathRecord_), records.size(), file );
+	}
+
+	std::fclose( file );
+
+	if( !ok )
+		return false;
+
+	CameraPath path;
+	path.samples.reserve( records.size() );
+
+	for( auto const& record : records )
+	{
+		// Samples are expected in order by sample_camera_path(). Non-finite
+		// times cannot be ordered.
+		if( !std::isfinite( record.time ) )
+			return false;
+		if( !path.samples.empty() && record.time < path.samples.back().time )
+			return false;
+
+		CameraSample sample;
+		sample.time = record.time;
+		sample.inputs = record.inputs;
+		sample.position = glm::vec3( record.position[0], record.position[1], record.position[2] );
+		sample.orientation = glm::quat( record.orientation[3], record.orientation[0], record.orientation[1], record.orientation[2] );
+
+		path.samples.emplace_back( sample );
+	}
+
+	aPath = std::move( path );
+	return true;
+}
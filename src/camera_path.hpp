@@ -0,0 +1,51 @@
+#ifndef CAMERA_PATH_HPP_9D1724A9_F580_4D20_957A_90BF1EA6EC8C
+#define CAMERA_PATH_HPP_9D1724A9_F580_4D20_957A_90BF1EA6EC8C
+
+#include <vector>
+
+#include <cstdint>
+
+#include <glm/vec3.hpp>
+#include <glm/mat4x4.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+// Recorded camera path
+//
+// Each sample holds the time at which it was recorded, the input toggles
+// that were active (one bit per input, defined by the caller) and the
+// camera-to-world transform, stored as position and orientation. The
+// transform must not contain any scaling.
+struct CameraSample
+{
+	float time; // Seconds since the start of the recording
+	std::uint32_t inputs;
+
+	glm::vec3 position;
+	glm::quat orientation;
+};
+
+struct CameraPath
+{
+	std::vector<CameraSample> samples;
+};
+
+// Append a sample. Samples must be added in order of increasing time.
+void add_camera_sample( CameraPath& aPath, float aTime, std::uint32_t aInputs, glm::mat4 const& aCamera2World );
+
+// Time of the last sample, or zero if the path is empty
+float camera_path_duration( CameraPath const& aPath );
+
+// Camera-to-world transform at time aTime, interpolated between the two
+// neighbouring samples. Times outside of the path are clamped to it. If
+// aInputs is not null, it receives the inputs of the last sample at or
+// before aTime. The path must not be empty.
+glm::mat4 sample_camera_path( CameraPath const& aPath, float aTime, std::uint32_t* aInputs = nullptr );
+
+// Binary file I/O. The file holds a small header followed by the packed
+// samples (36 bytes each). It is not portable between machines with
+// different endianness. Both functions return false on failure; a file
+// with the wrong format or version is not loaded.
+bool write_camera_path( char const* aFilePath, CameraPath const& aPath );
+bool load_camera_path( char const* aFilePath, CameraPath& aPath );
+
+#endif // CAMERA_PATH_HPP_9D1724A9_F580_4D20_957A_90BF1EA6EC8C
@@ -0,0 +1,156 @@
+#include "culling.hpp"
+
+#include <cmath>
+#include <cassert>
+
+#include <glm/geometric.hpp>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#	define CULLING_USE_SSE_ 1
+#	include <xmmintrin.h>
+#else
+#	define CULLING_USE_SSE_ 0
+#endif
+
+namespace
+{
+	constexpr std::size_t kBatchSize = 4;
+
+	glm::vec4 row_( glm::mat4 const& aMat, int aRow )
+	{
+		// GLM matrices are column-major
+		return glm::vec4( aMat[0][aRow], aMat[1][aRow], aMat[2][aRow], aMat[3][aRow] );
+	}
+
+	glm::vec4 normalize_plane_( glm::vec4 const& aPlane )
+	{
+		float const len = glm::length( glm::vec3( aPlane ) );
+		return len > 0.f ? aPlane / len : aPlane;
+	}
+}
+
+Frustum extract_frustum_planes( glm::mat4 const& aProjCam )
+{
+	// Gribb & Hartmann: a clip-space point (x,y,z,w) is inside if -w <= x <= w,
+	// -w <= y <= w and 0 <= z <= w. Each inequality is a plane in world space,
+	// expressed in terms of the rows of the matrix.
+	glm::vec4 const r0 = row_( aProjCam, 0 );
+	glm::vec4 const r1 = row_( aProjCam, 1 );
+	glm::vec4 const r2 = row_( aProjCam, 2 );
+	glm::vec4 const r3 = row_( aProjCam, 3 );
+
+	Frustum ret;
+	ret.planes[0] = normalize_plane_( r3 + r0 ); // left
+	ret.planes[1] = normalize_plane_( r3 - r0 ); // right
+	ret.planes[2] = normalize_plane_( r3 + r1 ); // bottom
+	ret.planes[3] = normalize_plane_( r3 - r1 ); // top
+	ret.planes[4] = normalize_plane_( r2 );      // near
+	ret.planes[5] = normalize_plane_( r3 - r2 ); // far
+	return ret;
+}
+
+void add_bounds( CullingBounds& aBounds, glm::vec3 const& aMin, glm::vec3 const& aMax )
+{
+	std::size_t const index = aBounds.count++;
+
+	// Grow by a full batch at a time; unused entries remain empty boxes at
+	// the origin, and their results are never written.
+	if( index % kBatchSize == 0 )
+	{
+		std::size_t const size = index + kBatchSize;
+		aBounds.centerX.resize( size, 0.f );
+		aBounds.centerY.resize( size, 0.f );
+		aBounds.centerZ.resize( size, 0.f );
+		aBounds.extentX.resize( size, 0.f );
+		aBounds.extentY.resize( size, 0.f );
+		aBounds.extentZ.resize( size, 0.f );
+	}
+
+	glm::vec3 const center = 0.5f * (aMin + aMax);
+	glm::vec3 const extent = 0.5f * (aMax - aMin);
+
+	aBounds.centerX[index] = center.x;
+	aBounds.centerY[index] = center.y;
+	aBounds.centerZ[index] = center.z;
+	aBounds.extentX[index] = extent.x;
+	aBounds.extentY[index] = extent.y;
+	aBounds.extentZ[index] = extent.z;
+}
+
+std::size_t cull_aabbs( Frustum const& aFrustum, CullingBounds const& aBounds, std::uint8_t* aVisible )
+{
+	assert( aVisible || 0 == aBounds.count );
+	assert( aBounds.centerX.size() % kBatchSize == 0 );
+
+	// A box is outside of a plane if even its corner furthest along the
+	// plane normal is behind the plane, i.e., if
+	//   dot(n, c) + d + dot(|n|, e) < 0
+	// where c is the box's center and e its half-extent.
+	std::size_t visibleCount = 0;
+
+#	if CULLING_USE_SSE_
+	__m128 nx[6], ny[6], nz[6], nd[6];
+	__m128 ax[6], ay[6], az[6];
+	for( int p = 0; p < 6; ++p )
+	{
+		glm::vec4 const& plane = aFrustum.planes[p];
+		nx[p] = _mm_set1_ps( plane.x );
+		ny[p] = _mm_set1_ps( plane.y );
+		nz[p] = _mm_set1_ps( plane.z );
+		nd[p] = _mm_set1_ps( plane.w );
+		ax[p] = _mm_set1_ps( std::abs( plane.x ) );
+		ay[p] = _mm_set1_ps( std::abs( plane.y ) );
+		az[p] = _mm_set1_ps( std::abs( plane.z ) );
+	}
+
+	for( std::size_t i = 0; i < aBounds.count; i += kBatchSize )
+	{
+		__m128 const cx = _mm_loadu_ps( aBounds.centerX.data() + i );
+		__m128 const cy = _mm_loadu_ps( aBounds.centerY.data() + i );
+		__m128 const cz = _mm_loadu_ps( aBounds.centerZ.data() + i );
+		__m128 const ex = _mm_loadu_ps( aBounds.extentX.data() + i );
+		__m128 const ey = _mm_loadu_ps( aBounds.extentY.data() + i );
+		__m128 const ez = _mm_loadu_ps( aBounds.extentZ.data() + i );
+
+		__m128 inside = _mm_cmpeq_ps( cx, cx ); // all ones
+		for( int p = 0; p < 6; ++p )
+		{
+			__m128 dist = _mm_add_ps( _mm_mul_ps( nx[p], cx ), nd[p] );
+			dist = _mm_add_ps( dist, _mm_mul_ps( ny[p], cy ) );
+			dist = _mm_add_ps( dist, _mm_mul_ps( nz[p], cz ) );
+
+			__m128 rad = _mm_mul_ps( ax[p], ex );
+			rad = _mm_add_ps( rad, _mm_mul_ps( ay[p], ey ) );
+			rad = _mm_add_ps( rad, _mm_mul_ps( az[p], ez ) );
+
+			inside = _mm_and_ps( inside, _mm_cmpge_ps( _mm_add_ps( dist, rad ), _mm_setzero_ps() ) );
+		}
+
+		int const mask = _mm_movemask_ps( inside );
+		std::size_t const end = i + kBatchSize < aBounds.count ? kBatchSize : aBounds.count - i;
+		for( std::size_t j = 0; j < end; ++j )
+		{
+			std::uint8_t const visible = (mask >> j) & 1;
+			aVisible[i+j] = visible;
+			visibleCount += visible;
+		}
+	}
+#	else // !CULLING_USE_SSE_
+	for( std::size_t i = 0; i < aBounds.count; ++i )
+	{
+		bool inside = true;
+		for( int p = 0; p < 6 && inside; ++p )
+		{
+			glm::vec4 const& plane = aFrustum.planes[p];
+			float const dist = plane.x * aBounds.centerX[i] + plane.y * aBounds.centerY[i] + plane.z * aBounds.centerZ[i] + plane.w;
+			float const rad = std::abs( plane.x ) * aBounds.extentX[i] + std::abs( plane.y ) * aBounds.extentY[i] + std::abs( plane.z ) * aBounds.extentZ[i];
+			inside = dist + rad >= 0.f;
+		}
+
+		aVisible[i] = inside ? 1 : 0;
+		visibleCount += inside ? 1 : 0;
+	}
+#	endif // ~ CULLING_USE_SSE_
+
+	return visibleCount;
+}
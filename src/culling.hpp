@@ -0,0 +1,48 @@
+#ifndef CULLING_HPP_8C1F4D2E_6B3A_4E97_A0D5_7F29E4B816C3
+#define CULLING_HPP_8C1F4D2E_6B3A_4E97_A0D5_7F29E4B816C3
+
+#include <vector>
+
+#include <cstddef>
+#include <cstdint>
+
+#include <glm/vec3.hpp>
+#include <glm/vec4.hpp>
+#include <glm/mat4x4.hpp>
+
+// View frustum, as six planes (left, right, bottom, top, near, far). Each
+// plane is stored as (n.x, n.y, n.z, d) with a unit-length normal pointing
+// into the frustum, so that dot(n, p) + d >= 0 for points inside.
+struct Frustum
+{
+	glm::vec4 planes[6];
+};
+
+// Extract the frustum planes from a combined projection * view matrix. The
+// projection is expected to map depth to [0, 1] (e.g., perspectiveRH_ZO()),
+// which matches Vulkan's clip space.
+Frustum extract_frustum_planes( glm::mat4 const& aProjCam );
+
+// Axis-aligned bounding boxes in structure-of-arrays layout, as center and
+// half-extent. The arrays are padded to a multiple of four entries, so that
+// cull_aabbs() can always process full groups of boxes; `count` is the number
+// of actual boxes.
+struct CullingBounds
+{
+	std::vector<float> centerX, centerY, centerZ;
+	std::vector<float> extentX, extentY, extentZ;
+
+	std::size_t count = 0;
+};
+
+void add_bounds( CullingBounds& aBounds, glm::vec3 const& aMin, glm::vec3 const& aMax );
+
+// Test all boxes against the frustum. aVisible[i] is set to 1 if box i
+// (potentially) intersects the frustum, and to 0 if it is fully outside of
+// at least one plane. aVisible must have room for aBounds.count entries.
+// Returns the number of visible boxes.
+//
+// Four boxes are tested per iteration using SSE, if available.
+std::size_t cull_aabbs( Frustum const& aFrustum, CullingBounds const& aBounds, std::uint8_t* aVisible );
+
+#endif // CULLING_HPP_8C1F4D2E_6B3A_4E97_A0D5_7F29E4B816C3
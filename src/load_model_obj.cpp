@@ -1,17 +1,212 @@
 #include "load_model_obj.hpp"
 
-#include <unordered_set>
+#include <limits>
+#include <string>
+#include <vector>
+#include <utility>
+#include <algorithm>
+#include <unordered_map>
 
+#include <cmath>
+#include <cstdio>
 #include <cassert>
+#include <cstdint>
 #include <cstring>
 
 #include <rapidobj/rapidobj.hpp>
 
+#include <glm/geometric.hpp>
+#include <glm/common.hpp>
+
 #include "../labutils/error.hpp"
 #include "simple_model.hpp"
 namespace lut = labutils;
 
-SimpleModel load_simple_wavefront_obj( char const* aPath )
+namespace
+{
+	// Meshes with more triangles than this are split into spatially compact
+	// clusters, each with its own bounds. Large meshes (especially when
+	// merged by material) otherwise span most of the scene, and can never
+	// be culled.
+	constexpr std::size_t kMaxClusterTriangles = 2048;
+
+	// Bounding volumes of the vertices [aBeg, aEnd). The sphere is centered
+	// on the box, with a radius that just encloses all vertices (this is
+	// tighter than using half the box diagonal).
+	void compute_bounds_( std::vector<glm::vec3> const& aPositions, std::size_t aBeg, std::size_t aEnd, SimpleMeshInfo& aMesh )
+	{
+		glm::vec3 aabbMin( std::numeric_limits<float>::max() );
+		glm::vec3 aabbMax( -std::numeric_limits<float>::max() );
+		for( std::size_t i = aBeg; i < aEnd; ++i )
+		{
+			aabbMin = glm::min( aabbMin, aPositions[i] );
+			aabbMax = glm::max( aabbMax, aPositions[i] );
+		}
+
+		glm::vec3 const sphereCenter = 0.5f * (aabbMin + aabbMax);
+
+		float radiusSq = 0.f;
+		for( std::size_t i = aBeg; i < aEnd; ++i )
+		{
+			glm::vec3 const d = aPositions[i] - sphereCenter;
+			radiusSq = std::max( radiusSq, glm::dot( d, d ) );
+		}
+
+		aMesh.aabbMin = aabbMin;
+		aMesh.aabbMax = aabbMax;
+		aMesh.sphereCenter = sphereCenter;
+		aMesh.sphereRadius = std::sqrt( radiusSq );
+	}
+
+	// Clustering statistics, for the report at the end of loading
+	struct ClusterStats_
+	{
+		std::size_t splitMeshes = 0;
+		std::size_t clusters = 0;
+		std::size_t duplicatedVertices = 0;
+	};
+
+	// Append the mesh that was just extracted to the end of the model's
+	// textured or untextured arrays, starting at aFirstVertex/aFirstIndex.
+	// Large meshes are split into clusters of at most kMaxClusterTriangles.
+	// Each cluster gets its own copy of the vertices that it uses, so that
+	// clusters remain independent meshes; vertices shared between clusters
+	// are counted in aStats.
+	void append_mesh_clusters_( SimpleModel& aModel, std::string aName, std::size_t aMaterial, bool aTextured, std::size_t aFirstVertex, std::size_t aFirstIndex, ClusterStats_& aStats )
+	{
+		auto& positions = aTextured ? aModel.dataTextured.positions : aModel.dataUntextured.positions;
+		auto& indices = aTextured ? aModel.dataTextured.indices : aModel.dataUntextured.indices;
+
+		auto const vertexCount = positions.size() - aFirstVertex;
+		auto const indexCount = indices.size() - aFirstIndex;
+		auto const triangleCount = indexCount / 3;
+
+		if( triangleCount <= kMaxClusterTriangles )
+		{
+			SimpleMeshInfo mesh{ std::move(aName), aMaterial, aTextured, aFirstVertex, vertexCount, aFirstIndex, indexCount, {}, {}, {}, 0.f };
+			compute_bounds_( positions, aFirstVertex, positions.size(), mesh );
+			aModel.meshes.emplace_back( std::move(mesh) );
+			return;
+		}
+
+		// Take the mesh out of the shared arrays; the clusters are appended
+		// in its place
+		std::vector<glm::vec3> const meshPositions( positions.begin() + std::ptrdiff_t(aFirstVertex), positions.end() );
+		std::vector<std::uint32_t> const meshIndices( indices.begin() + std::ptrdiff_t(aFirstIndex), indices.end() );
+
+		std::vector<glm::vec2> meshTexcoords;
+		std::vector<glm::vec3> meshColors;
+		if( aTextured )
+		{
+			auto& texcoords = aModel.dataTextured.texcoords;
+			meshTexcoords.assign( texcoords.begin() + std::ptrdiff_t(aFirstVertex), texcoords.end() );
+			texcoords.resize( aFirstVertex );
+		}
+		else
+		{
+			auto& colors = aModel.dataUntextured.colors;
+			meshColors.assign( colors.begin() + std::ptrdiff_t(aFirstVertex), colors.end() );
+			colors.resize( aFirstVertex );
+		}
+
+		positions.resize( aFirstVertex );
+		indices.resize( aFirstIndex );
+
+		// Order the triangles so that each run of kMaxClusterTriangles is
+		// spatially compact: split the triangles at the median centroid along
+		// the longest axis, recursively. Splits are placed at multiples of
+		// kMaxClusterTriangles, so only the last cluster is partially filled.
+		std::vector<glm::vec3> centroids( triangleCount );
+		for( std::size_t tri = 0; tri < triangleCount; ++tri )
+			centroids[tri] = (meshPositions[meshIndices[tri*3+0]] + meshPositions[meshIndices[tri*3+1]] + meshPositions[meshIndices[tri*3+2]]) / 3.f;
+
+		std::vector<std::uint32_t> order( triangleCount );
+		for( std::size_t tri = 0; tri < triangleCount; ++tri )
+			order[tri] = std::uint32_t(tri);
+
+		auto const split = [&] ( auto const& aSelf, std::size_t aBeg, std::size_t aEnd ) -> void {
+			auto const clusters = (aEnd - aBeg + kMaxClusterTriangles - 1) / kMaxClusterTriangles;
+			if( clusters <= 1 )
+				return;
+
+			glm::vec3 cmin( std::numeric_limits<float>::max() );
+			glm::vec3 cmax( -std::numeric_limits<float>::max() );
+			for( std::size_t i = aBeg; i < aEnd; ++i )
+			{
+				cmin = glm::min( cmin, centroids[order[i]] );
+				cmax = glm::max( cmax, centroids[order[i]] );
+			}
+
+			glm::vec3 const size = cmax - cmin;
+			int const axis = size.x >= size.y && size.x >= size.z ? 0 : (size.y >= size.z ? 1 : 2);
+
+			auto const mid = aBeg + clusters / 2 * kMaxClusterTriangles;
+			std::nth_element( order.begin() + std::ptrdiff_t(aBeg), order.begin() + std::ptrdiff_t(mid), order.begin() + std::ptrdiff_t(aEnd),
+				[&centroids, axis] (std::uint32_t aA, std::uint32_t aB) { return centroids[aA][axis] < centroids[aB][axis]; }
+			);
+
+			aSelf( aSelf, aBeg, mid );
+			aSelf( aSelf, mid, aEnd );
+		};
+
+		split( split, 0, triangleCount );
+
+		// Emit the clusters. remap[] holds each mesh vertex's index in the
+		// current cluster, valid if owner[] matches the cluster.
+		std::vector<std::uint32_t> remap( vertexCount );
+		std::vector<std::size_t> owner( vertexCount, ~std::size_t(0) );
+
+		auto const clusterCount = (triangleCount + kMaxClusterTriangles - 1) / kMaxClusterTriangles;
+		for( std::size_t cluster = 0; cluster < clusterCount; ++cluster )
+		{
+			auto const clusterFirstVertex = positions.size();
+			auto const clusterFirstIndex = indices.size();
+
+			auto const triBeg = cluster * kMaxClusterTriangles;
+			auto const triEnd = std::min( triBeg + kMaxClusterTriangles, triangleCount );
+			for( std::size_t i = triBeg; i < triEnd; ++i )
+			{
+				auto const tri = order[i];
+				for( std::size_t corner = 0; corner < 3; ++corner )
+				{
+					auto const v = meshIndices[tri*3 + corner];
+					if( owner[v] != cluster )
+					{
+						owner[v] = cluster;
+						remap[v] = std::uint32_t(positions.size() - clusterFirstVertex);
+
+						positions.emplace_back( meshPositions[v] );
+						if( aTextured )
+							aModel.dataTextured.texcoords.emplace_back( meshTexcoords[v] );
+						else
+							aModel.dataUntextured.colors.emplace_back( meshColors[v] );
+					}
+
+					indices.emplace_back( remap[v] );
+				}
+			}
+
+			SimpleMeshInfo mesh{
+				aName + "#" + std::to_string( cluster ),
+				aMaterial,
+				aTextured,
+				clusterFirstVertex,
+				positions.size() - clusterFirstVertex,
+				clusterFirstIndex,
+				indices.size() - clusterFirstIndex,
+				{}, {}, {}, 0.f
+			};
+			compute_bounds_( positions, clusterFirstVertex, positions.size(), mesh );
+			aModel.meshes.emplace_back( std::move(mesh) );
+		}
+
+		++aStats.splitMeshes;
+		aStats.clusters += clusterCount;
+		aStats.duplicatedVertices += positions.size() - aFirstVertex - vertexCount;
+	}
+}
+
+SimpleModel load_simple_wavefront_obj( char const* aPath, bool aMergeByMaterial )
 {
 	assert( aPath );
 	
@@ -56,7 +251,9 @@ SimpleModel load_simple_wavefront_obj( char const* aPath )
 
 	// Next, extract the actual mesh data. There are some complications:
 	// - OBJ use separate indices to positions, normals and texture coords. To
-	//   deal with this, the mesh is turned into an unindexed triangle soup.
+	//   deal with this, each unique (position, texcoord) index pair becomes a
+	//   single output vertex, and the faces are expressed as indices into
+	//   those vertices.
 	// - OBJ uses three methods of grouping faces:
 	//   - 'o' = object
 	//   - 'g' = group
@@ -67,92 +264,249 @@ SimpleModel load_simple_wavefront_obj( char const* aPath )
 	//
 	// Unfortunately, RapidOBJ exposes a per-face material index.
 
-	std::unordered_set<std::size_t> activeMaterials;
+	// Reserve output storage up front. The number of indices is known
+	// exactly; the number of unique vertices is at most the number of
+	// corners and is trimmed once all meshes have been extracted.
+	std::size_t texturedCorners = 0, untexturedCorners = 0;
 	for( auto const& shape : result.shapes )
 	{
-		auto const& shapeName = shape.name;
+		for( std::size_t faceId = 0; faceId < shape.mesh.material_ids.size(); ++faceId )
+		{
+			auto const matId = shape.mesh.material_ids[faceId];
 
-		// Scan shape for materials
+			assert( matId < int(ret.materials.size()) );
+			if( ret.materials[matId].diffuseTexturePath.empty() )
+				untexturedCorners += 3;
+			else
+				texturedCorners += 3;
+		}
+	}
+
+	ret.meshes.reserve( result.shapes.size() );
+
+	ret.dataTextured.positions.reserve( texturedCorners );
+	ret.dataTextured.texcoords.reserve( texturedCorners );
+	ret.dataTextured.indices.reserve( texturedCorners );
+
+	ret.dataUntextured.positions.reserve( untexturedCorners );
+	ret.dataUntextured.colors.reserve( untexturedCorners );
+	ret.dataUntextured.indices.reserve( untexturedCorners );
+
+	// Faces are bucketed by material with a counting sort: one pass counts
+	// the faces of each material, a prefix sum turns the counts into
+	// per-material output ranges, and a second pass scatters the faces into
+	// their ranges. This is linear in the number of faces, regardless of how
+	// many materials a shape uses.
+	//
+	// By default, different "shapes" are kept separate, and each shape is
+	// bucketed on its own. With aMergeByMaterial, all shapes are bucketed
+	// together instead, so that each material ends up as a single mesh (one
+	// draw call). This is fine for static geometry. Attribute indices are
+	// global in OBJ files, so vertices are also shared between shapes.
+	struct FaceRef_
+	{
+		std::uint32_t shape;
+		std::uint32_t face;
+	};
+
+	std::vector<std::size_t> faceCounts( ret.materials.size(), 0 );
+	std::vector<std::size_t> bucketEnd( ret.materials.size(), 0 );
+
+	std::vector<std::size_t> activeMaterials;
+	std::vector<FaceRef_> sortedFaces;
+
+	std::unordered_map<std::uint64_t, std::uint32_t> uniqueVertices;
+
+	std::size_t shapeMaterialPairs = 0;
+	ClusterStats_ clusterStats;
+
+	auto const extract_shapes = [&] ( std::size_t aShapeBeg, std::size_t aShapeEnd )
+	{
+		// Count faces per material
 		activeMaterials.clear();
 
-		for( std::size_t i = 0; i < shape.mesh.indices.size(); ++i )
+		std::size_t totalFaces = 0;
+		for( std::size_t shapeId = aShapeBeg; shapeId < aShapeEnd; ++shapeId )
 		{
-			auto const faceId = i/3; // Always triangles; see Triangulate() above
+			auto const& mesh = result.shapes[shapeId].mesh;
+			auto const faceCount = mesh.indices.size() / 3; // Always triangles; see Triangulate() above
 
-			assert( faceId < shape.mesh.material_ids.size() );
-			auto const matId = shape.mesh.material_ids[faceId];
+			assert( faceCount <= mesh.material_ids.size() );
 
-			assert( matId < int(ret.materials.size()) );
-			activeMaterials.emplace( matId );
+			for( std::size_t faceId = 0; faceId < faceCount; ++faceId )
+			{
+				auto const matId = std::size_t(mesh.material_ids[faceId]);
+
+				if( 0 == faceCounts[matId]++ )
+					activeMaterials.emplace_back( matId );
+			}
+
+			totalFaces += faceCount;
+		}
+
+		// Without merging, there is one mesh per (shape, material) pair
+		if( aShapeEnd - aShapeBeg == 1 )
+			shapeMaterialPairs += activeMaterials.size();
+
+		// Keep the output deterministic
+		std::sort( activeMaterials.begin(), activeMaterials.end() );
+
+		// Turn counts into output ranges and scatter faces into them. After
+		// the scatter, bucketEnd[] points one past the material's last face.
+		std::size_t offset = 0;
+		for( auto const matId : activeMaterials )
+		{
+			bucketEnd[matId] = offset;
+			offset += faceCounts[matId];
+		}
+
+		sortedFaces.resize( totalFaces );
+		for( std::size_t shapeId = aShapeBeg; shapeId < aShapeEnd; ++shapeId )
+		{
+			auto const& mesh = result.shapes[shapeId].mesh;
+			auto const faceCount = mesh.indices.size() / 3;
+
+			for( std::size_t faceId = 0; faceId < faceCount; ++faceId )
+			{
+				auto const matId = std::size_t(mesh.material_ids[faceId]);
+				sortedFaces[bucketEnd[matId]++] = FaceRef_{ std::uint32_t(shapeId), std::uint32_t(faceId) };
+			}
 		}
 
 		// Process vertices for active material
-		// This does multiple passes over the vertex data, which is less than
-		// optimal...
-		//
-		// Note: we still keep different "shapes" separate. For static meshes,
-		// one could merge all vertices with the same material for a bit more
-		// efficient rendering.
 		for( auto const matId : activeMaterials )
 		{
 			auto* opos = &ret.dataTextured.positions;
 			auto* otex = &ret.dataTextured.texcoords;
+			auto* oidx = &ret.dataTextured.indices;
 
 			bool const textured = !ret.materials[matId].diffuseTexturePath.empty();
 			if( !textured )
 			{
 				opos = &ret.dataUntextured.positions;
 				otex = nullptr;
+				oidx = &ret.dataUntextured.indices;
 			}
+
+			auto const& diffuseColor = ret.materials[matId].diffuseColor;
 			
 			// Keep track of mesh names; this can be useful for debugging.
 			std::string meshName;
-			if( 1 == activeMaterials.size() )
-				meshName = shapeName;
+			if( aShapeEnd - aShapeBeg != 1 )
+				meshName = ret.materials[matId].materialName;
+			else if( 1 == activeMaterials.size() )
+				meshName = result.shapes[aShapeBeg].name;
 			else
-				meshName = shapeName + "::" + ret.materials[matId].materialName;
+				meshName = result.shapes[aShapeBeg].name + "::" + ret.materials[matId].materialName;
 
 			// Extract this material's vertices.
+			// Vertices are deduplicated per mesh. Untextured meshes only
+			// consider the position index, as they don't use texcoords.
 			auto const firstVertex = opos->size();
+			auto const firstIndex = oidx->size();
 			assert( !textured || firstVertex == otex->size() );
-			
-			for( std::size_t i = 0; i < shape.mesh.indices.size(); ++i )
+
+			uniqueVertices.clear();
+
+			auto const bucketBegin = bucketEnd[matId] - faceCounts[matId];
+			for( std::size_t j = bucketBegin; j < bucketEnd[matId]; ++j )
 			{
-				auto const faceId = i/3; // Always triangles; see Triangulate() above
-				auto const faceMat = std::size_t(shape.mesh.material_ids[faceId]);
+				auto const [shapeId, faceId] = sortedFaces[j];
+				auto const& shapeIndices = result.shapes[shapeId].mesh.indices;
+
+				for( std::size_t i = faceId*3; i < faceId*3+3; ++i )
+				{
+					auto const& idx = shapeIndices[i];
 
-				if( faceMat != matId )
-					continue;
+					auto const key = (std::uint64_t(std::uint32_t(idx.position_index)) << 32)
+						| (textured ? std::uint32_t(idx.texcoord_index) : 0u)
+					;
 
-				auto const& idx = shape.mesh.indices[i];
+					auto const [it, isNew] = uniqueVertices.emplace( key, std::uint32_t(opos->size() - firstVertex) );
+					oidx->emplace_back( it->second );
 
-				opos->emplace_back( glm::vec3{
-					result.attributes.positions[idx.position_index*3+0],
-					result.attributes.positions[idx.position_index*3+1],
-					result.attributes.positions[idx.position_index*3+2]
-				} );
+					if( !isNew )
+						continue;
 
-				if( textured )
-				{
-					otex->emplace_back( glm::vec2{
-						result.attributes.texcoords[idx.texcoord_index*2+0],
-						result.attributes.texcoords[idx.texcoord_index*2+1]
+					opos->emplace_back( glm::vec3{
+						result.attributes.positions[idx.position_index*3+0],
+						result.attributes.positions[idx.position_index*3+1],
+						result.attributes.positions[idx.position_index*3+2]
 					} );
+
+					if( textured )
+					{
+						otex->emplace_back( glm::vec2{
+							result.attributes.texcoords[idx.texcoord_index*2+0],
+							result.attributes.texcoords[idx.texcoord_index*2+1]
+						} );
+					}
+					else
+					{
+						ret.dataUntextured.colors.emplace_back( diffuseColor );
+					}
 				}
 			}
 
-			auto const vertexCount = opos->size() - firstVertex;
-			assert( !textured || vertexCount == otex->size() - firstVertex );
+			assert( !textured || opos->size() == otex->size() );
+
+			// Bounding volumes; large meshes are split into clusters
+			append_mesh_clusters_( ret, std::move(meshName), matId, textured, firstVertex, firstIndex, clusterStats );
+
+			// Reset the count for the next group of shapes
+			faceCounts[matId] = 0;
+		}
+	};
 
-			ret.meshes.emplace_back( SimpleMeshInfo{
-				std::move(meshName),
-				matId,
-				textured,
-				firstVertex,
-				vertexCount
-			} );
+	if( aMergeByMaterial )
+	{
+		// Count the (shape, material) pairs for the statistics below
+		std::vector<std::uint8_t> seen( ret.materials.size() );
+		for( auto const& shape : result.shapes )
+		{
+			std::fill( seen.begin(), seen.end(), std::uint8_t(0) );
+			for( auto const matId : shape.mesh.material_ids )
+			{
+				if( !seen[matId] )
+				{
+					seen[matId] = 1;
+					++shapeMaterialPairs;
+				}
+			}
 		}
+
+		extract_shapes( 0, result.shapes.size() );
+	}
+	else
+	{
+		for( std::size_t shapeId = 0; shapeId < result.shapes.size(); ++shapeId )
+			extract_shapes( shapeId, shapeId+1 );
+	}
+
+	// Release the unused part of the vertex reservations
+	ret.dataTextured.positions.shrink_to_fit();
+	ret.dataTextured.texcoords.shrink_to_fit();
+	ret.dataUntextured.positions.shrink_to_fit();
+	ret.dataUntextured.colors.shrink_to_fit();
+
+	// Report how much the deduplication saved. Without it, each triangle
+	// corner would have been a separate vertex. The copies made for the
+	// clusters are reported separately, so that they do not hide the ratio.
+	auto const cornerCount = texturedCorners + untexturedCorners;
+	auto const vertexCount = ret.dataTextured.positions.size() + ret.dataUntextured.positions.size();
+	auto const uniqueCount = vertexCount - clusterStats.duplicatedVertices;
+	std::fprintf( stderr, "Loaded '%s': %zu unique vertices for %zu triangle corners (%.2fx reduction)\n",
+		aPath, uniqueCount, cornerCount, uniqueCount ? double(cornerCount) / double(uniqueCount) : 0.0
+	);
+	if( clusterStats.splitMeshes )
+	{
+		std::fprintf( stderr, "Loaded '%s': split %zu meshes into %zu clusters, duplicating %zu vertices (%.1f%% more)\n",
+			aPath, clusterStats.splitMeshes, clusterStats.clusters, clusterStats.duplicatedVertices, 100.0 * double(clusterStats.duplicatedVertices) / double(uniqueCount)
+		);
 	}
+	std::fprintf( stderr, "Loaded '%s': %zu draw calls (%zu shape/material pairs%s)\n",
+		aPath, ret.meshes.size(), shapeMaterialPairs, aMergeByMaterial ? ", merged by material" : ""
+	);
 
 	return ret;
 }
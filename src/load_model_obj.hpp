@@ -4,7 +4,12 @@
 #include "simple_model.hpp"
 
 // Load a Wavefront OBJ model
-SimpleModel load_simple_wavefront_obj( char const* aPath );
+//
+// If aMergeByMaterial is set, all faces using the same material are merged
+// into a single mesh, regardless of the OBJ object/group they belong to.
+// Meshes with many triangles are then split into spatially compact clusters,
+// each with its own bounds, so that they remain useful for culling.
+SimpleModel load_simple_wavefront_obj( char const* aPath, bool aMergeByMaterial = false );
 
 #endif // LOAD_MODEL_OBJ_HPP_1B67CFB6_BF91_421E_983A_CA92A246F902
 
@@ -1,11 +1,17 @@
 #include <volk/volk.h>
 
 #include <tuple>
+#include <cmath>
 #include <limits>
+#include <memory>
+#include <string>
 #include <vector>
+#include <algorithm>
+#include <unordered_map>
 #include <stdexcept>
 
 #include <cstdio>
+#include <cstdlib>
 #include <cassert>
 #include <chrono>
 #include <cstddef>
@@ -26,6 +32,8 @@
 #include <glm/gtx/transform.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 
+#include <stb_image_write.h>
+
 #include "../labutils/to_string.hpp"
 #include "../labutils/vulkan_window.hpp"
 
@@ -38,9 +46,19 @@ using namespace labutils::literals;
 #include "../labutils/vkobject.hpp"
 #include "../labutils/vkbuffer.hpp"
 #include "../labutils/allocator.hpp" 
+#include "../labutils/parallel.hpp"
+#include "../labutils/megabuffer.hpp"
+#include "../labutils/uniform_ring.hpp"
+#include "../labutils/upload_batcher.hpp"
+#include "../labutils/texture_cache.hpp"
+#include "../labutils/pipeline_cache.hpp"
+#include "../labutils/gpu_profiler.hpp"
 namespace lut = labutils;
 
+#include "culling.hpp"
+#include "camera_path.hpp"
 #include "load_model_obj.hpp"
+#include "model_cache.hpp"
 #include "simple_model.hpp"
 
 
@@ -65,12 +83,29 @@ namespace
 		//Rendering modes
 		constexpr char const* kTexFragMipmapShaderPath = SHADERDIR_ "fragMipmapTex.frag.spv";
 
+		//Variants that sample a single texture, for devices without
+		//descriptor indexing
+		constexpr char const* kTextureFragSingleShaderPath = SHADERDIR_ "defaultTexSingle.frag.spv";
+		constexpr char const* kTexFragMipmapSingleShaderPath = SHADERDIR_ "fragMipmapTexSingle.frag.spv";
+
 		constexpr char const* kTexFragDepthShaderPath = SHADERDIR_ "fragDepthTex.frag.spv";
 		constexpr char const* kColFragDepthShaderPath = SHADERDIR_ "fragDepthCol.frag.spv";
 
 		constexpr char const* kTexFragDepthPartialShaderPath = SHADERDIR_ "fragDepthPartialTex.frag.spv";
 		constexpr char const* kColFragDepthPartialShaderPath = SHADERDIR_ "fragDepthPartialCol.frag.spv";
 
+		//Depth pre-pass
+		constexpr char const* kDepthOnlyVertShaderPath = SHADERDIR_ "depthOnly.vert.spv";
+
+		//Overdraw visualization
+		constexpr char const* kOverdrawFragShaderPath = SHADERDIR_ "overdraw.frag.spv";
+		constexpr char const* kOverdrawResolveVertShaderPath = SHADERDIR_ "overdrawResolve.vert.spv";
+		constexpr char const* kOverdrawResolveFragShaderPath = SHADERDIR_ "overdrawResolve.frag.spv";
+
+		//GPU culling
+		constexpr char const* kCullCompShaderPath = SHADERDIR_ "cull.comp.spv";
+		constexpr char const* kDepthReduceShaderPath = SHADERDIR_ "depth_reduce.comp.spv";
+
 #		undef SHADERDIR_
 
 		constexpr VkFormat kDepthFormat = VK_FORMAT_D32_SFLOAT;
@@ -91,8 +126,78 @@ namespace
 		constexpr float kCameraSlowMult = 0.05f; //Speed multiplier
 
 		constexpr float kCameraMouseSensitivity = 0.01f; //Radians per pixel
+
+		//Pipeline cache, stored in the working directory. Pipelines are
+		//created much faster on later runs if the cache is valid.
+		constexpr char const* kPipelineCachePath = "pipelines.cache";
+
+		//Merge all static geometry that shares a material into a single mesh
+		//at load time. This reduces the number of draw calls, but the merged
+		//meshes span most of the scene, which defeats frustum and occlusion
+		//culling. Draw calls are cheap with GPU culling (indirect draws) and
+		//bindless textures, so the OBJ shapes are kept separate by default.
+		//Either way, large meshes are split into clusters with tight bounds.
+		constexpr bool kMergeMeshesByMaterial = false;
+
+		//Number of frames that the CPU may record ahead of the GPU. Each
+		//frame in flight has its own command buffers, synchronization
+		//objects and uniform buffer. 1 serializes CPU and GPU. Can be
+		//changed with --frames-in-flight, up to kMaxFramesInFlight.
+		constexpr std::uint32_t kDefaultFramesInFlight = 2;
+		constexpr std::uint32_t kMaxFramesInFlight = 4;
+
+		//Size of the per-frame slice of the uniform ring. This holds the
+		//scene uniforms, and leaves room for per-object data.
+		constexpr VkDeviceSize kUniformFrameSize = 64 * 1024;
+
+		//Must match local_size_x in cull.comp
+		constexpr std::uint32_t kCullWorkgroupSize = 64;
+
+		//Must match local_size_x/y in depth_reduce.comp
+		constexpr std::uint32_t kDepthReduceWorkgroupSize = 8;
+
+		//Upper bound of the bindless texture array. It is further limited
+		//by the device's descriptor limits.
+		constexpr std::uint32_t kMaxTextures = 1024;
+
+		//Interval over which the displayed frame time is averaged
+		constexpr float kFrameTimeInterval = 0.5f; //Seconds
+
+		//Headless benchmark defaults, see parse_options()
+		constexpr std::uint32_t kBenchmarkFrames = 600;
+		constexpr VkExtent2D kBenchmarkExtent = { 1280, 720 };
+
+		//A replayed camera path advances by this much per frame, regardless
+		//of the actual frame time, so that every run sees the same frames
+		constexpr float kReplayTimestep = 1.f / 60.f; //Seconds
 	}
 
+	//Command line options
+	struct Options
+	{
+		//Render offscreen for a fixed number of frames along a scripted
+		//camera path, without GLFW or the ImGui overlay
+		bool headless = false;
+		std::uint32_t frames = cfg::kBenchmarkFrames;
+		VkExtent2D extent = cfg::kBenchmarkExtent;
+
+		//Per-frame timings, as CSV (headless only)
+		std::string csvPath;
+
+		//Directory to which every pngEvery-th frame is written (headless only)
+		std::string pngDir;
+		std::uint32_t pngEvery = 1;
+
+		//Record the camera and inputs to a file (windowed only), or replay
+		//a recording instead of reacting to input. A replay ends with the
+		//recording, and replaces the benchmark's scripted camera path.
+		std::string recordPath;
+		std::string replayPath;
+
+		//See cfg::kDefaultFramesInFlight
+		std::uint32_t framesInFlight = cfg::kDefaultFramesInFlight;
+	};
+
 	// GLFW callbacks
 	void glfw_callback_key_press(GLFWwindow*, int, int, int, int);
 	void glfw_callback_button(GLFWwindow*, int, int, int);
@@ -108,8 +213,48 @@ namespace
 			glm::mat4 projCam;
 		};
 
-		static_assert(sizeof(SceneUniform) <= 65536, "SceneUniform must be less than 65536 bytes for vkCmdUpdateBuffer");
-		static_assert(sizeof(SceneUniform) % 4 == 0, "SceneUniform size must be a multiple of 4 bytes");
+		//Per-draw input of cull.comp (std430)
+		struct DrawInfo
+		{
+			glm::vec4 center;
+			glm::vec4 extent;
+
+			std::uint32_t indexCount;
+			std::uint32_t firstIndex;
+			std::int32_t vertexOffset;
+
+			std::uint32_t group;
+			std::uint32_t groupBase;
+
+			std::uint32_t textureIndex;
+			std::uint32_t pad0, pad1;
+		};
+
+		static_assert(sizeof(DrawInfo) == 64, "DrawInfo must match the std430 layout in cull.comp");
+
+		//Uniform block of cull.comp (std140)
+		struct CullUniform
+		{
+			glm::mat4 projCam;
+			glm::vec4 planes[6];
+			glm::vec2 pyramidSize;
+			std::uint32_t occludedSlot;
+			std::uint32_t pad0;
+		};
+
+		//Push constants of cull.comp
+		struct CullPush
+		{
+			std::uint32_t phase;
+			std::uint32_t drawCount;
+			std::uint32_t commandBase;
+			std::uint32_t countBase;
+		};
+
+		//Values of CullPush::phase
+		constexpr std::uint32_t kCullPhaseAll = 0;
+		constexpr std::uint32_t kCullPhaseEarly = 1;
+		constexpr std::uint32_t kCullPhaseLate = 2;
 	}
 
 	// Helpers:
@@ -136,62 +281,225 @@ namespace
 
 		bool wasMousing = false;
 
+		//A replay drives the camera and inputs; live input is ignored
+		bool replaying = false;
+
 		glm::mat4 camera2world = glm::identity<glm::mat4>() * glm::translate(glm::vec3({0, 8, 0}));
 	};
 
 	//Helpful structs
-	struct ColorizedMesh
+	//All meshes are sub-allocated from a few large buffers, one per vertex
+	//stream, so that the vertex buffers only need to be bound once per pipeline
+	struct MeshArena
 	{
-		labutils::Buffer positions;
-		labutils::Buffer colors;
+		lut::MegaBuffer texPositions;
+		lut::MegaBuffer texcoords;
 
-		std::uint32_t vertexCount;
+		lut::MegaBuffer colPositions;
+		lut::MegaBuffer colColors;
+
+		//Holds both 16-bit and 32-bit indices
+		lut::MegaBuffer indices;
 	};
 
-	struct ColouredMeshDetails
+	//A range of vertices and indices in the MeshArena
+	struct ColorizedMesh
 	{
-		std::vector<float> positions;
-		std::vector<float> colours;
-		size_t vertexCount = 0;
+		std::int32_t vertexOffset;
+		std::uint32_t vertexCount;
+
+		std::uint32_t firstIndex;
+		std::uint32_t indexCount;
+		VkIndexType indexType;
 	};
 
 	struct TexturedMesh
 	{
-		labutils::Buffer positions;
-		labutils::Buffer texcoords;
+		//Index into the bindless texture array, passed as firstInstance, or
+		//into the per-texture descriptor sets without descriptor indexing
+		std::uint32_t textureIndex;
 
+		std::int32_t vertexOffset;
 		std::uint32_t vertexCount;
+
+		std::uint32_t firstIndex;
+		std::uint32_t indexCount;
+		VkIndexType indexType;
+	};
+
+	//How draw_scene() shades the scene
+	enum class EScenePass
+	{
+		shaded,    //The pipelines of the current render mode
+		depthOnly, //Depth pre-pass
+		overdraw   //Count the fragments of each pixel
+	};
+
+	//Draws that share all state except their index range and texture. With
+	//GPU culling, each group is drawn with one vkCmdDrawIndexedIndirectCount()
+	//from the command slots [base, base+capacity). Without descriptor
+	//indexing, textures are bound per group, so the groups are also split by
+	//texture.
+	struct DrawGroup
+	{
+		bool textured;
+		std::uint32_t textureIndex;
+		VkIndexType indexType;
+
+		std::uint32_t base;
+		std::uint32_t capacity;
+	};
+
+	//Depth pyramid (Hi-Z) for occlusion culling. Level 0 is half the size of
+	//the depth buffer; each texel holds the farthest depth of the area it
+	//covers. It is rebuilt from the depth buffer every frame.
+	struct DepthPyramid
+	{
+		lut::Image image;
+		lut::ImageView view; //All levels, for sampling
+		std::vector<lut::ImageView> levelViews;
+
+		//One set per level, with the level's source (the depth buffer or the
+		//previous level) and the level itself
+		lut::DescriptorPool pool;
+		std::vector<VkDescriptorSet> reduceSets;
+
+		std::uint32_t width = 0, height = 0;
+		std::uint32_t levels = 0;
+	};
+
+	//Resources owned by one frame in flight
+	struct FrameResources
+	{
+		//Reset as a whole once the frame's previous use has completed
+		lut::CommandPool cpool;
+		VkCommandBuffer cbuffer = VK_NULL_HANDLE;
+
+		//Signalled when the last submission of the frame has completed
+		lut::Fence inFlight;
+
+		lut::Semaphore imageAvailable;
+
+		//GPU culling output, written by cull.comp and consumed by the
+		//indirect draws. Both hold two ranges, for the early and the late
+		//phase of occlusion culling; the counts end with the number of
+		//occluded draws. The counts are host-visible, so that they can be
+		//read back once the frame has completed.
+		lut::Buffer drawCommands;
+		lut::Buffer drawCounts;
+		std::uint32_t const* mappedCounts = nullptr;
+
+		VkDescriptorSet cullDescriptors = VK_NULL_HANDLE;
+		bool culledOnGpu = false;
+
+		//Texture sampler, rebuilt when the sampler settings change. Each
+		//frame has its own, so that changing it does not wait for the GPU.
+		lut::Sampler sampler;
+		VkDescriptorSet samplerDescriptors = VK_NULL_HANDLE;
+		std::uint32_t samplerVersion = 0;
+
+		//Headless mode: the rendered image is copied to the host-visible
+		//readback buffer. The frame's timings and image are written out
+		//once the frame has completed.
+		lut::Buffer readback;
+		std::uint8_t const* mappedReadback = nullptr;
+
+		bool benchmarkPending = false;
+		std::uint32_t benchmarkFrame = 0;
+		float frameMs = 0.f; //Wall-clock time since the previous frame
+		float cpuMs = 0.f;   //Recording and submission
 	};
 
-	struct TexturedMeshDetails
+	//A pipeline variant, built by create_pipelines()
+	struct PipelineDesc
 	{
-		std::vector<float> positions;
-		std::vector<float> texCoords;
-		size_t vertexCount = 0;
+		lut::Pipeline* pipeline;
+		bool textured;
+
+		char const* vertShaderPath;
+		char const* fragShaderPath;
+
+		//Test against the depth laid down by the depth pre-pass with EQUAL,
+		//without writing depth
+		bool depthEqual = false;
 	};
 
+	//Shader modules by SPIR-V path. Each module is loaded once and shared
+	//by all pipelines that use it.
+	using ShaderModuleMap = std::unordered_map<std::string, lut::ShaderModule>;
+
 
 
 	void update_user_state(UserState&, float aElapsedTime);
 
-	lut::RenderPass create_render_pass(lut::VulkanWindow const&);
-	lut::RenderPass create_imgui_render_pass(lut::VulkanWindow const& aWindow);
+	std::uint32_t pack_inputs(UserState const&);
+	void unpack_inputs(UserState&, std::uint32_t aInputs);
+
+	Options parse_options(int aArgc, char* aArgv[]);
+	glm::mat4 benchmark_camera(std::uint32_t aFrame, std::uint32_t aFrameCount);
+
+	lut::RenderPass create_render_pass(lut::VulkanWindow const&, bool aLast);
+	lut::RenderPass create_late_render_pass(lut::VulkanWindow const&);
+
+	MeshArena create_mesh_arena(lut::Allocator const&, CachedModel const&);
 
-	TexturedMesh create_textured_mesh(labutils::VulkanContext const& aContext, labutils::Allocator const& aAllocator, float aPositions[], float aTexCoords[], size_t aVertCount);
-	ColorizedMesh create_coloured_mesh(labutils::VulkanContext const& aContext, labutils::Allocator const& aAllocator, float aPositions[], float aColor[], size_t aVertCount);
+	TexturedMesh create_textured_mesh(lut::UploadBatcher& aUploader, MeshArena& aArena, float const aPositions[], float const aTexCoords[], size_t aVertCount, std::uint8_t const aPackedIndices[], size_t aIndexCount);
+	ColorizedMesh create_coloured_mesh(lut::UploadBatcher& aUploader, MeshArena& aArena, float const aPositions[], float const aColor[], size_t aVertCount, std::uint8_t const aPackedIndices[], size_t aIndexCount);
+
+	VkIndexType select_index_type(size_t aVertCount);
+
+	std::vector<glsl::DrawInfo> build_draw_groups(
+		std::vector<TexturedMesh> const&,
+		CullingBounds const& aTexturedBounds,
+		std::vector<ColorizedMesh> const&,
+		CullingBounds const& aColouredBounds,
+		bool aGroupByTexture,
+		std::vector<DrawGroup>& aGroups
+	);
 
 	lut::DescriptorSetLayout create_scene_descriptor_layout(lut::VulkanWindow const&);
-	lut::DescriptorSetLayout create_object_descriptor_layout(lut::VulkanWindow const&);
-	//lut::DescriptorSetLayout create_storage_descriptor_layout(lut::VulkanWindow const&);
+	lut::DescriptorSetLayout create_object_descriptor_layout(lut::VulkanWindow const&, bool aBindless, std::uint32_t aMaxTextures);
+	lut::DescriptorSetLayout create_cull_descriptor_layout(lut::VulkanWindow const&);
+	lut::DescriptorSetLayout create_depth_reduce_descriptor_layout(lut::VulkanWindow const&);
+	lut::DescriptorSetLayout create_storage_descriptor_layout(lut::VulkanWindow const&);
+	lut::DescriptorSetLayout create_sampler_descriptor_layout(lut::VulkanWindow const&);
 
 	lut::PipelineLayout create_coloured_pipeline_layout(lut::VulkanContext const&, VkDescriptorSetLayout);
-	lut::PipelineLayout create_textured_pipeline_layout(lut::VulkanContext const&, VkDescriptorSetLayout, VkDescriptorSetLayout);
-	//lut::PipelineLayout create_storage_pipeline_layout(lut::VulkanContext const&, VkDescriptorSetLayout);
+	lut::PipelineLayout create_textured_pipeline_layout(lut::VulkanContext const&, VkDescriptorSetLayout, VkDescriptorSetLayout, VkDescriptorSetLayout);
+	lut::PipelineLayout create_cull_pipeline_layout(lut::VulkanContext const&, VkDescriptorSetLayout);
+	lut::PipelineLayout create_depth_reduce_pipeline_layout(lut::VulkanContext const&, VkDescriptorSetLayout);
+	lut::PipelineLayout create_storage_pipeline_layout(lut::VulkanContext const&, VkDescriptorSetLayout aSceneLayout, VkDescriptorSetLayout aStorageLayout);
+
+	lut::Pipeline create_coloured_pipeline(lut::VulkanWindow const&, VkRenderPass, VkPipelineLayout, VkPipelineCache, VkShaderModule aVert, VkShaderModule aFrag, bool aDepthEqual);
+	lut::Pipeline create_textured_pipeline(lut::VulkanWindow const&, VkRenderPass, VkPipelineLayout, VkPipelineCache, VkShaderModule aVert, VkShaderModule aFrag, bool aDepthEqual);
+	lut::Pipeline create_position_only_pipeline(lut::VulkanWindow const&, VkRenderPass, VkPipelineLayout, VkPipelineCache, VkShaderModule aVert, VkShaderModule aFrag);
+	lut::Pipeline create_overdraw_resolve_pipeline(lut::VulkanWindow const&, VkRenderPass, VkPipelineLayout, VkPipelineCache, VkShaderModule aVert, VkShaderModule aFrag);
 
-	lut::Pipeline create_coloured_pipeline(lut::VulkanWindow const&, VkRenderPass, VkPipelineLayout, const char* vertShaderPath, const char* fragShaderPath);
-	lut::Pipeline create_textured_pipeline(lut::VulkanWindow const&, VkRenderPass, VkPipelineLayout, const char* vertShaderPath, const char* fragShaderPath);
+	void load_shader_modules(lut::VulkanContext const&, PipelineDesc const*, std::size_t aCount, ShaderModuleMap&);
+	void create_pipelines(lut::VulkanWindow const&, VkRenderPass, VkPipelineLayout aColouredLayout, VkPipelineLayout aTexturedLayout, VkPipelineCache, ShaderModuleMap const&, PipelineDesc const*, std::size_t aCount);
+
+	lut::Pipeline create_compute_pipeline(lut::VulkanContext const&, VkPipelineLayout, VkPipelineCache, VkShaderModule aComp);
 
 	std::tuple<lut::Image, lut::ImageView> create_depth_buffer(lut::VulkanWindow const&, lut::Allocator const&);
+	std::tuple<lut::Image, lut::ImageView> create_overdraw_image(lut::VulkanWindow const&, lut::Allocator const&);
+	void update_overdraw_descriptors(lut::VulkanContext const&, VkDescriptorSet, VkImageView);
+
+	VkDescriptorSet alloc_texture_desc_set(lut::VulkanContext const&, VkDescriptorPool, VkDescriptorSetLayout, std::uint32_t aTextureCount);
+	void update_texture_descriptors(lut::VulkanContext const&, VkDescriptorSet, std::vector<VkImageView> const& aViews);
+	void update_sampler_descriptors(lut::VulkanContext const&, VkDescriptorSet, VkSampler);
+
+	lut::Sampler create_point_sampler(lut::VulkanContext const&);
+	DepthPyramid create_depth_pyramid(lut::VulkanWindow const&, lut::Allocator const&, VkDescriptorSetLayout aReduceLayout, VkImageView aDepthView, VkSampler);
+
+	void update_cull_descriptors(
+		lut::VulkanContext const&,
+		FrameResources const&,
+		VkBuffer aDrawInfos,
+		VkBuffer aVisibility,
+		VkBuffer aUniforms,
+		VkImageView aDepthPyramid,
+		VkSampler
+	);
 
 	void create_swapchain_framebuffers(
 		lut::VulkanWindow const&,
@@ -223,346 +531,467 @@ namespace
 	);
 
 	void InitImgui();
-	void create_imgui_framebuffers(lut::VulkanWindow const&, VkRenderPass, std::vector<lut::Framebuffer>&);
 }
 
-int main() try
+int main(int aArgc, char* aArgv[]) try
 {
+	//Measure startup time, up to the first frame
+	auto const startupClock = Clock_::now();
+
+	Options const options = parse_options(aArgc, aArgv);
+	std::size_t const framesInFlight = options.framesInFlight;
+
 	// Create Vulkan Window
-	auto window = lut::make_vulkan_window();
+	//Headless, there is one offscreen image per frame in flight, which
+	//stands in for the swapchain images
+	auto window = options.headless
+		? lut::make_offscreen_window(options.extent, std::uint32_t(framesInFlight))
+		: lut::make_vulkan_window();
 
 	// Configure the GLFW window
 	UserState state{};
 
-	glfwSetWindowUserPointer(window.window, &state);
-	glfwSetKeyCallback(window.window, &glfw_callback_key_press);
-	glfwSetMouseButtonCallback(window.window, &glfw_callback_button);
-	glfwSetCursorPosCallback(window.window, &glfw_callback_motion);
+	if (!options.headless)
+	{
+		glfwSetWindowUserPointer(window.window, &state);
+		glfwSetKeyCallback(window.window, &glfw_callback_key_press);
+		glfwSetMouseButtonCallback(window.window, &glfw_callback_button);
+		glfwSetCursorPosCallback(window.window, &glfw_callback_motion);
+	}
+
+	//Camera path being recorded or replayed
+	CameraPath cameraPath;
+	if (!options.replayPath.empty())
+	{
+		if (!load_camera_path(options.replayPath.c_str(), cameraPath) || cameraPath.samples.empty())
+			throw lut::Error("Unable to load camera path '%s'", options.replayPath.c_str());
+
+		std::fprintf(stderr, "Replaying '%s': %zu samples, %.2f s\n", options.replayPath.c_str(), cameraPath.samples.size(), camera_path_duration(cameraPath));
+		state.replaying = true;
+	}
 
 	// Create VMA allocator
 	lut::Allocator allocator = lut::create_allocator(window);
 
 	// Intialize resources
-	lut::RenderPass renderPass = create_render_pass(window);
+	//With occlusion culling, the scene is drawn in two passes: the main
+	//pass clears the attachments, the late pass draws on top of it. Between
+	//the two, the depth buffer is used for occlusion culling. Otherwise, a
+	//single pass draws everything and leaves the image ready for
+	//presentation. The render passes are compatible, so they share the
+	//framebuffers and pipelines.
+	lut::RenderPass renderPass = create_render_pass(window, false);
+	lut::RenderPass singleRenderPass = create_render_pass(window, true);
+	lut::RenderPass lateRenderPass = create_late_render_pass(window);
 
 	//Create scene descriptor set layout
 	lut::DescriptorSetLayout sceneLayout = create_scene_descriptor_layout(window);
 
+	//Optional device features
+	VkPhysicalDeviceFeatures supportedFeatures{};
+	vkGetPhysicalDeviceFeatures(window.physicalDevice, &supportedFeatures);
+
+	//Storing from fragment shaders is needed by the overdraw visualization
+	bool const haveOverdraw = VK_TRUE == supportedFeatures.fragmentStoresAndAtomics;
+
+	//With descriptor indexing, all textures are bound once, as one array
+	//(bindless). Each draw picks its texture with firstInstance, which is the
+	//same for all invocations of the draw, i.e., the array is indexed with
+	//dynamically uniform values. Otherwise, each texture has its own
+	//descriptor set, which is bound whenever the texture changes. Either
+	//way, the sampler is bound separately, so the textures do not depend on
+	//it.
+	bool const haveBindless = window.haveDescriptorIndexing && VK_TRUE == supportedFeatures.shaderSampledImageArrayDynamicIndexing;
+
+	//The indirect draws of GPU culling select their texture with
+	//firstInstance when bindless; otherwise firstInstance is always 0
+	bool const haveGpuCulling = window.haveDrawIndirectCount && (!haveBindless || VK_TRUE == supportedFeatures.drawIndirectFirstInstance);
+
+	std::fprintf(stderr, "Textures: %s\n", haveBindless ? "bound once as an array (descriptor indexing)" : "one descriptor set per texture (no descriptor indexing)");
+
+	VkPhysicalDeviceProperties deviceProps{};
+	vkGetPhysicalDeviceProperties(window.physicalDevice, &deviceProps);
+
+	auto const& limits = deviceProps.limits;
+	std::uint32_t const maxTextures = std::min({ cfg::kMaxTextures, limits.maxPerStageDescriptorSampledImages, limits.maxDescriptorSetSampledImages });
+
 	//Create object descriptor set layout
-	lut::DescriptorSetLayout objectLayout = create_object_descriptor_layout(window);
+	lut::DescriptorSetLayout objectLayout = create_object_descriptor_layout(window, haveBindless, maxTextures);
+	lut::DescriptorSetLayout samplerLayout = create_sampler_descriptor_layout(window);
 
-	lut::PipelineLayout texturedPipeLayout = create_textured_pipeline_layout(window, sceneLayout.handle, objectLayout.handle);
+	lut::PipelineLayout texturedPipeLayout = create_textured_pipeline_layout(window, sceneLayout.handle, objectLayout.handle, samplerLayout.handle);
 	lut::PipelineLayout colouredPipeLayout = create_coloured_pipeline_layout(window, sceneLayout.handle);
 
+	//Pipeline cache, loaded from disk if possible
+	bool pipelineCacheWarm = false;
+	lut::PipelineCache pipelineCache = lut::create_pipeline_cache(window, cfg::kPipelineCachePath, &pipelineCacheWarm);
+
 	//Pipelines for the different rendering modes
 	lut::Pipeline colouredPipe, texturedPipe;
 	lut::Pipeline mipmapColouredPipe, mipmapTexturedPipe;
 	lut::Pipeline depthColouredPipe, depthTexturedPipe;
 	lut::Pipeline depthPartialColouredPipe, depthPartialTexturedPipe;
-	
-
-	colouredPipe = create_coloured_pipeline(window, renderPass.handle, colouredPipeLayout.handle, cfg::kColourVertShaderPath, cfg::kColourFragShaderPath);
-	texturedPipe = create_textured_pipeline(window, renderPass.handle, texturedPipeLayout.handle, cfg::kTextureVertShaderPath, cfg::kTextureFragShaderPath);
+	lut::Pipeline prepassColouredPipe, prepassTexturedPipe;
+
+	//Position-only pipeline for the depth pre-pass, shared by textured and
+	//coloured meshes
+	lut::Pipeline depthOnlyPipe;
+
+	//Shaders that sample the texture depend on how textures are bound
+	char const* const textureFragShaderPath = haveBindless ? cfg::kTextureFragShaderPath : cfg::kTextureFragSingleShaderPath;
+	char const* const texFragMipmapShaderPath = haveBindless ? cfg::kTexFragMipmapShaderPath : cfg::kTexFragMipmapSingleShaderPath;
+
+	PipelineDesc const pipelineDescs[] = {
+		{ &colouredPipe, false, cfg::kColourVertShaderPath, cfg::kColourFragShaderPath },
+		{ &texturedPipe, true, cfg::kTextureVertShaderPath, textureFragShaderPath },
+		{ &mipmapColouredPipe, false, cfg::kColourVertShaderPath, cfg::kColourFragShaderPath },
+		{ &mipmapTexturedPipe, true, cfg::kTextureVertShaderPath, texFragMipmapShaderPath },
+		{ &depthColouredPipe, false, cfg::kColourVertShaderPath, cfg::kColFragDepthShaderPath },
+		{ &depthTexturedPipe, true, cfg::kTextureVertShaderPath, cfg::kTexFragDepthShaderPath },
+		{ &depthPartialColouredPipe, false, cfg::kColourVertShaderPath, cfg::kColFragDepthPartialShaderPath },
+		{ &depthPartialTexturedPipe, true, cfg::kTextureVertShaderPath, cfg::kTexFragDepthPartialShaderPath },
+		{ &prepassColouredPipe, false, cfg::kColourVertShaderPath, cfg::kColourFragShaderPath, true },
+		{ &prepassTexturedPipe, true, cfg::kTextureVertShaderPath, textureFragShaderPath, true },
+	};
+	constexpr std::size_t pipelineCount = sizeof(pipelineDescs) / sizeof(pipelineDescs[0]);
 
-	mipmapColouredPipe = create_coloured_pipeline(window, renderPass.handle, colouredPipeLayout.handle, cfg::kColourVertShaderPath, cfg::kColourFragShaderPath);
-	mipmapTexturedPipe = create_textured_pipeline(window, renderPass.handle, texturedPipeLayout.handle, cfg::kTextureVertShaderPath, cfg::kTexFragMipmapShaderPath);
+	auto const pipelineClock = Clock_::now();
 
-	depthColouredPipe = create_coloured_pipeline(window, renderPass.handle, colouredPipeLayout.handle, cfg::kColourVertShaderPath, cfg::kColFragDepthShaderPath);
-	depthTexturedPipe = create_textured_pipeline(window, renderPass.handle, texturedPipeLayout.handle, cfg::kTextureVertShaderPath, cfg::kTexFragDepthShaderPath);
+	//Shader modules are kept, in case the pipelines need to be recreated
+	ShaderModuleMap shaderModules;
+	load_shader_modules(window, pipelineDescs, pipelineCount, shaderModules);
+	shaderModules.emplace(cfg::kDepthOnlyVertShaderPath, lut::load_shader_module(window, cfg::kDepthOnlyVertShaderPath));
 
-	depthPartialColouredPipe = create_coloured_pipeline(window, renderPass.handle, colouredPipeLayout.handle, cfg::kColourVertShaderPath, cfg::kColFragDepthPartialShaderPath);
-	depthPartialTexturedPipe = create_textured_pipeline(window, renderPass.handle, texturedPipeLayout.handle, cfg::kTextureVertShaderPath, cfg::kTexFragDepthPartialShaderPath);
+	//Compile all pipelines concurrently
+	create_pipelines(window, renderPass.handle, colouredPipeLayout.handle, texturedPipeLayout.handle, pipelineCache.handle, shaderModules, pipelineDescs, pipelineCount);
 
-	auto [depthBuffer, depthBufferView] = create_depth_buffer(window, allocator);
+	//The depth-only pipeline only uses the scene descriptors, which the
+	//coloured layout consists of
+	depthOnlyPipe = create_position_only_pipeline(window, renderPass.handle, colouredPipeLayout.handle, pipelineCache.handle, shaderModules.at(cfg::kDepthOnlyVertShaderPath).handle, VK_NULL_HANDLE);
 
-	std::vector<lut::Framebuffer> framebuffers;
-	create_swapchain_framebuffers(window, renderPass.handle, framebuffers, depthBufferView.handle);
+	//Overdraw visualization. Fragments count themselves into a storage
+	//image, which is then resolved to a heat map. Storing from fragment
+	//shaders is an optional feature (haveOverdraw).
 
-	lut::CommandPool cpool = lut::create_command_pool(window, VK_COMMAND_POOL_CREATE_TRANSIENT_BIT | VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT);
+	lut::DescriptorSetLayout storageLayout = create_storage_descriptor_layout(window);
+	lut::PipelineLayout storagePipeLayout = create_storage_pipeline_layout(window, sceneLayout.handle, storageLayout.handle);
 
-	std::vector<VkCommandBuffer> cbuffers;
-	std::vector<lut::Fence> cbfences;
+	lut::Pipeline overdrawPipe, overdrawResolvePipe;
+	auto const create_overdraw_pipelines = [&] () {
+		overdrawPipe = create_position_only_pipeline(window, renderPass.handle, storagePipeLayout.handle, pipelineCache.handle, shaderModules.at(cfg::kDepthOnlyVertShaderPath).handle, shaderModules.at(cfg::kOverdrawFragShaderPath).handle);
+		overdrawResolvePipe = create_overdraw_resolve_pipeline(window, renderPass.handle, storagePipeLayout.handle, pipelineCache.handle, shaderModules.at(cfg::kOverdrawResolveVertShaderPath).handle, shaderModules.at(cfg::kOverdrawResolveFragShaderPath).handle);
+	};
 
-	for (std::size_t i = 0; i < framebuffers.size(); ++i)
+	if (haveOverdraw)
 	{
-		cbuffers.emplace_back(lut::alloc_command_buffer(window, cpool.handle));
-		cbfences.emplace_back(lut::create_fence(window, VK_FENCE_CREATE_SIGNALED_BIT));
-	}
+		for (char const* path : { cfg::kOverdrawFragShaderPath, cfg::kOverdrawResolveVertShaderPath, cfg::kOverdrawResolveFragShaderPath })
+			shaderModules.emplace(path, lut::load_shader_module(window, path));
 
-	lut::Semaphore imageAvailable = lut::create_semaphore(window);
-	lut::Semaphore renderFinished = lut::create_semaphore(window);
+		create_overdraw_pipelines();
+	}
 
-	//Load the mesh
-	SimpleModel meshes = load_simple_wavefront_obj("assets/src/sponza_with_ship.obj");
+	std::fprintf(stderr, "Pipeline creation: %zu pipelines from %zu shader modules in %.1f ms (%s pipeline cache)\n", pipelineCount + (haveOverdraw ? 3 : 1), shaderModules.size(), std::chrono::duration<double, std::milli>(Clock_::now() - pipelineClock).count(), pipelineCacheWarm ? "warm" : "cold");
 
-	//Data structure to store all ColourizedMeshes
-	std::vector<ColorizedMesh> colouredMeshes;
+	//Compute pipeline for GPU culling. This requires vkCmdDrawIndexedIndirectCount(),
+	//otherwise only CPU culling is available.
+	lut::DescriptorSetLayout cullLayout = create_cull_descriptor_layout(window);
+	lut::PipelineLayout cullPipeLayout = create_cull_pipeline_layout(window, cullLayout.handle);
 
-	//Data structure to store all TexturedMeshes
-	std::vector<const char*> meshMaterial;
-	std::vector<TexturedMesh> texturedMeshes;
+	//The depth pyramid for occlusion culling is reduced from the depth buffer
+	lut::DescriptorSetLayout depthReduceLayout = create_depth_reduce_descriptor_layout(window);
+	lut::PipelineLayout depthReducePipeLayout = create_depth_reduce_pipeline_layout(window, depthReduceLayout.handle);
 
-	for (SimpleMeshInfo mesh : meshes.meshes)
+	lut::Pipeline cullPipe, depthReducePipe;
+	if (haveGpuCulling)
 	{
+		lut::ShaderModule cullShader = lut::load_shader_module(window, cfg::kCullCompShaderPath);
+		cullPipe = create_compute_pipeline(window, cullPipeLayout.handle, pipelineCache.handle, cullShader.handle);
 
-		size_t meshSize = mesh.vertexCount;
-		size_t start = mesh.vertexStartIndex;
+		lut::ShaderModule reduceShader = lut::load_shader_module(window, cfg::kDepthReduceShaderPath);
+		depthReducePipe = create_compute_pipeline(window, depthReducePipeLayout.handle, pipelineCache.handle, reduceShader.handle);
+	}
 
-		//Only perform on textured meshes
-		if (mesh.textured)
-		{
-			TexturedMeshDetails meshDetails;
+	auto [depthBuffer, depthBufferView] = create_depth_buffer(window, allocator);
 
-			for (size_t i = start; i < start + meshSize; i++)
-			{
-				meshDetails.positions.emplace_back(meshes.dataTextured.positions.at(i).x);
-				meshDetails.positions.emplace_back(meshes.dataTextured.positions.at(i).y);
-				meshDetails.positions.emplace_back(meshes.dataTextured.positions.at(i).z);
+	lut::Sampler pyramidSampler = create_point_sampler(window);
 
-				meshDetails.texCoords.emplace_back(meshes.dataTextured.texcoords.at(i).x);
-				meshDetails.texCoords.emplace_back(meshes.dataTextured.texcoords.at(i).y);
+	DepthPyramid depthPyramid;
+	if (haveGpuCulling)
+		depthPyramid = create_depth_pyramid(window, allocator, depthReduceLayout.handle, depthBufferView.handle, pyramidSampler.handle);
 
-			}
+	std::vector<lut::Framebuffer> framebuffers;
+	create_swapchain_framebuffers(window, renderPass.handle, framebuffers, depthBufferView.handle);
 
-			meshDetails.vertexCount = meshSize;
+	//A swapchain image may still be presented while another frame is
+	//recorded, so render-finished semaphores are per swapchain image
+	std::vector<lut::Semaphore> renderFinished;
+	for (std::size_t i = 0; i < window.swapImages.size(); ++i)
+		renderFinished.emplace_back(lut::create_semaphore(window));
 
-			meshMaterial.emplace_back(meshes.materials[mesh.materialIndex].diffuseTexturePath.c_str());
+	//Load the mesh. On a cache hit, the vertex and index arrays are mapped
+	//from the cache file and uploaded from there.
+	CachedModel const model = load_cached_wavefront_obj("assets/src/sponza_with_ship.obj", cfg::kMergeMeshesByMaterial);
+	SimpleModel const& meshes = model.model;
 
-			texturedMeshes.emplace_back(create_textured_mesh(window, allocator, meshDetails.positions.data(), meshDetails.texCoords.data(), meshDetails.vertexCount));
+	//Load textures into image
+	lut::CommandPool loadCmdPool = lut::create_command_pool(window, VK_COMMAND_POOL_CREATE_TRANSIENT_BIT);
 
-		}
+	//Load each texture once; materials that share a texture share the image
+	lut::TextureCache textureCache(window, allocator, loadCmdPool.handle);
 
-		//Otherwise the mesh is coloured
-		else
-		{
-			ColouredMeshDetails meshDetails;
+	std::vector<bool> materialUsed(meshes.materials.size(), false);
+	for (SimpleMeshInfo const& mesh : meshes.meshes)
+	{
+		if (mesh.textured)
+			materialUsed[mesh.materialIndex] = true;
+	}
 
-			for (size_t i = start; i < start + meshSize; i++)
-			{
-				meshDetails.positions.emplace_back(meshes.dataUntextured.positions.at(i).x);
-				meshDetails.positions.emplace_back(meshes.dataUntextured.positions.at(i).y);
-				meshDetails.positions.emplace_back(meshes.dataUntextured.positions.at(i).z);
+	//Textures are decoded in parallel and uploaded in one batch
+	std::vector<char const*> texturePaths;
+	std::vector<size_t> texturedMaterials;
+	for (size_t i = 0; i < meshes.materials.size(); i++)
+	{
+		if (materialUsed[i])
+		{
+			texturePaths.emplace_back(meshes.materials[i].diffuseTexturePath.c_str());
+			texturedMaterials.emplace_back(i);
+		}
+	}
 
-				meshDetails.colours.emplace_back(meshes.materials[mesh.materialIndex].diffuseColor.r);
-				meshDetails.colours.emplace_back(meshes.materials[mesh.materialIndex].diffuseColor.g);
-				meshDetails.colours.emplace_back(meshes.materials[mesh.materialIndex].diffuseColor.b);
+	std::vector<lut::TextureCache::Handle> textureHandles(texturePaths.size());
+	textureCache.acquire(texturePaths.data(), texturePaths.size(), textureHandles.data());
 
-			}
+	std::vector<lut::TextureCache::Handle> materialTextures(meshes.materials.size());
+	for (size_t i = 0; i < texturedMaterials.size(); i++)
+		materialTextures[texturedMaterials[i]] = textureHandles[i];
 
-			meshDetails.vertexCount = meshSize;
+	std::fprintf(stderr, "Textures: %zu loaded, %u shared (cache hits)\n", textureCache.resident_count(), textureCache.hits);
 
-			colouredMeshes.emplace_back(create_coloured_mesh(window, allocator, meshDetails.positions.data(), meshDetails.colours.data(), meshDetails.vertexCount));
+	//Each texture once, in the bindless texture array or in its own
+	//descriptor set. Textured meshes store the index of their material's
+	//texture.
+	std::vector<VkImageView> textureViews;
+	std::vector<std::uint32_t> materialTextureIndices(meshes.materials.size(), 0);
+	{
+		std::unordered_map<lut::TextureCache::Handle, std::uint32_t> textureIndices;
+		for (size_t material : texturedMaterials)
+		{
+			auto const [it, inserted] = textureIndices.emplace(materialTextures[material], std::uint32_t(textureViews.size()));
+			if (inserted)
+				textureViews.emplace_back(textureCache.view(materialTextures[material]));
 
+			materialTextureIndices[material] = it->second;
 		}
-
 	}
 
+	if (haveBindless && textureViews.size() > maxTextures)
+		throw lut::Error("Too many textures: %zu, but the texture array holds at most %u", textureViews.size(), maxTextures);
 
-	//Create SceneUniform Buffer
-	lut::Buffer sceneUBO = lut::create_buffer(allocator, sizeof(glsl::SceneUniform), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, 0, VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE);
+	//Data structure to store all ColourizedMeshes
+	std::vector<ColorizedMesh> colouredMeshes;
 
-	//Create descriptor pool
-	lut::DescriptorPool dpool = lut::create_descriptor_pool(window);
+	//Data structure to store all TexturedMeshes
+	std::vector<TexturedMesh> texturedMeshes;
 
-	//Allocate descriptor set for uniform buffer
-	VkDescriptorSet sceneDescriptors = lut::alloc_desc_set(window, dpool.handle, sceneLayout.handle);
-	{
-		VkWriteDescriptorSet desc[1]{};
+	//Bounding boxes used for frustum culling, in the same order as the
+	//meshes above. The model has no per-mesh transforms, so the boxes are
+	//already in world space.
+	CullingBounds colouredBounds;
+	CullingBounds texturedBounds;
+
+	//Sub-allocate all meshes from shared buffers
+	MeshArena meshArena = create_mesh_arena(allocator, model);
+
+	//All mesh data is uploaded in a few batched submissions
+	auto const uploadClock = Clock_::now();
+	//The per-draw culling data is uploaded in the same batch, and is read
+	//by the compute shader
+	lut::UploadBatcher uploader(window, allocator, VkDeviceSize(8) << 20, 4,
+		VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT | VK_ACCESS_SHADER_READ_BIT,
+		VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT
+	);
 
-		VkDescriptorBufferInfo sceneUboInfo{};
-		sceneUboInfo.buffer = sceneUBO.buffer;
-		sceneUboInfo.range = VK_WHOLE_SIZE;
+	//The model arrays are already in the layout expected by the vertex and
+	//index buffers, so each mesh is uploaded straight from them
+	for (size_t i = 0; i < meshes.meshes.size(); i++)
+	{
+		SimpleMeshInfo const& mesh = meshes.meshes[i];
+		size_t const start = mesh.vertexStartIndex;
 
-		desc[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-		desc[0].dstSet = sceneDescriptors;
-		desc[0].dstBinding = 0;
-		desc[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-		desc[0].descriptorCount = 1;
-		desc[0].pBufferInfo = &sceneUboInfo;
+		//Only perform on textured meshes
+		if (mesh.textured)
+		{
+			texturedMeshes.emplace_back(create_textured_mesh(uploader, meshArena,
+				&model.textured.positions[start].x,
+				&model.textured.texcoords[start].x,
+				mesh.vertexCount,
+				model.textured.indices.data + model.indexOffsets[i],
+				mesh.indexCount
+			));
+			texturedMeshes.back().textureIndex = materialTextureIndices[mesh.materialIndex];
+			add_bounds(texturedBounds, mesh.aabbMin, mesh.aabbMax);
+		}
 
-		constexpr auto numSets = sizeof(desc) / sizeof(desc[0]);
-		vkUpdateDescriptorSets(window.device, numSets, desc, 0, nullptr);
+		//Otherwise the mesh is coloured
+		else
+		{
+			colouredMeshes.emplace_back(create_coloured_mesh(uploader, meshArena,
+				&model.untextured.positions[start].x,
+				&model.untextured.colors[start].x,
+				mesh.vertexCount,
+				model.untextured.indices.data + model.indexOffsets[i],
+				mesh.indexCount
+			));
+			add_bounds(colouredBounds, mesh.aabbMin, mesh.aabbMax);
+		}
 	}
 
-	//Load textures into image
-	lut::CommandPool loadCmdPool = lut::create_command_pool(window, VK_COMMAND_POOL_CREATE_TRANSIENT_BIT);
-
-	//Create image view for texture image
-	std::vector<lut::Image> images(texturedMeshes.size());
+	//Group draws by state for GPU culling
+	std::vector<DrawGroup> drawGroups;
+	std::vector<glsl::DrawInfo> const drawInfos = build_draw_groups(texturedMeshes, texturedBounds, colouredMeshes, colouredBounds, !haveBindless, drawGroups);
 
-	//Create images
-	for (size_t i = 0; i < texturedMeshes.size(); i++)
+	lut::Buffer drawInfoBuffer = lut::create_buffer(allocator,
+		std::max<VkDeviceSize>(1, drawInfos.size()) * sizeof(glsl::DrawInfo),
+		VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+		0,
+		VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE
+	);
+	if (!drawInfos.empty())
+		uploader.upload(drawInfoBuffer.buffer, 0, drawInfos.data(), drawInfos.size() * sizeof(glsl::DrawInfo));
+
+	//Per-draw visibility from the last frame, used by occlusion culling.
+	//It is shared by all frames in flight. All draws start out visible.
+	lut::Buffer visibilityBuffer = lut::create_buffer(allocator,
+		std::max<VkDeviceSize>(1, drawInfos.size()) * sizeof(std::uint32_t),
+		VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+		0,
+		VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE
+	);
+	if (!drawInfos.empty())
 	{
-		const char* path = meshMaterial[i];
-		images[i] = lut::load_image_texture2d(path, window, cpool.handle, allocator);
+		std::vector<std::uint32_t> const initialVisibility(drawInfos.size(), 1);
+		uploader.upload(visibilityBuffer.buffer, 0, initialVisibility.data(), initialVisibility.size() * sizeof(std::uint32_t));
 	}
 
-	std::vector<lut::ImageView> imageViews(images.size());
+	uploader.flush();
 
-	//Create image views
-	for (size_t i = 0; i < images.size(); i++)
-	{
-		imageViews[i] = lut::create_image_view_texture2d(window, images.at(i).image, VK_FORMAT_R8G8B8A8_SRGB);
-	}
+	std::fprintf(stderr, "Mesh upload: %.1f ms (%.1f MiB in %u copies, %u submits)\n",
+		std::chrono::duration<double, std::milli>(Clock_::now() - uploadClock).count(),
+		uploader.bytesUploaded / (1024.0 * 1024.0), uploader.copyCount, uploader.submitCount
+	);
 
-	//Create default texture sampler (required for descriptor set)
-	lut::Sampler defaultSampler = lut::create_default_sampler(window, false);
 
-	//Create descriptor sets
-	std::vector<VkDescriptorSet> meshDescriptorSets(texturedMeshes.size());
+	//Create descriptor pool
+	lut::DescriptorPool dpool = lut::create_descriptor_pool(window);
 
-	for (size_t i = 0; i < meshDescriptorSets.size(); i++)
-	{
-		meshDescriptorSets[i] = lut::alloc_desc_set(window, dpool.handle, objectLayout.handle);
+	//Uniform data is written straight into a persistently mapped ring, with
+	//one slice per frame in flight
+	lut::UniformRing uniformRing(window, allocator, cfg::kUniformFrameSize, std::uint32_t(framesInFlight));
 
-		//Update descriptor set
-		VkWriteDescriptorSet desc[1]{};
+	//GPU timestamps of the individual passes, one query range per frame in
+	//flight. Results are shown with a delay of framesInFlight frames.
+	lut::GpuProfiler gpuProfiler(window, std::uint32_t(framesInFlight));
+	if (!gpuProfiler.enabled())
+		std::fprintf(stderr, "GPU profiler: timestamps not supported by the graphics queue\n");
 
-		VkDescriptorImageInfo textureInfo{};
-		textureInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-		textureInfo.imageView = imageViews.at(i).handle;
-		textureInfo.sampler = defaultSampler.handle;
+	//Create per-frame resources
+	std::vector<FrameResources> frames(framesInFlight);
+	for (auto& frame : frames)
+	{
+		frame.cpool = lut::create_command_pool(window, VK_COMMAND_POOL_CREATE_TRANSIENT_BIT);
+		frame.cbuffer = lut::alloc_command_buffer(window, frame.cpool.handle);
 
-		desc[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-		desc[0].dstSet = meshDescriptorSets[i];
-		desc[0].dstBinding = 0;
-		desc[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-		desc[0].descriptorCount = 1;
-		desc[0].pImageInfo = &textureInfo;
+		frame.inFlight = lut::create_fence(window, VK_FENCE_CREATE_SIGNALED_BIT);
+		frame.imageAvailable = lut::create_semaphore(window);
 
-		constexpr auto numSets = sizeof(desc) / sizeof(desc[0]);
+		frame.samplerDescriptors = lut::alloc_desc_set(window, dpool.handle, samplerLayout.handle);
 
-		vkUpdateDescriptorSets(window.device, numSets, desc, 0, nullptr);
-	}
+		if (!options.pngDir.empty())
+		{
+			frame.readback = lut::create_buffer(allocator,
+				VkDeviceSize(window.swapchainExtent.width) * window.swapchainExtent.height * 4,
+				VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+				VMA_ALLOCATION_CREATE_HOST_ACCESS_RANDOM_BIT | VMA_ALLOCATION_CREATE_MAPPED_BIT
+			);
+
+			VmaAllocationInfo readbackInfo{};
+			vmaGetAllocationInfo(allocator.allocator, frame.readback.allocation, &readbackInfo);
+			assert(readbackInfo.pMappedData);
+			frame.mappedReadback = static_cast<std::uint8_t const*>(readbackInfo.pMappedData);
+		}
 
-	//Perform the same but with anisotropic filtering
-	lut::Sampler anistropicSampler = lut::create_default_sampler(window, true);
+		if (!haveGpuCulling)
+			continue;
 
+		frame.drawCommands = lut::create_buffer(allocator,
+			std::max<VkDeviceSize>(1, 2 * drawInfos.size()) * sizeof(VkDrawIndexedIndirectCommand),
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+			0,
+			VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE
+		);
+		frame.drawCounts = lut::create_buffer(allocator,
+			(2 * drawGroups.size() + 1) * sizeof(std::uint32_t),
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VMA_ALLOCATION_CREATE_HOST_ACCESS_RANDOM_BIT | VMA_ALLOCATION_CREATE_MAPPED_BIT
+		);
 
-	std::vector<VkDescriptorSet> anisotropicMeshDescSets(texturedMeshes.size());
+		VmaAllocationInfo countsInfo{};
+		vmaGetAllocationInfo(allocator.allocator, frame.drawCounts.allocation, &countsInfo);
+		assert(countsInfo.pMappedData);
+		frame.mappedCounts = static_cast<std::uint32_t const*>(countsInfo.pMappedData);
 
-	for (size_t i = 0; i < anisotropicMeshDescSets.size(); i++)
-	{
-		anisotropicMeshDescSets[i] = lut::alloc_desc_set(window, dpool.handle, objectLayout.handle);
+		frame.cullDescriptors = lut::alloc_desc_set(window, dpool.handle, cullLayout.handle);
+		update_cull_descriptors(window, frame, drawInfoBuffer.buffer, visibilityBuffer.buffer, uniformRing.buffer.buffer, depthPyramid.view.handle, pyramidSampler.handle);
+	}
 
-		//Update descriptor set
+	//Allocate descriptor set for uniform buffer. It uses a dynamic offset,
+	//so one set covers all slices of the ring.
+	VkDescriptorSet sceneDescriptors = lut::alloc_desc_set(window, dpool.handle, sceneLayout.handle);
+	{
 		VkWriteDescriptorSet desc[1]{};
 
-		VkDescriptorImageInfo textureInfo{};
-		textureInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-		textureInfo.imageView = imageViews.at(i).handle;
-		textureInfo.sampler = anistropicSampler.handle;
+		VkDescriptorBufferInfo sceneUboInfo{};
+		sceneUboInfo.buffer = uniformRing.buffer.buffer;
+		sceneUboInfo.range = sizeof(glsl::SceneUniform);
 
 		desc[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-		desc[0].dstSet = anisotropicMeshDescSets[i];
+		desc[0].dstSet = sceneDescriptors;
 		desc[0].dstBinding = 0;
-		desc[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		desc[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
 		desc[0].descriptorCount = 1;
-		desc[0].pImageInfo = &textureInfo;
+		desc[0].pBufferInfo = &sceneUboInfo;
 
 		constexpr auto numSets = sizeof(desc) / sizeof(desc[0]);
-
 		vkUpdateDescriptorSets(window.device, numSets, desc, 0, nullptr);
 	}
 
-
-	/*
-#ifdef OVERDRAW
-	//Setting up storage image for overdrawing visualization
-	lut::Image storageImage;
-
-	VkImageCreateInfo imageInfo{};
-	imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
-	imageInfo.imageType = VK_IMAGE_TYPE_2D;
-	imageInfo.format = VK_FORMAT_R32_UINT; //Only need one channel (number of shader occurences)
-	imageInfo.extent.width = window.swapchainExtent.width;
-	imageInfo.extent.height = window.swapchainExtent.height;
-	imageInfo.extent.depth = 1;
-	imageInfo.mipLevels = 1;
-	imageInfo.arrayLayers = 1;
-	imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
-	imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
-	imageInfo.usage = VK_IMAGE_USAGE_STORAGE_BIT; //Used for storage
-	imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-	imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-
-	//Create the image
-	if (auto const res = vkCreateImage(window.device, &imageInfo, nullptr, &storageImage.image); VK_SUCCESS != res)
-	{
-		throw lut::Error("Unable to create image\n" "vkCreateImage() returned %s", lut::to_string(res).c_str());
-	}
-
-	//Allocate memory for the newly created image
-	VmaAllocationCreateInfo allocInfo{};
-	allocInfo.flags = 0;
-	allocInfo.usage = VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE;
-
-
-	if (auto const res = vmaCreateImage(allocator.allocator, &imageInfo, &allocInfo, &storageImage.image, &storageImage.allocation, nullptr); VK_SUCCESS != res)
+	//The texture array. Textured draws bind it once and do not need any
+	//per-draw descriptors. Without descriptor indexing, there is one set per
+	//texture instead. The sampler is in each frame's sampler set.
+	std::vector<VkDescriptorSet> textureDescriptors;
+	if (haveBindless)
 	{
-		throw lut::Error("Unable to allocate storage image\n" "vmaCreateImage returned %s", lut::to_string(res).c_str());
+		textureDescriptors.emplace_back(alloc_texture_desc_set(window, dpool.handle, objectLayout.handle, std::uint32_t(textureViews.size())));
+		update_texture_descriptors(window, textureDescriptors.back(), textureViews);
 	}
-
-	//Create image view
-	VkImageViewCreateInfo viewInfo{};
-	viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
-	viewInfo.image = storageImage.image;
-	viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
-	viewInfo.format = VK_FORMAT_R32_UINT;
-	viewInfo.components = VkComponentMapping{}; // == Identity
-	viewInfo.subresourceRange = VkImageSubresourceRange{
-		VK_IMAGE_ASPECT_COLOR_BIT,
-		0, 1,
-		0, 1
-	};
-
-	lut::ImageView view;
-
-	if (auto const res = vkCreateImageView(window.device, &viewInfo, nullptr, &view.handle); VK_SUCCESS != res)
+	else
 	{
-		throw lut::Error("Unable to allocate storage image view\n" "vkCreateImageView returned %s", lut::to_string(res).c_str());
+		for (VkImageView view : textureViews)
+		{
+			textureDescriptors.emplace_back(lut::alloc_desc_set(window, dpool.handle, objectLayout.handle));
+			update_texture_descriptors(window, textureDescriptors.back(), { view });
+		}
 	}
 
-	//Create a layout for the descriptor set
-	lut::DescriptorSetLayout storageLayout = create_storage_descriptor_layout(window);
-
-	//Create render pass
-	lut::RenderPass storagePass = create_storage_render_pass(window);
-
-	//Create storage pipeline layout
-	lut::PipelineLayout storagePipeLayout = create_storage_pipeline_layout(window, storageLayout.handle);
-
-	//Create a pipeline using the layout
-	lut::Pipeline storagePipe = create_storage_pipeline(window, storagePass.handle, storagePipeLayout.handle, fds, sdf);
 
-	//Create storage descriptor set
-	//Allocate descriptor set for uniform buffer
-	VkDescriptorSet storageDescriptorSet = lut::alloc_desc_set(window, dpool.handle, storageLayout.handle);
-	{
-		VkWriteDescriptorSet desc[1]{};
-
-		VkDescriptorImageInfo storageInfo{};
-		storageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-		storageInfo.imageView = view.handle;
-		storageInfo.sampler = VK_NULL_HANDLE; //No need for a sampler
-
-		desc[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-		desc[0].dstSet = storageDescriptorSet;
-		desc[0].dstBinding = 0;
-		desc[0].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
-		desc[0].descriptorCount = 1;
-		desc[0].pImageInfo = &storageInfo;
+	//Overdraw counts, shared by all frames in flight like the depth buffer
+	auto [overdrawImage, overdrawView] = create_overdraw_image(window, allocator);
 
-		constexpr auto numSets = sizeof(desc) / sizeof(desc[0]);
-		vkUpdateDescriptorSets(window.device, numSets, desc, 0, nullptr);
-	}
+	VkDescriptorSet overdrawDescriptors = lut::alloc_desc_set(window, dpool.handle, storageLayout.handle);
+	update_overdraw_descriptors(window, overdrawDescriptors, overdrawView.handle);
 
-#endif
-*/
 	//Get image count for ImGUi
-
-	std::uint32_t imageCount = 0;
-	vkGetSwapchainImagesKHR(window.device, window.swapchain, &imageCount, nullptr);
+	std::uint32_t const imageCount = std::uint32_t(window.swapImages.size());
 
 	//Setup ImGui
 	//InitImgui();
@@ -575,58 +1004,184 @@ int main() try
 
 	ImGui::StyleColorsDark();
 
-	ImGui_ImplGlfw_InitForVulkan(window.window, true);
+	//Headless, the UI is still built every frame, but never drawn
+	if (!options.headless)
+		ImGui_ImplGlfw_InitForVulkan(window.window, true);
+
 	ImGui_ImplVulkan_InitInfo init_info = {};
 	init_info.Instance = window.instance;
 	init_info.PhysicalDevice = window.physicalDevice;
 	init_info.Device = window.device;
 	init_info.QueueFamily = window.graphicsFamilyIndex;
 	init_info.Queue = window.graphicsQueue;
-	init_info.PipelineCache = VK_NULL_HANDLE;
+	init_info.PipelineCache = pipelineCache.handle;
 	init_info.DescriptorPool = dpool.handle;
 	init_info.Allocator = nullptr;
-	init_info.MinImageCount = imageCount;
-	init_info.ImageCount = imageCount;
-	
-	lut::RenderPass imguiRenderPass = create_imgui_render_pass(window);
+	init_info.MinImageCount = std::max(imageCount, 2u);
+	//ImGui keeps one set of vertex/index buffers per "image"; there must be
+	//at least one per frame in flight
+	init_info.ImageCount = std::max(imageCount, std::uint32_t(framesInFlight));
 
-	init_info.RenderPass = imguiRenderPass.handle;
+	//ImGui is drawn at the end of the last render pass of the frame (the
+	//late or the single pass, which are compatible)
+	init_info.RenderPass = lateRenderPass.handle;
+	init_info.Subpass = 0;
 
 	ImGui_ImplVulkan_Init(&init_info);
 
+	ImGui_ImplVulkan_CreateFontsTexture();
 
-	std::vector<lut::Framebuffer> imGuiframebuffers;
-	create_imgui_framebuffers(window, imguiRenderPass.handle, imGuiframebuffers);
+	int renderMode = 0;
 
-	std::vector<VkCommandBuffer> imguicbuffers;
-	std::vector<lut::Fence> imguicbfences;
+	//Texture sampling. A change rebuilds each frame's sampler when the frame
+	//is next used (see FrameResources::samplerVersion).
+	//The settings start out as lut::SamplerDesc's defaults.
+	const char* filterChoices[] = { "Nearest", "Bilinear", "Trilinear" };
+	int filterMode = 2;
 
-	for (std::size_t i = 0; i < imGuiframebuffers.size(); ++i)
-	{
-		imguicbuffers.emplace_back(lut::alloc_command_buffer(window, cpool.handle));
-		imguicbfences.emplace_back(lut::create_fence(window, VK_FENCE_CREATE_SIGNALED_BIT));
-	}
+	lut::SamplerDesc const defaultSamplerDesc;
+	float anisotropy = defaultSamplerDesc.maxAnisotropy; //1 disables anisotropic filtering
+	float lodBias = defaultSamplerDesc.mipLodBias;
+	std::uint32_t samplerVersion = 1;
 
-	ImGui_ImplVulkan_CreateFontsTexture();
+	bool const haveAnisotropy = VK_TRUE == supportedFeatures.samplerAnisotropy;
+	float const maxLodBias = std::min(limits.maxSamplerLodBias, 4.f);
 
-	lut::Semaphore imguiSemaphore = lut::create_semaphore(window);
+	//Frustum culling: off, on the CPU, or on the GPU with indirect draws
+	const char* cullChoices[] = { "Off", "CPU", "GPU" };
+	int const numCullChoices = haveGpuCulling ? 3 : 2;
+	int cullMode = numCullChoices - 1;
 
-	bool anisotropicUsed = false;
-	int renderMode = 0;
+	//Two-phase occlusion culling against the depth pyramid (GPU only)
+	bool occlusionCulling = true;
+
+	//Number of draws that survived GPU culling, read back with a delay of
+	//framesInFlight frames
+	std::size_t gpuVisibleDraws = drawInfos.size();
+	std::size_t gpuOccludedDraws = 0;
+
+	//Per-mesh visibility, updated every frame
+	std::vector<std::uint8_t> texturedVisible(texturedMeshes.size(), 1);
+	std::vector<std::uint8_t> colouredVisible(colouredMeshes.size(), 1);
+	std::size_t const totalMeshCount = texturedMeshes.size() + colouredMeshes.size();
 
 	lut::Pipeline* usedColourPipe = &colouredPipe;
 	lut::Pipeline* usedTexturePipe = &texturedPipe;
 
-	const char* choices[] = { "Standard", "MipMap", "Frag Depth", "Partial Frag Depth" };
+	//"Depth Pre-pass" shades like "Standard", but lays down depth first, so
+	//that each pixel is only shaded once. "Overdraw" shows how many times
+	//each pixel is shaded, and must stay last, as it may be unsupported.
+	const char* choices[] = { "Standard", "MipMap", "Frag Depth", "Partial Frag Depth", "Depth Pre-pass", "Overdraw" };
 	int numChoices = sizeof(choices) / sizeof(choices[0]);
+	if (!haveOverdraw)
+		numChoices--;
 
 	// Application main loop
 	bool recreateSwapchain = false;
 
+	//Index of the current frame in flight
+	std::size_t frameIndex = 0;
+
+	//Frame time statistics. The displayed value is averaged over a short
+	//interval; the overall average is reported on exit.
+	float frameTimeAccum = 0.f;
+	std::uint32_t frameTimeCount = 0;
+	float displayedFrameTime = 0.f;
+
+	double totalFrameTime = 0.0;
+	std::uint64_t totalFrameCount = 0;
+
+	//Headless benchmark output. Frames are written out once they have
+	//completed, i.e., with a delay of framesInFlight frames.
+	std::unique_ptr<std::FILE, decltype(&std::fclose)> csv(nullptr, &std::fclose);
+	if (!options.csvPath.empty())
+	{
+		csv.reset(std::fopen(options.csvPath.c_str(), "w"));
+		if (!csv)
+			throw lut::Error("Unable to open '%s' for writing", options.csvPath.c_str());
+
+		std::fprintf(csv.get(), "frame,frame_ms,cpu_ms,gpu_ms,draws,drawn,occluded\n");
+	}
+
+	//Culling results of GPU-culled benchmark frames, summed for the report
+	//on exit
+	std::uint64_t benchmarkCulledFrames = 0;
+	std::uint64_t benchmarkDrawn = 0;
+	std::uint64_t benchmarkOccluded = 0;
+
+	//Number of draws that survived GPU culling (both phases), and number of
+	//draws rejected by occlusion culling. Valid once the frame has completed.
+	auto const read_cull_counts = [&] (FrameResources const& aFrame, std::size_t& aDrawn, std::size_t& aOccluded) {
+		vmaInvalidateAllocation(allocator.allocator, aFrame.drawCounts.allocation, 0, VK_WHOLE_SIZE);
+
+		aDrawn = 0;
+		for (std::size_t i = 0; i < 2 * drawGroups.size(); i++)
+			aDrawn += aFrame.mappedCounts[i];
+
+		aOccluded = aFrame.mappedCounts[2 * drawGroups.size()];
+	};
+
+	auto const writes_png = [&] (std::uint64_t aFrame) {
+		return !options.pngDir.empty() && 0 == aFrame % options.pngEvery;
+	};
+
+	auto const finish_benchmark_frame = [&] (FrameResources& aFrame, std::uint32_t aFrameIndex) {
+		if (!aFrame.benchmarkPending)
+			return;
+
+		aFrame.benchmarkPending = false;
+
+		//Draws drawn and occluded are left empty without GPU culling
+		char culling[48] = ",";
+		if (aFrame.culledOnGpu)
+		{
+			std::size_t drawn = 0, occluded = 0;
+			read_cull_counts(aFrame, drawn, occluded);
+			std::snprintf(culling, sizeof(culling), "%zu,%zu", drawn, occluded);
+
+			++benchmarkCulledFrames;
+			benchmarkDrawn += drawn;
+			benchmarkOccluded += occluded;
+		}
+
+		//GPU timings are left empty if timestamps are not supported
+		if (csv)
+		{
+			if (gpuProfiler.collect(aFrameIndex))
+				std::fprintf(csv.get(), "%u,%.4f,%.4f,%.4f,%zu,%s\n", aFrame.benchmarkFrame, aFrame.frameMs, aFrame.cpuMs, gpuProfiler.frame().lastMs, totalMeshCount, culling);
+			else
+				std::fprintf(csv.get(), "%u,%.4f,%.4f,,%zu,%s\n", aFrame.benchmarkFrame, aFrame.frameMs, aFrame.cpuMs, totalMeshCount, culling);
+		}
+
+		if (writes_png(aFrame.benchmarkFrame))
+		{
+			vmaInvalidateAllocation(allocator.allocator, aFrame.readback.allocation, 0, VK_WHOLE_SIZE);
+
+			char name[32];
+			std::snprintf(name, sizeof(name), "/frame%05u.png", aFrame.benchmarkFrame);
+			std::string const path = options.pngDir + name;
+
+			int const width = int(window.swapchainExtent.width);
+			int const height = int(window.swapchainExtent.height);
+			if (!stbi_write_png(path.c_str(), width, height, 4, aFrame.mappedReadback, width * 4))
+				throw lut::Error("Unable to write '%s'", path.c_str());
+		}
+	};
+
+	//A replay renders one frame per kReplayTimestep of the recording
+	std::uint64_t frameLimit = std::numeric_limits<std::uint64_t>::max();
+	if (!options.replayPath.empty())
+		frameLimit = std::uint64_t(camera_path_duration(cameraPath) / cfg::kReplayTimestep) + 1;
+	else if (options.headless)
+		frameLimit = options.frames;
+
 	//Record time before main loop starts
 	auto previousClock = Clock_::now();
+	auto const loopClock = previousClock;
+
+	std::fprintf(stderr, "Startup: %.1f ms\n", std::chrono::duration<double, std::milli>(previousClock - startupClock).count());
 
-	while (!glfwWindowShouldClose(window.window))
+	while (totalFrameCount < frameLimit && (options.headless || !glfwWindowShouldClose(window.window)))
 	{
 		// Let GLFW process events.
 		// glfwPollEvents() checks for events, processes them. If there are no
@@ -636,7 +1191,8 @@ int main() try
 		// render as fast as possible, whereas the latter is useful for
 		// input-driven applications, where redrawing is only needed in
 		// reaction to user input (or similar).
-		glfwPollEvents(); // or: glfwWaitEvents()
+		if (!options.headless)
+			glfwPollEvents(); // or: glfwWaitEvents()
 
 		// Recreate swap chain?
 		if (recreateSwapchain)
@@ -649,84 +1205,327 @@ int main() try
 
 			if (changes.changedFormat)
 			{
-				renderPass = create_render_pass(window);
-				imguiRenderPass = create_imgui_render_pass(window);
+				renderPass = create_render_pass(window, false);
+				singleRenderPass = create_render_pass(window, true);
+				lateRenderPass = create_late_render_pass(window);
+
+				//ImGui's pipeline depends on the render pass as well
+				ImGui_ImplVulkan_Shutdown();
+				init_info.RenderPass = lateRenderPass.handle;
+				ImGui_ImplVulkan_Init(&init_info);
+				ImGui_ImplVulkan_CreateFontsTexture();
 			}
-				
+
 
 			if (changes.changedSize)
+			{
 				std::tie(depthBuffer, depthBufferView) = create_depth_buffer(window, allocator);
 
-			framebuffers.clear();
-			imGuiframebuffers.clear();
-
-			create_swapchain_framebuffers(window, renderPass.handle, framebuffers, depthBufferView.handle);
-			create_imgui_framebuffers(window, imguiRenderPass.handle, imGuiframebuffers);
+				std::tie(overdrawImage, overdrawView) = create_overdraw_image(window, allocator);
+				update_overdraw_descriptors(window, overdrawDescriptors, overdrawView.handle);
 
-			//Recreate semaphore
-			imageAvailable = lut::create_semaphore(window);
+				//The depth pyramid matches the depth buffer's size
+				if (haveGpuCulling)
+				{
+					depthPyramid = create_depth_pyramid(window, allocator, depthReduceLayout.handle, depthBufferView.handle, pyramidSampler.handle);
 
-			if (changes.changedSize)
+					for (auto const& frame : frames)
+						update_cull_descriptors(window, frame, drawInfoBuffer.buffer, visibilityBuffer.buffer, uniformRing.buffer.buffer, depthPyramid.view.handle, pyramidSampler.handle);
+				}
+			}
+
+			framebuffers.clear();
+
+			create_swapchain_framebuffers(window, renderPass.handle, framebuffers, depthBufferView.handle);
+
+			//Recreate semaphores; an image-available semaphore may have been
+			//signalled by an acquire whose frame was then skipped
+			for (auto& frame : frames)
+				frame.imageAvailable = lut::create_semaphore(window);
+
+			renderFinished.clear();
+			for (std::size_t i = 0; i < window.swapImages.size(); ++i)
+				renderFinished.emplace_back(lut::create_semaphore(window));
+
+			//Pipelines use dynamic viewport/scissor state, so they only depend
+			//on the render pass, which changes with the swapchain format
+			if (changes.changedFormat)
 			{
+				auto const pipelineClock = Clock_::now();
 
-				//Create pipelines that adapt to the new window
-				colouredPipe = create_coloured_pipeline(window, renderPass.handle, colouredPipeLayout.handle, cfg::kColourVertShaderPath, cfg::kColourFragShaderPath);
-				texturedPipe = create_textured_pipeline(window, renderPass.handle, texturedPipeLayout.handle, cfg::kTextureVertShaderPath, cfg::kTextureFragShaderPath);
-				mipmapColouredPipe = create_coloured_pipeline(window, renderPass.handle, colouredPipeLayout.handle, cfg::kColourVertShaderPath, cfg::kColourFragShaderPath);
-				mipmapTexturedPipe = create_textured_pipeline(window, renderPass.handle, texturedPipeLayout.handle, cfg::kTextureVertShaderPath, cfg::kTexFragMipmapShaderPath);
-				depthColouredPipe = create_coloured_pipeline(window, renderPass.handle, colouredPipeLayout.handle, cfg::kColourVertShaderPath, cfg::kColFragDepthShaderPath);
-				depthTexturedPipe = create_textured_pipeline(window, renderPass.handle, texturedPipeLayout.handle, cfg::kTextureVertShaderPath, cfg::kTexFragDepthShaderPath);
-				depthPartialColouredPipe = create_coloured_pipeline(window, renderPass.handle, colouredPipeLayout.handle, cfg::kColourVertShaderPath, cfg::kColFragDepthPartialShaderPath);
-				depthPartialTexturedPipe = create_textured_pipeline(window, renderPass.handle, texturedPipeLayout.handle, cfg::kTextureVertShaderPath, cfg::kTexFragDepthPartialShaderPath);
+				create_pipelines(window, renderPass.handle, colouredPipeLayout.handle, texturedPipeLayout.handle, pipelineCache.handle, shaderModules, pipelineDescs, pipelineCount);
+				depthOnlyPipe = create_position_only_pipeline(window, renderPass.handle, colouredPipeLayout.handle, pipelineCache.handle, shaderModules.at(cfg::kDepthOnlyVertShaderPath).handle, VK_NULL_HANDLE);
+				if (haveOverdraw)
+					create_overdraw_pipelines();
 
+				std::fprintf(stderr, "Recreated pipelines: %.1f ms\n", std::chrono::duration<double, std::milli>(Clock_::now() - pipelineClock).count());
 			}
 
 			recreateSwapchain = false;
 			continue;
 		}
 
-		//Acquire next swapchain image
-		std::uint32_t imageIndex = 0;
-		auto const acquireRes = vkAcquireNextImageKHR(window.device, window.swapchain, std::numeric_limits<std::uint64_t>::max(), imageAvailable.handle, VK_NULL_HANDLE, &imageIndex);
+		FrameResources& frame = frames[frameIndex];
 
-		if (VK_SUBOPTIMAL_KHR == acquireRes || VK_ERROR_OUT_OF_DATE_KHR == acquireRes)
+		//Wait until the GPU has finished the previous use of this frame's
+		//resources. The other frames in flight may still be executing.
+		if (auto const res = vkWaitForFences(window.device, 1, &frame.inFlight.handle, VK_TRUE, std::numeric_limits<std::uint64_t>::max()); VK_SUCCESS != res)
 		{
-			recreateSwapchain = true;
-			continue;
+			throw lut::Error("Unable to wait for frame fence %zu\n" "vkWaitForFences() returned %s", frameIndex, lut::to_string(res).c_str());
 		}
 
-		if (VK_SUCCESS != acquireRes)
+		finish_benchmark_frame(frame, std::uint32_t(frameIndex));
+
+		//CPU time of the frame, excluding the waits for the GPU
+		auto const cpuClock = Clock_::now();
+
+		//The frame's previous use has completed, so its culling results
+		//can be read back
+		if (frame.culledOnGpu)
 		{
-			throw lut::Error("Unable to acquire next swapchain image" "vkAcquireNextImageKHR() returned %s", lut::to_string(acquireRes).c_str());
+			read_cull_counts(frame, gpuVisibleDraws, gpuOccludedDraws);
+			frame.culledOnGpu = false;
 		}
 
-		//Wait for command buffer to be available
-		assert(std::size_t(imageIndex) < cbfences.size());
+		//Acquire next swapchain image. Headless, each frame in flight has
+		//its own offscreen image.
+		std::uint32_t imageIndex = std::uint32_t(frameIndex);
+		if (!options.headless)
+		{
+			auto const acquireRes = vkAcquireNextImageKHR(window.device, window.swapchain, std::numeric_limits<std::uint64_t>::max(), frame.imageAvailable.handle, VK_NULL_HANDLE, &imageIndex);
+
+			if (VK_SUBOPTIMAL_KHR == acquireRes || VK_ERROR_OUT_OF_DATE_KHR == acquireRes)
+			{
+				recreateSwapchain = true;
+				continue;
+			}
+
+			if (VK_SUCCESS != acquireRes)
+			{
+				throw lut::Error("Unable to acquire next swapchain image" "vkAcquireNextImageKHR() returned %s", lut::to_string(acquireRes).c_str());
+			}
+		}
 
-		if (auto const res = vkWaitForFences(window.device, 1, &cbfences[imageIndex].handle, VK_TRUE, std::numeric_limits<std::uint64_t>::max()); VK_SUCCESS != res)
+		//Only reset the fence once work is guaranteed to be submitted
+		if (auto const res = vkResetFences(window.device, 1, &frame.inFlight.handle); VK_SUCCESS != res)
 		{
-			throw lut::Error("Unable to wait for command buffer fence %u\n" "vkWaitForFences() returned %s", imageIndex, lut::to_string(res).c_str());
+			throw lut::Error("Unable to reset frame fence %zu\n" "vkResetFences() returned %s", frameIndex, lut::to_string(res).c_str());
 		}
 
-		if (auto const res = vkResetFences(window.device, 1, &cbfences[imageIndex].handle); VK_SUCCESS != res)
+		//All command buffers of this frame are recorded from scratch
+		if (auto const res = vkResetCommandPool(window.device, frame.cpool.handle, 0); VK_SUCCESS != res)
 		{
-			throw lut::Error("Unable to reset command buffer fence %u\n" "vkResetFences() returned %s", imageIndex, lut::to_string(res).c_str());
+			throw lut::Error("Unable to reset command pool %zu\n" "vkResetCommandPool() returned %s", frameIndex, lut::to_string(res).c_str());
 		}
 
 		//Record and submit commands
-		assert(std::size_t(imageIndex) < cbuffers.size());
 		assert(std::size_t(imageIndex) < framebuffers.size());
+		assert(std::size_t(imageIndex) < renderFinished.size());
 
 		//Update state
 		auto const now = Clock_::now();
 		auto const dt = std::chrono::duration_cast<Secondsf_>(now - previousClock).count();
+		previousClock = now;
+
+		frameTimeAccum += dt;
+		++frameTimeCount;
+		if (frameTimeAccum >= cfg::kFrameTimeInterval)
+		{
+			displayedFrameTime = frameTimeAccum / frameTimeCount;
+			frameTimeAccum = 0.f;
+			frameTimeCount = 0;
+		}
+
+		std::uint64_t const frameNumber = totalFrameCount;
+
+		totalFrameTime += dt;
+		++totalFrameCount;
+
+		if (!options.replayPath.empty())
+		{
+			std::uint32_t inputs = 0;
+			state.camera2world = sample_camera_path(cameraPath, float(frameNumber * double(cfg::kReplayTimestep)), &inputs);
+			unpack_inputs(state, inputs);
+		}
+		else if (options.headless)
+			state.camera2world = benchmark_camera(std::uint32_t(frameNumber), options.frames);
+		else
+		{
+			update_user_state(state, dt);
 
-		update_user_state(state, dt);
+			if (!options.recordPath.empty())
+				add_camera_sample(cameraPath, float(totalFrameTime), pack_inputs(state), state.camera2world);
+		}
 
 		//Prepare data for this frame
 		glsl::SceneUniform sceneUniforms{};
 		update_scene_uniforms(sceneUniforms, window.swapchainExtent.width, window.swapchainExtent.height, state);
 
+		//Skip meshes that are entirely outside of the view frustum
+		bool const gpuCulling = 2 == cullMode;
+		bool const occlusion = gpuCulling && occlusionCulling;
+		bool const latePass = occlusion && !drawInfos.empty();
+		bool const depthPrepass = 4 == renderMode;
+		bool const overdraw = 5 == renderMode;
+		EScenePass const scenePass = overdraw ? EScenePass::overdraw : EScenePass::shaded;
+
+		std::size_t visibleMeshCount = gpuCulling ? gpuVisibleDraws : totalMeshCount;
+		if (1 == cullMode)
+		{
+			Frustum const frustum = extract_frustum_planes(sceneUniforms.projCam);
+			visibleMeshCount = cull_aabbs(frustum, texturedBounds, texturedVisible.data())
+				+ cull_aabbs(frustum, colouredBounds, colouredVisible.data());
+		}
+
+		//Setup new ImGui frame
+		ImGui_ImplVulkan_NewFrame();
+		if (options.headless)
+		{
+			//Without a platform backend, ImGui needs the display size and
+			//time step from us
+			io.DisplaySize = ImVec2(float(window.swapchainExtent.width), float(window.swapchainExtent.height));
+			io.DeltaTime = std::max(dt, 1e-6f);
+		}
+		else
+			ImGui_ImplGlfw_NewFrame();
+		ImGui::NewFrame();
+		ImGui::Begin("ImGui Window");
+		ImGui::Text("Frame time: %.2f ms (%.0f FPS), %zu frames in flight", displayedFrameTime * 1000.f, displayedFrameTime > 0.f ? 1.f / displayedFrameTime : 0.f, framesInFlight);
+		if (gpuProfiler.enabled() && ImGui::CollapsingHeader("GPU Profiler"))
+		{
+			//Rolling statistics over the last GpuProfiler::kHistoryLength frames
+			auto const add_row = [] (lut::GpuProfiler::ScopeStats const& aStats) {
+				ImGui::TableNextRow();
+				ImGui::TableNextColumn();
+				ImGui::TextUnformatted(aStats.name.c_str());
+				ImGui::TableNextColumn();
+				ImGui::Text("%.3f", aStats.lastMs);
+				ImGui::TableNextColumn();
+				ImGui::Text("%.3f", aStats.minMs);
+				ImGui::TableNextColumn();
+				ImGui::Text("%.3f", aStats.avgMs);
+				ImGui::TableNextColumn();
+				ImGui::Text("%.3f", aStats.maxMs);
+			};
+
+			if (ImGui::BeginTable("GPU passes", 5, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg))
+			{
+				ImGui::TableSetupColumn("Pass (ms)");
+				ImGui::TableSetupColumn("Last");
+				ImGui::TableSetupColumn("Min");
+				ImGui::TableSetupColumn("Avg");
+				ImGui::TableSetupColumn("Max");
+				ImGui::TableHeadersRow();
+
+				for (auto const& scope : gpuProfiler.scopes())
+					add_row(scope);
+				add_row(gpuProfiler.frame());
+
+				ImGui::EndTable();
+			}
+
+			auto const& gpuFrame = gpuProfiler.frame();
+
+			char overlay[32];
+			std::snprintf(overlay, sizeof(overlay), "GPU frame: %.2f ms", gpuFrame.lastMs);
+			ImGui::PlotLines("##GPU frame time", gpuFrame.history.data(), int(gpuFrame.historyCount), int(gpuFrame.historyOffset), overlay, 0.f, gpuFrame.maxMs * 1.1f, ImVec2(0.f, 60.f));
+		}
+		ImGui::Text("Edit the scene using these filters");
+		if (ImGui::Combo("Texture Filtering", &filterMode, filterChoices, IM_ARRAYSIZE(filterChoices)))
+			++samplerVersion;
+		if (haveAnisotropy && ImGui::SliderFloat("Anisotropy", &anisotropy, 1.f, limits.maxSamplerAnisotropy, "%.0fx"))
+			++samplerVersion;
+		if (ImGui::SliderFloat("Mip LOD Bias", &lodBias, -maxLodBias, maxLodBias, "%.2f"))
+			++samplerVersion;
+		if (ImGui::Combo("Frustum Culling", &cullMode, cullChoices, numCullChoices) && 1 != cullMode)
+		{
+			std::fill(texturedVisible.begin(), texturedVisible.end(), std::uint8_t(1));
+			std::fill(colouredVisible.begin(), colouredVisible.end(), std::uint8_t(1));
+		}
+		ImGui::Text("Meshes: %zu visible, %zu culled", visibleMeshCount, totalMeshCount - visibleMeshCount);
+		if (gpuCulling)
+		{
+			ImGui::Checkbox("Occlusion Culling", &occlusionCulling);
+			ImGui::Text("GPU culling: %zu indirect draw calls", (occlusion ? 2 : 1) * drawGroups.size());
+			if (occlusion)
+				ImGui::Text("Occluded meshes: %zu", gpuOccludedDraws);
+		}
+		if (ImGui::Combo("Render Mode", &renderMode, choices, numChoices))
+		{
+			if (renderMode == 0)
+			{
+				usedColourPipe = &colouredPipe;
+				usedTexturePipe = &texturedPipe;
+			}
+
+			if (renderMode == 1)
+			{
+				usedColourPipe = &mipmapColouredPipe;
+				usedTexturePipe = &mipmapTexturedPipe;
+			}
+
+			if (renderMode == 2)
+			{
+				usedColourPipe = &depthColouredPipe;
+				usedTexturePipe = &depthTexturedPipe;
+			}
+
+			if (renderMode == 3)
+			{
+				usedColourPipe = &depthPartialColouredPipe;
+				usedTexturePipe = &depthPartialTexturedPipe;
+			}
+
+			if (renderMode == 4)
+			{
+				usedColourPipe = &prepassColouredPipe;
+				usedTexturePipe = &prepassTexturedPipe;
+			}
+		}
+		if (overdraw)
+			ImGui::Text("Fragments per pixel: blue = 1, red = 8 or more");
+		ImGui::End();
+
+		ImGui::Render();
+
+		//Rebuild this frame's sampler if the settings changed. The frame's
+		//previous use has completed, so the old sampler is no longer in use.
+		if (frame.samplerVersion != samplerVersion)
+		{
+			lut::SamplerDesc samplerDesc;
+			samplerDesc.filter = 0 == filterMode ? VK_FILTER_NEAREST : VK_FILTER_LINEAR;
+			samplerDesc.mipmapMode = 2 == filterMode ? VK_SAMPLER_MIPMAP_MODE_LINEAR : VK_SAMPLER_MIPMAP_MODE_NEAREST;
+			samplerDesc.maxAnisotropy = std::clamp(anisotropy, 1.f, limits.maxSamplerAnisotropy);
+			samplerDesc.mipLodBias = std::clamp(lodBias, -maxLodBias, maxLodBias);
+
+			frame.sampler = lut::create_sampler(window, samplerDesc);
+			update_sampler_descriptors(window, frame.samplerDescriptors, frame.sampler.handle);
+			frame.samplerVersion = samplerVersion;
+		}
+
+		//Write uniforms into this frame's slice of the ring. The previous
+		//user of the slice has completed, as the frame's fence was waited on.
+		uniformRing.begin_frame(std::uint32_t(frameIndex));
+		std::uint32_t const sceneUniformOffset = uniformRing.push(sceneUniforms);
+
+		std::uint32_t cullUniformOffset = 0;
+		if (gpuCulling)
+		{
+			glsl::CullUniform cullUniforms{};
+			cullUniforms.projCam = sceneUniforms.projCam;
+
+			Frustum const frustum = extract_frustum_planes(sceneUniforms.projCam);
+			for (std::size_t i = 0; i < 6; i++)
+				cullUniforms.planes[i] = frustum.planes[i];
+
+			cullUniforms.pyramidSize = glm::vec2(float(depthPyramid.width), float(depthPyramid.height));
+			cullUniforms.occludedSlot = std::uint32_t(2 * drawGroups.size());
+
+			cullUniformOffset = uniformRing.push(cullUniforms);
+		}
+
+		uniformRing.flush();
+
 		//Record commands
 		//Begin recording commands
 
@@ -735,17 +1534,109 @@ int main() try
 		begInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
 		begInfo.pInheritanceInfo = nullptr;
 
-		if (auto const res = vkBeginCommandBuffer(cbuffers[imageIndex], &begInfo); VK_SUCCESS != res)
+		if (auto const res = vkBeginCommandBuffer(frame.cbuffer, &begInfo); VK_SUCCESS != res)
 		{
 			throw lut::Error("Unable to begin recording command buffer\n" "vkBeginCommandBuffer() returned %s", lut::to_string(res).c_str());
 		}
 
-		//Update unifom buffer
-		lut::buffer_barrier(cbuffers[imageIndex], sceneUBO.buffer, VK_ACCESS_UNIFORM_READ_BIT, VK_ACCESS_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_VERTEX_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT);
+		//The frame's fence has been waited on, so the previous timestamps of
+		//this frame in flight can be read back without stalling
+		gpuProfiler.begin_frame(frame.cbuffer, std::uint32_t(frameIndex));
+
+		//Makes the culling results visible to the indirect draws, to later
+		//culling phases and to the host
+		auto const cull_barriers = [&] () {
+			lut::buffer_barrier(frame.cbuffer, frame.drawCommands.buffer,
+				VK_ACCESS_SHADER_WRITE_BIT,
+				VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+				VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+				VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT
+			);
+
+			lut::buffer_barrier(frame.cbuffer, frame.drawCounts.buffer,
+				VK_ACCESS_SHADER_WRITE_BIT,
+				VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_HOST_READ_BIT,
+				VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+				VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_HOST_BIT
+			);
+		};
+
+		auto const dispatch_cull = [&] (std::uint32_t aPhase, std::uint32_t aCommandBase, std::uint32_t aCountBase) {
+			glsl::CullPush cullPush{};
+			cullPush.phase = aPhase;
+			cullPush.drawCount = std::uint32_t(drawInfos.size());
+			cullPush.commandBase = aCommandBase;
+			cullPush.countBase = aCountBase;
+
+			vkCmdBindPipeline(frame.cbuffer, VK_PIPELINE_BIND_POINT_COMPUTE, cullPipe.handle);
+			vkCmdBindDescriptorSets(frame.cbuffer, VK_PIPELINE_BIND_POINT_COMPUTE, cullPipeLayout.handle, 0, 1, &frame.cullDescriptors, 1, &cullUniformOffset);
+			vkCmdPushConstants(frame.cbuffer, cullPipeLayout.handle, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(glsl::CullPush), &cullPush);
+			vkCmdDispatch(frame.cbuffer, (cullPush.drawCount + cfg::kCullWorkgroupSize - 1) / cfg::kCullWorkgroupSize, 1, 1);
+
+			cull_barriers();
+		};
+
+		//Cull all draws on the GPU and write the indirect commands. With
+		//occlusion culling, this is the early phase, which selects the draws
+		//that were visible last frame.
+		if (gpuCulling && !drawInfos.empty())
+		{
+			auto const cullScope = gpuProfiler.begin_scope(frame.cbuffer, "Culling");
+
+			//The visibility buffer is shared with the previous frame, whose
+			//late phase may still be writing to it
+			lut::buffer_barrier(frame.cbuffer, visibilityBuffer.buffer,
+				VK_ACCESS_SHADER_WRITE_BIT,
+				VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+				VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+				VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT
+			);
+
+			vkCmdFillBuffer(frame.cbuffer, frame.drawCounts.buffer, 0, VK_WHOLE_SIZE, 0);
+
+			lut::buffer_barrier(frame.cbuffer, frame.drawCounts.buffer,
+				VK_ACCESS_TRANSFER_WRITE_BIT,
+				VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+				VK_PIPELINE_STAGE_TRANSFER_BIT,
+				VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT
+			);
+
+			dispatch_cull(occlusion ? glsl::kCullPhaseEarly : glsl::kCullPhaseAll, 0, 0);
 
-		vkCmdUpdateBuffer(cbuffers[imageIndex], sceneUBO.buffer, 0, sizeof(glsl::SceneUniform), &sceneUniforms);
+			gpuProfiler.end_scope(frame.cbuffer, cullScope);
 
-		lut::buffer_barrier(cbuffers[imageIndex], sceneUBO.buffer, VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_UNIFORM_READ_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_VERTEX_SHADER_BIT);
+			frame.culledOnGpu = true;
+		}
+
+		//Reset the overdraw counts. The resolve of the previous frame may
+		//still be reading them.
+		if (overdraw)
+		{
+			VkImageSubresourceRange const colourRange{ VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+
+			lut::image_barrier(frame.cbuffer, overdrawImage.image,
+				VK_ACCESS_SHADER_READ_BIT,
+				VK_ACCESS_TRANSFER_WRITE_BIT,
+				VK_IMAGE_LAYOUT_UNDEFINED,
+				VK_IMAGE_LAYOUT_GENERAL,
+				VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+				VK_PIPELINE_STAGE_TRANSFER_BIT,
+				colourRange
+			);
+
+			VkClearColorValue const zero{};
+			vkCmdClearColorImage(frame.cbuffer, overdrawImage.image, VK_IMAGE_LAYOUT_GENERAL, &zero, 1, &colourRange);
+
+			lut::image_barrier(frame.cbuffer, overdrawImage.image,
+				VK_ACCESS_TRANSFER_WRITE_BIT,
+				VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+				VK_IMAGE_LAYOUT_GENERAL,
+				VK_IMAGE_LAYOUT_GENERAL,
+				VK_PIPELINE_STAGE_TRANSFER_BIT,
+				VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+				colourRange
+			);
+		}
 
 		//Begin render pass
 		//Clear to a dark gray background
@@ -757,175 +1648,410 @@ int main() try
 
 		clearValues[1].depthStencil.depth = 1.f;
 
+		//Without a late pass, the whole frame is drawn in a single pass
 		VkRenderPassBeginInfo passInfo{};
 		passInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-		passInfo.renderPass = renderPass.handle;
+		passInfo.renderPass = latePass ? renderPass.handle : singleRenderPass.handle;
 		passInfo.framebuffer = framebuffers[imageIndex].handle;
 		passInfo.renderArea.offset = VkOffset2D{ 0,0 };
 		passInfo.renderArea.extent = VkExtent2D{ window.swapchainExtent.width, window.swapchainExtent.height };
 		passInfo.clearValueCount = 2;
 		passInfo.pClearValues = clearValues;
 
-		vkCmdBeginRenderPass(cbuffers[imageIndex], &passInfo, VK_SUBPASS_CONTENTS_INLINE);
+		vkCmdBeginRenderPass(frame.cbuffer, &passInfo, VK_SUBPASS_CONTENTS_INLINE);
 
-		//Draw with the textured pipeline
-		vkCmdBindPipeline(cbuffers[imageIndex], VK_PIPELINE_BIND_POINT_GRAPHICS, usedTexturePipe->handle);
+		//Set viewport and scissor to the current swapchain size
+		VkViewport viewport{};
+		viewport.x = 0.f;
+		viewport.y = 0.f;
+		viewport.width = float(window.swapchainExtent.width);
+		viewport.height = float(window.swapchainExtent.height);
+		viewport.minDepth = 0.f;
+		viewport.maxDepth = 1.f;
 
-		//Bind the descriptors
-		vkCmdBindDescriptorSets(cbuffers[imageIndex], VK_PIPELINE_BIND_POINT_GRAPHICS, texturedPipeLayout.handle, 0, 1, &sceneDescriptors, 0, nullptr);
+		VkRect2D scissor{};
+		scissor.offset = VkOffset2D{ 0,0 };
+		scissor.extent = VkExtent2D{ window.swapchainExtent.width, window.swapchainExtent.height };
+
+		vkCmdSetViewport(frame.cbuffer, 0, 1, &viewport);
+		vkCmdSetScissor(frame.cbuffer, 0, 1, &scissor);
+
+		//Draw the scene. With GPU culling, the indirect commands and counts
+		//are read from the given ranges. The depth-only and overdraw passes
+		//only fetch positions, and use one pipeline for all meshes.
+		auto const draw_scene = [&] (std::uint32_t aCommandBase, std::uint32_t aCountBase, EScenePass aPass) {
+			bool const positionsOnly = EScenePass::shaded != aPass;
+
+			//Draw with the textured pipeline
+			if (EScenePass::depthOnly == aPass)
+				vkCmdBindPipeline(frame.cbuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, depthOnlyPipe.handle);
+			else if (EScenePass::overdraw == aPass)
+				vkCmdBindPipeline(frame.cbuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, overdrawPipe.handle);
+			else
+				vkCmdBindPipeline(frame.cbuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, usedTexturePipe->handle);
 
-		//Find out which vector of descriptor sets to use
-		std::vector<VkDescriptorSet>* desiredSet;
-		if (anisotropicUsed)
-			desiredSet = &anisotropicMeshDescSets;
-		else
-			desiredSet = &meshDescriptorSets;
-		
+			//Bind the descriptors
+			vkCmdBindDescriptorSets(frame.cbuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, texturedPipeLayout.handle, 0, 1, &sceneDescriptors, 1, &sceneUniformOffset);
 
+			if (EScenePass::overdraw == aPass)
+				vkCmdBindDescriptorSets(frame.cbuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, storagePipeLayout.handle, 1, 1, &overdrawDescriptors, 0, nullptr);
 
-		//Bind the textured meshes and draw
-		for (size_t i = 0; i < texturedMeshes.size(); i++)
-		{
-			vkCmdBindDescriptorSets(cbuffers[imageIndex], VK_PIPELINE_BIND_POINT_GRAPHICS, texturedPipeLayout.handle, 1, 1, &desiredSet->at(i), 0, nullptr);
+			//Bind the texture array and the frame's sampler once; draws
+			//select their texture with firstInstance. Without descriptor
+			//indexing, only the sampler is bound here and the texture sets
+			//are bound as the texture changes.
+			if (!positionsOnly && haveBindless)
+			{
+				VkDescriptorSet const textureSets[] = { textureDescriptors.front(), frame.samplerDescriptors };
+				vkCmdBindDescriptorSets(frame.cbuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, texturedPipeLayout.handle, 1, 2, textureSets, 0, nullptr);
+			}
+			else if (!positionsOnly)
+			{
+				vkCmdBindDescriptorSets(frame.cbuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, texturedPipeLayout.handle, 2, 1, &frame.samplerDescriptors, 0, nullptr);
+			}
 
-			VkBuffer meshBuffers[2] = { texturedMeshes.at(i).positions.buffer, texturedMeshes.at(i).texcoords.buffer };
-			VkDeviceSize meshOffsets[2] = {};
+			std::uint32_t boundTexture = ~std::uint32_t(0);
+			auto const bind_texture = [&] (std::uint32_t aTextureIndex) {
+				if (positionsOnly || haveBindless || aTextureIndex == boundTexture)
+					return;
 
-			vkCmdBindVertexBuffers(cbuffers[imageIndex], 0, 2, meshBuffers, meshOffsets);
+				vkCmdBindDescriptorSets(frame.cbuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, texturedPipeLayout.handle, 1, 1, &textureDescriptors[aTextureIndex], 0, nullptr);
+				boundTexture = aTextureIndex;
+			};
 
-			vkCmdDraw(cbuffers[imageIndex], texturedMeshes.at(i).vertexCount, 1, 0, 0);
+			//Bind the shared vertex buffers once
+			{
+				VkBuffer meshBuffers[2] = { meshArena.texPositions.buffer.buffer, meshArena.texcoords.buffer.buffer };
+				VkDeviceSize meshOffsets[2] = {};
 
-		}
+				vkCmdBindVertexBuffers(frame.cbuffer, 0, positionsOnly ? 1 : 2, meshBuffers, meshOffsets);
+			}
 
-		//Now bind the coloured meshes
-		vkCmdBindPipeline(cbuffers[imageIndex], VK_PIPELINE_BIND_POINT_GRAPHICS, usedColourPipe->handle);
+			//The index buffer holds both 16-bit and 32-bit indices, so it is only
+			//rebound when the index type changes
+			VkIndexType boundIndexType = VK_INDEX_TYPE_MAX_ENUM;
 
-		//Draw all coloured meshes
-		for (size_t i = 0; i < colouredMeshes.size(); i++)
-		{
-			VkBuffer meshBuffers[2] = { colouredMeshes.at(i).positions.buffer, colouredMeshes.at(i).colors.buffer };
-			VkDeviceSize meshOffsets[2] = {};
+			//Bind the textured meshes and draw
+			//With GPU culling, the draw count of each group is read from the
+			//count buffer, so the CPU cost only depends on the number of groups
+			constexpr VkDeviceSize indirectStride = sizeof(VkDrawIndexedIndirectCommand);
 
-			vkCmdBindVertexBuffers(cbuffers[imageIndex], 0, 2, meshBuffers, meshOffsets);
+			//All passes over the scene (pre-pass, early and late phase) are
+			//summed per mesh type
+			auto const texturedScope = gpuProfiler.begin_scope(frame.cbuffer, "Textured draws");
 
-			vkCmdDraw(cbuffers[imageIndex], colouredMeshes.at(i).vertexCount, 1, 0, 0);
-		}
+			if (gpuCulling)
+			{
+				for (std::size_t g = 0; g < drawGroups.size(); g++)
+				{
+					DrawGroup const& group = drawGroups[g];
+					if (!group.textured)
+						continue;
 
-		//End the render pass
-		vkCmdEndRenderPass(cbuffers[imageIndex]);
+					bind_texture(group.textureIndex);
 
-		//End command recording
-		if (auto const res = vkEndCommandBuffer(cbuffers[imageIndex]); VK_SUCCESS != res)
-		{
-			throw lut::Error("Unable to end recording command buffer\n" "vkEndCommandBuffer() returned %s", lut::to_string(res).c_str());
-		}
+					if (group.indexType != boundIndexType)
+					{
+						vkCmdBindIndexBuffer(frame.cbuffer, meshArena.indices.buffer.buffer, 0, group.indexType);
+						boundIndexType = group.indexType;
+					}
 
-		//Submit the recorded commands
-		submit_commands(window, cbuffers[imageIndex], cbfences[imageIndex].handle, imageAvailable.handle, imguiSemaphore.handle);
+					vkCmdDrawIndexedIndirectCount(frame.cbuffer, frame.drawCommands.buffer, (aCommandBase + group.base) * indirectStride, frame.drawCounts.buffer, (aCountBase + g) * sizeof(std::uint32_t), group.capacity, std::uint32_t(indirectStride));
+				}
+			}
+			else
+			{
+				for (size_t i = 0; i < texturedMeshes.size(); i++)
+				{
+					if (!texturedVisible[i])
+						continue;
 
-		//Preparation for second pass
-		//Wait for command buffer to be available
-		assert(std::size_t(imageIndex) < imguicbfences.size());
+					TexturedMesh const& mesh = texturedMeshes[i];
 
-		if (auto const res = vkWaitForFences(window.device, 1, &imguicbfences[imageIndex].handle, VK_TRUE, std::numeric_limits<std::uint64_t>::max()); VK_SUCCESS != res)
-		{
-			throw lut::Error("Unable to wait for command buffer fence %u\n" "vkWaitForFences() returned %s", imageIndex, lut::to_string(res).c_str());
-		}
+					bind_texture(mesh.textureIndex);
 
-		if (auto const res = vkResetFences(window.device, 1, &imguicbfences[imageIndex].handle); VK_SUCCESS != res)
-		{
-			throw lut::Error("Unable to reset command buffer fence %u\n" "vkResetFences() returned %s", imageIndex, lut::to_string(res).c_str());
-		}
+					if (mesh.indexType != boundIndexType)
+					{
+						vkCmdBindIndexBuffer(frame.cbuffer, meshArena.indices.buffer.buffer, 0, mesh.indexType);
+						boundIndexType = mesh.indexType;
+					}
 
-		//It is available, so begin recording
-		begInfo = {};
-		begInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-		begInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
-		begInfo.pInheritanceInfo = nullptr;
+					vkCmdDrawIndexed(frame.cbuffer, mesh.indexCount, 1, mesh.firstIndex, mesh.vertexOffset, mesh.textureIndex);
+				}
+			}
 
-		if (auto const res = vkBeginCommandBuffer(imguicbuffers[imageIndex], &begInfo); VK_SUCCESS != res)
-		{
-			throw lut::Error("Unable to begin recording command buffer\n" "vkBeginCommandBuffer() returned %s", lut::to_string(res).c_str());
-		}
+			gpuProfiler.end_scope(frame.cbuffer, texturedScope);
 
-		VkRenderPassBeginInfo imguiPassInfo = passInfo;
-		imguiPassInfo.framebuffer = imGuiframebuffers[imageIndex].handle;
-		imguiPassInfo.renderPass = imguiRenderPass.handle;
-		imguiPassInfo.clearValueCount = 1;
-		imguiPassInfo.pClearValues = &clearValues[0];
+			auto const colouredScope = gpuProfiler.begin_scope(frame.cbuffer, "Coloured draws");
+
+			//Now bind the coloured meshes. Position-only pipelines stay bound.
+			if (!positionsOnly)
+				vkCmdBindPipeline(frame.cbuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, usedColourPipe->handle);
 
-		vkCmdBeginRenderPass(imguicbuffers[imageIndex], &imguiPassInfo, VK_SUBPASS_CONTENTS_INLINE);
-		
-		//Setup new ImGui frame
-		ImGui_ImplVulkan_NewFrame();
-		ImGui_ImplGlfw_NewFrame();
-		ImGui::NewFrame();
-		ImGui::Begin("ImGui Window");
-		ImGui::Text("Edit the scene using these filters");
-		ImGui::Checkbox("Anisotropic Filtering", &anisotropicUsed);
-		if (ImGui::Combo("Render Mode", &renderMode, choices, numChoices))
-		{
-			if (renderMode == 0)
 			{
-				usedColourPipe = &colouredPipe;
-				usedTexturePipe = &texturedPipe;
+				VkBuffer meshBuffers[2] = { meshArena.colPositions.buffer.buffer, meshArena.colColors.buffer.buffer };
+				VkDeviceSize meshOffsets[2] = {};
+
+				vkCmdBindVertexBuffers(frame.cbuffer, 0, positionsOnly ? 1 : 2, meshBuffers, meshOffsets);
 			}
 
-			if (renderMode == 1)
+			//Draw all coloured meshes
+			if (gpuCulling)
 			{
-				usedColourPipe = &mipmapColouredPipe;
-				usedTexturePipe = &mipmapTexturedPipe;
+				for (std::size_t g = 0; g < drawGroups.size(); g++)
+				{
+					DrawGroup const& group = drawGroups[g];
+					if (group.textured)
+						continue;
+
+					if (group.indexType != boundIndexType)
+					{
+						vkCmdBindIndexBuffer(frame.cbuffer, meshArena.indices.buffer.buffer, 0, group.indexType);
+						boundIndexType = group.indexType;
+					}
+
+					vkCmdDrawIndexedIndirectCount(frame.cbuffer, frame.drawCommands.buffer, (aCommandBase + group.base) * indirectStride, frame.drawCounts.buffer, (aCountBase + g) * sizeof(std::uint32_t), group.capacity, std::uint32_t(indirectStride));
+				}
+			}
+			else
+			{
+				for (size_t i = 0; i < colouredMeshes.size(); i++)
+				{
+					if (!colouredVisible[i])
+						continue;
+
+					ColorizedMesh const& mesh = colouredMeshes[i];
+
+					if (mesh.indexType != boundIndexType)
+					{
+						vkCmdBindIndexBuffer(frame.cbuffer, meshArena.indices.buffer.buffer, 0, mesh.indexType);
+						boundIndexType = mesh.indexType;
+					}
+
+					vkCmdDrawIndexed(frame.cbuffer, mesh.indexCount, 1, mesh.firstIndex, mesh.vertexOffset, 0);
+				}
 			}
 
-			if (renderMode == 2)
+			gpuProfiler.end_scope(frame.cbuffer, colouredScope);
+		};
+
+		if (depthPrepass)
+			draw_scene(0, 0, EScenePass::depthOnly);
+		draw_scene(0, 0, scenePass);
+
+		if (latePass)
+		{
+			vkCmdEndRenderPass(frame.cbuffer);
+
+			//The late pass adds to the overdraw counts and resolves them
+			if (overdraw)
 			{
-				usedColourPipe = &depthColouredPipe;
-				usedTexturePipe = &depthTexturedPipe;
+				lut::image_barrier(frame.cbuffer, overdrawImage.image,
+					VK_ACCESS_SHADER_WRITE_BIT,
+					VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+					VK_IMAGE_LAYOUT_GENERAL,
+					VK_IMAGE_LAYOUT_GENERAL,
+					VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+					VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+					VkImageSubresourceRange{ VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 }
+				);
 			}
 
-			if (renderMode == 3)
+			//Build the depth pyramid from the early phase's depth buffer, and
+			//test the remaining draws against it
+			auto const occlusionScope = gpuProfiler.begin_scope(frame.cbuffer, "Depth pyramid + late culling");
+
+			//The previous contents are not needed
+			lut::image_barrier(frame.cbuffer, depthPyramid.image.image,
+				0,
+				VK_ACCESS_SHADER_WRITE_BIT,
+				VK_IMAGE_LAYOUT_UNDEFINED,
+				VK_IMAGE_LAYOUT_GENERAL,
+				VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+				VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+				VkImageSubresourceRange{ VK_IMAGE_ASPECT_COLOR_BIT, 0, depthPyramid.levels, 0, 1 }
+			);
+
+			vkCmdBindPipeline(frame.cbuffer, VK_PIPELINE_BIND_POINT_COMPUTE, depthReducePipe.handle);
+
+			for (std::uint32_t level = 0; level < depthPyramid.levels; level++)
 			{
-				usedColourPipe = &depthPartialColouredPipe;
-				usedTexturePipe = &depthPartialTexturedPipe;
+				std::uint32_t const width = std::max(1u, depthPyramid.width >> level);
+				std::uint32_t const height = std::max(1u, depthPyramid.height >> level);
+
+				vkCmdBindDescriptorSets(frame.cbuffer, VK_PIPELINE_BIND_POINT_COMPUTE, depthReducePipeLayout.handle, 0, 1, &depthPyramid.reduceSets[level], 0, nullptr);
+				vkCmdDispatch(frame.cbuffer, (width + cfg::kDepthReduceWorkgroupSize - 1) / cfg::kDepthReduceWorkgroupSize, (height + cfg::kDepthReduceWorkgroupSize - 1) / cfg::kDepthReduceWorkgroupSize, 1);
+
+				lut::image_barrier(frame.cbuffer, depthPyramid.image.image,
+					VK_ACCESS_SHADER_WRITE_BIT,
+					VK_ACCESS_SHADER_READ_BIT,
+					VK_IMAGE_LAYOUT_GENERAL,
+					VK_IMAGE_LAYOUT_GENERAL,
+					VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+					VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+					VkImageSubresourceRange{ VK_IMAGE_ASPECT_COLOR_BIT, level, 1, 0, 1 }
+				);
 			}
+
+			dispatch_cull(glsl::kCullPhaseLate, std::uint32_t(drawInfos.size()), std::uint32_t(drawGroups.size()));
+
+			gpuProfiler.end_scope(frame.cbuffer, occlusionScope);
+
+			//The late pass draws the draws that were disoccluded this frame, and
+			//the overdraw resolve and ImGui overlay below
+			VkRenderPassBeginInfo latePassInfo{};
+			latePassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+			latePassInfo.renderPass = lateRenderPass.handle;
+			latePassInfo.framebuffer = framebuffers[imageIndex].handle;
+			latePassInfo.renderArea = passInfo.renderArea;
+
+			vkCmdBeginRenderPass(frame.cbuffer, &latePassInfo, VK_SUBPASS_CONTENTS_INLINE);
+
+			if (depthPrepass)
+				draw_scene(std::uint32_t(drawInfos.size()), std::uint32_t(drawGroups.size()), EScenePass::depthOnly);
+			draw_scene(std::uint32_t(drawInfos.size()), std::uint32_t(drawGroups.size()), scenePass);
 		}
-		ImGui::End();
 
+		//Replace the scene with the overdraw heat map. The counts written
+		//earlier in this subpass are made visible by its self-dependency.
+		if (overdraw)
+		{
+			VkMemoryBarrier countBarrier{};
+			countBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+			countBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+			countBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+			vkCmdPipelineBarrier(frame.cbuffer,
+				VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+				VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+				VK_DEPENDENCY_BY_REGION_BIT,
+				1, &countBarrier,
+				0, nullptr,
+				0, nullptr
+			);
+
+			vkCmdBindPipeline(frame.cbuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, overdrawResolvePipe.handle);
+			vkCmdBindDescriptorSets(frame.cbuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, storagePipeLayout.handle, 1, 1, &overdrawDescriptors, 0, nullptr);
+			vkCmdDraw(frame.cbuffer, 3, 1, 0, 0);
+		}
 
-		ImGui::Render();
-		ImGui_ImplVulkan_RenderDrawData(ImGui::GetDrawData(), imguicbuffers[imageIndex]);
+		//Draw the ImGui overlay on top of the scene. Headless, the images
+		//only show the scene.
+		if (!options.headless)
+		{
+			auto const imguiScope = gpuProfiler.begin_scope(frame.cbuffer, "ImGui");
+			ImGui_ImplVulkan_RenderDrawData(ImGui::GetDrawData(), frame.cbuffer);
+			gpuProfiler.end_scope(frame.cbuffer, imguiScope);
+		}
 
-		vkCmdEndRenderPass(imguicbuffers[imageIndex]);
+		//End the render pass
+		vkCmdEndRenderPass(frame.cbuffer);
+
+		gpuProfiler.end_frame(frame.cbuffer);
+
+		//Read back the image, outside of the timed range. The last render
+		//pass leaves offscreen images in TRANSFER_SRC_OPTIMAL.
+		if (options.headless && writes_png(frameNumber))
+		{
+			VkBufferImageCopy copy{};
+			copy.imageSubresource = VkImageSubresourceLayers{ VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+			copy.imageExtent = VkExtent3D{ window.swapchainExtent.width, window.swapchainExtent.height, 1 };
+
+			vkCmdCopyImageToBuffer(frame.cbuffer, window.swapImages[imageIndex], VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, frame.readback.buffer, 1, &copy);
+
+			lut::buffer_barrier(frame.cbuffer, frame.readback.buffer,
+				VK_ACCESS_TRANSFER_WRITE_BIT,
+				VK_ACCESS_HOST_READ_BIT,
+				VK_PIPELINE_STAGE_TRANSFER_BIT,
+				VK_PIPELINE_STAGE_HOST_BIT
+			);
+		}
 
 		//End command recording
-		if (auto const res = vkEndCommandBuffer(imguicbuffers[imageIndex]); VK_SUCCESS != res)
+		if (auto const res = vkEndCommandBuffer(frame.cbuffer); VK_SUCCESS != res)
 		{
 			throw lut::Error("Unable to end recording command buffer\n" "vkEndCommandBuffer() returned %s", lut::to_string(res).c_str());
 		}
 
-		//Submit commands
-		submit_commands(window, imguicbuffers[imageIndex], imguicbfences[imageIndex].handle, imguiSemaphore.handle, renderFinished.handle);
+		//Submit the recorded commands. Headless, there is nothing to wait
+		//for or to present.
+		if (options.headless)
+		{
+			submit_commands(window, frame.cbuffer, frame.inFlight.handle, VK_NULL_HANDLE, VK_NULL_HANDLE);
+
+			frame.benchmarkPending = true;
+			frame.benchmarkFrame = std::uint32_t(frameNumber);
+			frame.frameMs = dt * 1000.f;
+			frame.cpuMs = std::chrono::duration<float, std::milli>(Clock_::now() - cpuClock).count();
+		}
+		else
+		{
+			submit_commands(window, frame.cbuffer, frame.inFlight.handle, frame.imageAvailable.handle, renderFinished[imageIndex].handle);
+
+			present_results(window.presentQueue, window.swapchain, imageIndex, renderFinished[imageIndex].handle, recreateSwapchain);
+		}
+
+		//Move on to the next frame in flight without waiting for this one
+		frameIndex = (frameIndex + 1) % frames.size();
+	}
+
+	//Write out the frames that are still in flight, oldest first
+	if (options.headless)
+	{
+		vkDeviceWaitIdle(window.device);
+
+		for (std::size_t i = 0; i < frames.size(); ++i)
+		{
+			std::size_t const index = (frameIndex + i) % frames.size();
+			finish_benchmark_frame(frames[index], std::uint32_t(index));
+		}
+
+		if (csv)
+			std::fprintf(stderr, "Wrote timings of %llu frames to '%s'\n", (unsigned long long)totalFrameCount, options.csvPath.c_str());
 
-		present_results(window.presentQueue, window.swapchain, imageIndex, renderFinished.handle, recreateSwapchain);
+		//Throughput over the whole run, including the frames that were
+		//still in flight, for comparing e.g. --frames-in-flight settings
+		double const loopMs = std::chrono::duration<double, std::milli>(Clock_::now() - loopClock).count();
+		if (totalFrameCount > 0)
+		{
+			std::fprintf(stderr, "Rendered %llu frames in %.1f ms with %zu frames in flight: %.3f ms per frame (%.1f FPS)\n",
+				(unsigned long long)totalFrameCount, loopMs, framesInFlight, loopMs / double(totalFrameCount), 1000.0 * double(totalFrameCount) / loopMs);
+		}
 
-		//Ensure the command buffers have finished (throws an error if not)
-		if (auto const res = vkWaitForFences(window.device, 1, &imguicbfences[imageIndex].handle, VK_TRUE, std::numeric_limits<std::uint64_t>::max()); VK_SUCCESS != res)
+		if (benchmarkCulledFrames > 0)
 		{
-			throw lut::Error("Unable to wait for command buffer fence %u\n" "vkWaitForFences() returned %s", imageIndex, lut::to_string(res).c_str());
+			std::fprintf(stderr, "GPU culling: %zu draws, on average %.1f drawn and %.1f rejected by occlusion culling per frame\n",
+				totalMeshCount, double(benchmarkDrawn) / benchmarkCulledFrames, double(benchmarkOccluded) / benchmarkCulledFrames);
 		}
+	}
+
+	if (!options.recordPath.empty())
+	{
+		if (write_camera_path(options.recordPath.c_str(), cameraPath))
+			std::fprintf(stderr, "Recorded %zu samples (%.2f s) to '%s'\n", cameraPath.samples.size(), camera_path_duration(cameraPath), options.recordPath.c_str());
+		else
+			std::fprintf(stderr, "Unable to write camera path '%s'\n", options.recordPath.c_str());
+	}
 
+	if (totalFrameCount > 0)
+	{
+		std::fprintf(stderr, "Average frame time: %.3f ms over %llu frames (%zu frames in flight)\n", 1000.0 * totalFrameTime / totalFrameCount, (unsigned long long)totalFrameCount, framesInFlight);
 	}
 
 
 	//End ImGui
 	ImGui_ImplVulkan_Shutdown();
-	ImGui_ImplGlfw_Shutdown();
+	if (!options.headless)
+		ImGui_ImplGlfw_Shutdown();
 	ImGui::DestroyContext();
 
 	// Cleanup takes place automatically in the destructors, but we still need
 	// to ensure that all Vulkan commands have finished before that.
 
 	vkDeviceWaitIdle(window.device);
+
+	//Store the pipeline cache for the next run
+	lut::save_pipeline_cache(window, pipelineCache.handle, cfg::kPipelineCachePath);
 	
 	return 0;
 }
@@ -949,6 +2075,9 @@ namespace
 		auto state = static_cast<UserState*>(glfwGetWindowUserPointer(aWindow));
 		assert(state);
 
+		if (state->replaying)
+			return;
+
 		bool const isReleased = (GLFW_RELEASE == aAction);
 
 		switch (aKey)
@@ -992,6 +2121,9 @@ namespace
 		auto state = static_cast<UserState*>(glfwGetWindowUserPointer(aWin));
 		assert(state);
 
+		if (state->replaying)
+			return;
+
 		if (GLFW_MOUSE_BUTTON_RIGHT == aBut && GLFW_PRESS == aAct)
 		{
 			auto& flag = state->inputMap[std::size_t(EInputState::mousing)];
@@ -1009,6 +2141,9 @@ namespace
 		auto state = static_cast<UserState*>(glfwGetWindowUserPointer(aWin));
 		assert(state);
 
+		if (state->replaying)
+			return;
+
 		state->mouseX = float(aX);
 		state->mouseY = float(aY);
 	}
@@ -1062,17 +2197,123 @@ namespace
 		if (aState.inputMap[std::size_t(EInputState::sink)])
 			cam = cam * glm::translate(glm::vec3(0.f, -move, 0.f));
 	}
-}
 
-namespace
-{
-	void update_scene_uniforms(glsl::SceneUniform& aSceneUniforms, std::uint32_t aFramebufferWidth, std::uint32_t aFramebufferHeight, UserState const& aState)
+	std::uint32_t pack_inputs(UserState const& aState)
 	{
-		float const aspect = aFramebufferWidth / float(aFramebufferHeight);
+		static_assert(std::size_t(EInputState::max) <= 32, "EInputState does not fit into 32 bits");
 
-		aSceneUniforms.projection = glm::perspectiveRH_ZO(
-			lut::Radians(cfg::kCameraFov).value(),
-			aspect,
+		std::uint32_t ret = 0;
+		for (std::size_t i = 0; i < std::size_t(EInputState::max); ++i)
+		{
+			if (aState.inputMap[i])
+				ret |= 1u << i;
+		}
+
+		return ret;
+	}
+
+	void unpack_inputs(UserState& aState, std::uint32_t aInputs)
+	{
+		for (std::size_t i = 0; i < std::size_t(EInputState::max); ++i)
+			aState.inputMap[i] = 0 != (aInputs & (1u << i));
+	}
+
+	glm::mat4 benchmark_camera(std::uint32_t aFrame, std::uint32_t aFrameCount)
+	{
+		//One loop around the atrium, looking at its centre. The height
+		//changes twice per loop, so that both floors come into view.
+		float const angle = 2.f * glm::pi<float>() * (aFrame / float(aFrameCount));
+
+		glm::vec3 const eye(10.f * std::cos(angle), 4.f + 2.f * std::sin(2.f * angle), 3.f * std::sin(angle));
+		glm::vec3 const target(0.f, 4.f, 0.f);
+
+		return glm::inverse(glm::lookAt(eye, target, glm::vec3(0.f, 1.f, 0.f)));
+	}
+}
+
+namespace
+{
+	Options parse_options(int aArgc, char* aArgv[])
+	{
+		Options ret;
+
+		auto const value = [&] (int& aIndex) {
+			if (aIndex + 1 >= aArgc)
+				throw lut::Error("Missing value for option '%s'", aArgv[aIndex]);
+
+			return aArgv[++aIndex];
+		};
+
+		auto const to_uint = [] (char const* aOption, char const* aValue) {
+			char* end = nullptr;
+			unsigned long const number = std::strtoul(aValue, &end, 10);
+			if (end == aValue || '\0' != *end || 0 == number || number > std::numeric_limits<std::uint32_t>::max())
+				throw lut::Error("Invalid value '%s' for option '%s'", aValue, aOption);
+
+			return std::uint32_t(number);
+		};
+
+		for (int i = 1; i < aArgc; ++i)
+		{
+			char const* const arg = aArgv[i];
+
+			if (0 == std::strcmp(arg, "--headless"))
+				ret.headless = true;
+			else if (0 == std::strcmp(arg, "--frames"))
+				ret.frames = to_uint(arg, value(i));
+			else if (0 == std::strcmp(arg, "--size"))
+			{
+				char const* const size = value(i);
+
+				unsigned width = 0, height = 0;
+				char tail = 0;
+				if (2 != std::sscanf(size, "%ux%u%c", &width, &height, &tail) || 0 == width || 0 == height)
+					throw lut::Error("Invalid value '%s' for option '%s', expected WIDTHxHEIGHT", size, arg);
+
+				ret.extent = VkExtent2D{ width, height };
+			}
+			else if (0 == std::strcmp(arg, "--csv"))
+				ret.csvPath = value(i);
+			else if (0 == std::strcmp(arg, "--png-dir"))
+				ret.pngDir = value(i);
+			else if (0 == std::strcmp(arg, "--png-every"))
+				ret.pngEvery = to_uint(arg, value(i));
+			else if (0 == std::strcmp(arg, "--record"))
+				ret.recordPath = value(i);
+			else if (0 == std::strcmp(arg, "--replay"))
+				ret.replayPath = value(i);
+			else if (0 == std::strcmp(arg, "--frames-in-flight"))
+			{
+				ret.framesInFlight = to_uint(arg, value(i));
+				if (ret.framesInFlight > cfg::kMaxFramesInFlight)
+					throw lut::Error("Invalid value %u for option '%s', at most %u frames may be in flight", ret.framesInFlight, arg, cfg::kMaxFramesInFlight);
+			}
+			else
+			{
+				throw lut::Error("Unknown option '%s'\n"
+					"Usage: %s [--frames-in-flight N] [--record FILE | --replay FILE] [--headless [--frames N] [--size WIDTHxHEIGHT] [--csv FILE] [--png-dir EXISTING_DIR] [--png-every N]]", arg, aArgv[0]);
+			}
+		}
+
+		if (!ret.headless && (!ret.csvPath.empty() || !ret.pngDir.empty()))
+			throw lut::Error("--csv and --png-dir require --headless");
+
+		if (!ret.recordPath.empty() && (ret.headless || !ret.replayPath.empty()))
+			throw lut::Error("--record requires interactive input, and cannot be combined with --headless or --replay");
+
+		return ret;
+	}
+}
+
+namespace
+{
+	void update_scene_uniforms(glsl::SceneUniform& aSceneUniforms, std::uint32_t aFramebufferWidth, std::uint32_t aFramebufferHeight, UserState const& aState)
+	{
+		float const aspect = aFramebufferWidth / float(aFramebufferHeight);
+
+		aSceneUniforms.projection = glm::perspectiveRH_ZO(
+			lut::Radians(cfg::kCameraFov).value(),
+			aspect,
 			cfg::kCameraNear,
 			cfg::kCameraFar
 		);
@@ -1086,22 +2327,29 @@ namespace
 
 namespace
 {
-	lut::RenderPass create_render_pass(lut::VulkanWindow const& aWindow)
+	lut::RenderPass create_render_pass(lut::VulkanWindow const& aWindow, bool aLast)
 	{
+		//aLast: no late pass follows, so the image is left ready for
+		//presentation (or readback, offscreen) and depth is not kept
+		bool const offscreen = VK_NULL_HANDLE == aWindow.swapchain;
+
 		VkAttachmentDescription attachments[2]{};
 		attachments[0].format = aWindow.swapchainFormat;
 		attachments[0].samples = VK_SAMPLE_COUNT_1_BIT;
 		attachments[0].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
 		attachments[0].storeOp = VK_ATTACHMENT_STORE_OP_STORE;
 		attachments[0].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-		attachments[0].finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+		attachments[0].finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL; //Continued by the late pass
+		if (aLast)
+			attachments[0].finalLayout = offscreen ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
 
+		//Depth is kept for the depth pyramid and the late pass
 		attachments[1].format = cfg::kDepthFormat;
 		attachments[1].samples = VK_SAMPLE_COUNT_1_BIT;
 		attachments[1].loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-		attachments[1].storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		attachments[1].storeOp = aLast ? VK_ATTACHMENT_STORE_OP_DONT_CARE : VK_ATTACHMENT_STORE_OP_STORE;
 		attachments[1].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-		attachments[1].finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+		attachments[1].finalLayout = aLast ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL : VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
 
 		//Declare the single subpass
 		VkAttachmentReference subpassAttachments[1]{};
@@ -1119,7 +2367,7 @@ namespace
 		subpasses[0].pDepthStencilAttachment = &depthAttachment;
 
 		//Introduce a dependency
-		VkSubpassDependency deps[2]{};
+		VkSubpassDependency deps[5]{};
 		deps[0].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
 		deps[0].srcSubpass = VK_SUBPASS_EXTERNAL;
 		deps[0].srcAccessMask = 0;
@@ -1128,14 +2376,56 @@ namespace
 		deps[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
 		deps[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
 
-		deps[1].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+		//The previous frame's depth pyramid reads the depth buffer as well
 		deps[1].srcSubpass = VK_SUBPASS_EXTERNAL;
 		deps[1].srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
-		deps[1].srcStageMask = VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+		deps[1].srcStageMask = VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
 		deps[1].dstSubpass = 0;
 		deps[1].dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT;
 		deps[1].dstStageMask = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
 
+		//The overdraw resolve reads the counts written by earlier draws
+		deps[2].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+		deps[2].srcSubpass = 0;
+		deps[2].srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		deps[2].srcStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+		deps[2].dstSubpass = 0;
+		deps[2].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		deps[2].dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+
+		std::uint32_t depCount = 3;
+
+		if (!aLast)
+		{
+			//Depth is read by the depth pyramid reduction and the late pass
+			deps[depCount].srcSubpass = 0;
+			deps[depCount].srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+			deps[depCount].srcStageMask = VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+			deps[depCount].dstSubpass = VK_SUBPASS_EXTERNAL;
+			deps[depCount].dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+			deps[depCount].dstStageMask = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+			++depCount;
+
+			deps[depCount].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+			deps[depCount].srcSubpass = 0;
+			deps[depCount].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+			deps[depCount].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+			deps[depCount].dstSubpass = VK_SUBPASS_EXTERNAL;
+			deps[depCount].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+			deps[depCount].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+			++depCount;
+		}
+		else if (offscreen)
+		{
+			//Offscreen images are copied to the host after the pass
+			deps[depCount].srcSubpass = 0;
+			deps[depCount].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+			deps[depCount].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+			deps[depCount].dstSubpass = VK_SUBPASS_EXTERNAL;
+			deps[depCount].dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+			deps[depCount].dstStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT;
+			++depCount;
+		}
 
 		//With declarations in place, we can now create the render pass
 		VkRenderPassCreateInfo passInfo{};
@@ -1144,7 +2434,7 @@ namespace
 		passInfo.pAttachments = attachments;
 		passInfo.subpassCount = 1;
 		passInfo.pSubpasses = subpasses;
-		passInfo.dependencyCount = 2;
+		passInfo.dependencyCount = depCount;
 		passInfo.pDependencies = deps;
 
 		VkRenderPass rpass = VK_NULL_HANDLE;
@@ -1155,57 +2445,89 @@ namespace
 
 		return lut::RenderPass(aWindow.device, rpass);
 	}
-	
-	lut::RenderPass create_imgui_render_pass(lut::VulkanWindow const& aWindow)
+
+	lut::RenderPass create_late_render_pass(lut::VulkanWindow const& aWindow)
 	{
-		VkAttachmentDescription attachments[1]{};
+		//Continues the main pass. Must stay compatible with it (same formats
+		//and subpass), as both use the same framebuffers and pipelines.
+		VkAttachmentDescription attachments[2]{};
 		attachments[0].format = aWindow.swapchainFormat;
 		attachments[0].samples = VK_SAMPLE_COUNT_1_BIT;
 		attachments[0].loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
 		attachments[0].storeOp = VK_ATTACHMENT_STORE_OP_STORE;
 		attachments[0].initialLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-		attachments[0].finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+		attachments[0].finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR; //The ImGui overlay is drawn in this pass too
+
+		//Offscreen images are read back instead of presented
+		bool const offscreen = VK_NULL_HANDLE == aWindow.swapchain;
+		if (offscreen)
+			attachments[0].finalLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+
+		attachments[1].format = cfg::kDepthFormat;
+		attachments[1].samples = VK_SAMPLE_COUNT_1_BIT;
+		attachments[1].loadOp = VK_ATTACHMENT_LOAD_OP_LOAD;
+		attachments[1].storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		attachments[1].initialLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+		attachments[1].finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
+
+		VkAttachmentReference subpassAttachments[1]{};
+		subpassAttachments[0].attachment = 0;
+		subpassAttachments[0].layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
 
-		VkAttachmentReference colourAttachment = {};
-		colourAttachment.attachment = 0;
-		colourAttachment.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+		VkAttachmentReference depthAttachment{};
+		depthAttachment.attachment = 1;
+		depthAttachment.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
 
 		VkSubpassDescription subpasses[1]{};
 		subpasses[0].pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
 		subpasses[0].colorAttachmentCount = 1;
-		subpasses[0].pColorAttachments = &colourAttachment;
+		subpasses[0].pColorAttachments = subpassAttachments;
+		subpasses[0].pDepthStencilAttachment = &depthAttachment;
 
-		//Introduce a dependency
-		VkSubpassDependency deps = {};
-		deps.srcSubpass = VK_SUBPASS_EXTERNAL;
-		deps.srcAccessMask = 0;
-		deps.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-		deps.dstSubpass = 0;
-		deps.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
-		deps.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+		//Depth must not be written before the depth pyramid has been built
+		VkSubpassDependency deps[3]{};
+		deps[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+		deps[0].srcAccessMask = 0;
+		deps[0].srcStageMask = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+		deps[0].dstSubpass = 0;
+		deps[0].dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT;
+		deps[0].dstStageMask = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
 
+		//The overdraw resolve reads the counts written by earlier draws
+		deps[1].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
+		deps[1].srcSubpass = 0;
+		deps[1].srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		deps[1].srcStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+		deps[1].dstSubpass = 0;
+		deps[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+		deps[1].dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
 
+		//Offscreen images are copied to the host after the pass
+		deps[2].srcSubpass = 0;
+		deps[2].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+		deps[2].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT;
+		deps[2].dstSubpass = VK_SUBPASS_EXTERNAL;
+		deps[2].dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+		deps[2].dstStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT;
 
-		//With declarations in place, we can now create the render pass
 		VkRenderPassCreateInfo passInfo{};
 		passInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
-		passInfo.attachmentCount = 1;
+		passInfo.attachmentCount = 2;
 		passInfo.pAttachments = attachments;
 		passInfo.subpassCount = 1;
 		passInfo.pSubpasses = subpasses;
-		passInfo.dependencyCount = 1;
-		passInfo.pDependencies = &deps;
+		passInfo.dependencyCount = offscreen ? 3 : 2;
+		passInfo.pDependencies = deps;
 
 		VkRenderPass rpass = VK_NULL_HANDLE;
 		if (auto const res = vkCreateRenderPass(aWindow.device, &passInfo, nullptr, &rpass); VK_SUCCESS != res)
 		{
-			throw lut::Error("Unable to create render pass\n" "vkCreateRenderPass() returned %s", lut::to_string(res).c_str());
+			throw lut::Error("Unable to create late render pass\n" "vkCreateRenderPass() returned %s", lut::to_string(res).c_str());
 		}
 
 		return lut::RenderPass(aWindow.device, rpass);
 	}
 	
-
 	lut::PipelineLayout create_coloured_pipeline_layout(lut::VulkanContext const& aContext, VkDescriptorSetLayout aSceneLayout)
 	{
 		VkDescriptorSetLayout layouts[] =
@@ -1229,12 +2551,13 @@ namespace
 		return lut::PipelineLayout(aContext.device, layout);
 	}
 
-	lut::PipelineLayout create_textured_pipeline_layout(lut::VulkanContext const& aContext, VkDescriptorSetLayout aSceneLayout, VkDescriptorSetLayout aObjectLayout)
+	lut::PipelineLayout create_textured_pipeline_layout(lut::VulkanContext const& aContext, VkDescriptorSetLayout aSceneLayout, VkDescriptorSetLayout aObjectLayout, VkDescriptorSetLayout aSamplerLayout)
 	{
 		VkDescriptorSetLayout layouts[] =
 		{
 			aSceneLayout,
-			aObjectLayout //Order must match the set = N in the shaders - aSceneLayout = set 0
+			aObjectLayout, //Order must match the set = N in the shaders - aSceneLayout = set 0
+			aSamplerLayout
 		};
 
 		VkPipelineLayoutCreateInfo layoutInfo{};
@@ -1253,11 +2576,65 @@ namespace
 		return lut::PipelineLayout(aContext.device, layout);
 	}
 
-	/*lut::PipelineLayout create_storage_pipeline_layout(lut::VulkanContext const& aContext, VkDescriptorSetLayout aStorageLayout)
+	lut::PipelineLayout create_cull_pipeline_layout(lut::VulkanContext const& aContext, VkDescriptorSetLayout aCullLayout)
+	{
+		VkDescriptorSetLayout layouts[] =
+		{
+			aCullLayout
+		};
+
+		//Frustum planes and draw count
+		VkPushConstantRange pushRange{};
+		pushRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+		pushRange.offset = 0;
+		pushRange.size = sizeof(glsl::CullPush);
+
+		VkPipelineLayoutCreateInfo layoutInfo{};
+		layoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+		layoutInfo.setLayoutCount = sizeof(layouts) / sizeof(layouts[0]);
+		layoutInfo.pSetLayouts = layouts;
+		layoutInfo.pushConstantRangeCount = 1;
+		layoutInfo.pPushConstantRanges = &pushRange;
+
+		VkPipelineLayout layout = VK_NULL_HANDLE;
+		if (auto const res = vkCreatePipelineLayout(aContext.device, &layoutInfo, nullptr, &layout); VK_SUCCESS != res)
+		{
+			throw lut::Error("Unable to create cull pipeline layout\n" "vkCreatePipelineLayout returned %s", lut::to_string(res).c_str());
+		}
+
+		return lut::PipelineLayout(aContext.device, layout);
+	}
+
+	lut::PipelineLayout create_depth_reduce_pipeline_layout(lut::VulkanContext const& aContext, VkDescriptorSetLayout aReduceLayout)
 	{
 		VkDescriptorSetLayout layouts[] =
 		{
-			aStorageLayout
+			aReduceLayout
+		};
+
+		VkPipelineLayoutCreateInfo layoutInfo{};
+		layoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+		layoutInfo.setLayoutCount = sizeof(layouts) / sizeof(layouts[0]);
+		layoutInfo.pSetLayouts = layouts;
+		layoutInfo.pushConstantRangeCount = 0;
+		layoutInfo.pPushConstantRanges = nullptr;
+
+		VkPipelineLayout layout = VK_NULL_HANDLE;
+		if (auto const res = vkCreatePipelineLayout(aContext.device, &layoutInfo, nullptr, &layout); VK_SUCCESS != res)
+		{
+			throw lut::Error("Unable to create depth reduction pipeline layout\n" "vkCreatePipelineLayout returned %s", lut::to_string(res).c_str());
+		}
+
+		return lut::PipelineLayout(aContext.device, layout);
+	}
+
+	lut::PipelineLayout create_storage_pipeline_layout(lut::VulkanContext const& aContext, VkDescriptorSetLayout aSceneLayout, VkDescriptorSetLayout aStorageLayout)
+	{
+		VkDescriptorSetLayout layouts[] =
+		{
+			//Order must match the set = N in the shaders
+			aSceneLayout, //Set 0
+			aStorageLayout //Set 1
 		};
 
 		VkPipelineLayoutCreateInfo layoutInfo{};
@@ -1274,25 +2651,22 @@ namespace
 		}
 
 		return lut::PipelineLayout(aContext.device, layout);
-	}*/
+	}
 
 
-	lut::Pipeline create_coloured_pipeline(lut::VulkanWindow const& aWindow, VkRenderPass aRenderPass, VkPipelineLayout aPipelineLayout, const char* vertShaderPath, const char* fragShaderPath)
+	lut::Pipeline create_coloured_pipeline(lut::VulkanWindow const& aWindow, VkRenderPass aRenderPass, VkPipelineLayout aPipelineLayout, VkPipelineCache aPipelineCache, VkShaderModule aVert, VkShaderModule aFrag, bool aDepthEqual)
 	{
-		//Load shader modules
-		lut::ShaderModule vert = lut::load_shader_module(aWindow, vertShaderPath);
-		lut::ShaderModule frag = lut::load_shader_module(aWindow, fragShaderPath);
 
 		//Define shader stages in the pipeline
 		VkPipelineShaderStageCreateInfo stages[2]{};
 		stages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
 		stages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
-		stages[0].module = vert.handle;
+		stages[0].module = aVert;
 		stages[0].pName = "main";
 
 		stages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
 		stages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
-		stages[1].module = frag.handle;
+		stages[1].module = aFrag;
 		stages[1].pName = "main";
 
 		//Define vertex input attributes
@@ -1330,25 +2704,21 @@ namespace
 		assemblyInfo.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
 		assemblyInfo.primitiveRestartEnable = VK_FALSE;
 
-		//Define viewport and scissor regions
-		VkViewport viewport{};
-		viewport.x = 0.f;
-		viewport.y = 0.f;
-		viewport.width = float(aWindow.swapchainExtent.width);
-		viewport.height = float(aWindow.swapchainExtent.height);
-		viewport.minDepth = 0.f;
-		viewport.maxDepth = 1.f;
-
-		VkRect2D scissor{};
-		scissor.offset = VkOffset2D{ 0,0 };
-		scissor.extent = VkExtent2D{ aWindow.swapchainExtent.width, aWindow.swapchainExtent.height };
-
+		//Viewport and scissor regions are dynamic state, set when recording
+		//commands. This way, the pipeline does not depend on the window size.
 		VkPipelineViewportStateCreateInfo viewportInfo{};
 		viewportInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
 		viewportInfo.viewportCount = 1;
-		viewportInfo.pViewports = &viewport;
+		viewportInfo.pViewports = nullptr;
 		viewportInfo.scissorCount = 1;
-		viewportInfo.pScissors = &scissor;
+		viewportInfo.pScissors = nullptr;
+
+		VkDynamicState const dynamicStates[] = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
+
+		VkPipelineDynamicStateCreateInfo dynamicInfo{};
+		dynamicInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+		dynamicInfo.dynamicStateCount = 2;
+		dynamicInfo.pDynamicStates = dynamicStates;
 
 		//Define rasterisation options
 		VkPipelineRasterizationStateCreateInfo rasterInfo{};
@@ -1377,12 +2747,13 @@ namespace
 		blendInfo.attachmentCount = 1;
 		blendInfo.pAttachments = blendStates;
 
-		//Define depth stencil state
+		//Define depth stencil state. After a depth pre-pass, only the
+		//fragments that are visible pass the depth test.
 		VkPipelineDepthStencilStateCreateInfo depthInfo{};
 		depthInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
 		depthInfo.depthTestEnable = VK_TRUE;
-		depthInfo.depthWriteEnable = VK_TRUE;
-		depthInfo.depthCompareOp = VK_COMPARE_OP_LESS_OR_EQUAL;
+		depthInfo.depthWriteEnable = aDepthEqual ? VK_FALSE : VK_TRUE;
+		depthInfo.depthCompareOp = aDepthEqual ? VK_COMPARE_OP_EQUAL : VK_COMPARE_OP_LESS_OR_EQUAL;
 		depthInfo.minDepthBounds = 0.f;
 		depthInfo.maxDepthBounds = 1.f;
 
@@ -1400,13 +2771,13 @@ namespace
 		pipeInfo.pMultisampleState = &samplingInfo;
 		pipeInfo.pDepthStencilState = &depthInfo;
 		pipeInfo.pColorBlendState = &blendInfo;
-		pipeInfo.pDynamicState = nullptr;
+		pipeInfo.pDynamicState = &dynamicInfo;
 		pipeInfo.layout = aPipelineLayout;
 		pipeInfo.renderPass = aRenderPass;
 		pipeInfo.subpass = 0;
 
 		VkPipeline pipe = VK_NULL_HANDLE;
-		if (auto const res = vkCreateGraphicsPipelines(aWindow.device, VK_NULL_HANDLE, 1, &pipeInfo, nullptr, &pipe); VK_SUCCESS != res)
+		if (auto const res = vkCreateGraphicsPipelines(aWindow.device, aPipelineCache, 1, &pipeInfo, nullptr, &pipe); VK_SUCCESS != res)
 		{
 			throw lut::Error("Unable to create coloured pipeline\n" "vkCreateGraphicsPipelines() returned %s", lut::to_string(res).c_str());
 		}
@@ -1414,22 +2785,19 @@ namespace
 		return lut::Pipeline(aWindow.device, pipe);
 	}
 
-	lut::Pipeline create_textured_pipeline(lut::VulkanWindow const& aWindow, VkRenderPass aRenderPass, VkPipelineLayout aPipelineLayout, const char* vertShaderPath, const char* fragShaderPath)
+	lut::Pipeline create_textured_pipeline(lut::VulkanWindow const& aWindow, VkRenderPass aRenderPass, VkPipelineLayout aPipelineLayout, VkPipelineCache aPipelineCache, VkShaderModule aVert, VkShaderModule aFrag, bool aDepthEqual)
 	{
-		//Load shader modules
-		lut::ShaderModule vert = lut::load_shader_module(aWindow, vertShaderPath);
-		lut::ShaderModule frag = lut::load_shader_module(aWindow, fragShaderPath);
 
 		//Define shader stages in the pipeline
 		VkPipelineShaderStageCreateInfo stages[2]{};
 		stages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
 		stages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
-		stages[0].module = vert.handle;
+		stages[0].module = aVert;
 		stages[0].pName = "main";
 
 		stages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
 		stages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
-		stages[1].module = frag.handle;
+		stages[1].module = aFrag;
 		stages[1].pName = "main";
 
 		//Define vertex input attributes
@@ -1467,25 +2835,21 @@ namespace
 		assemblyInfo.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
 		assemblyInfo.primitiveRestartEnable = VK_FALSE;
 
-		//Define viewport and scissor regions
-		VkViewport viewport{};
-		viewport.x = 0.f;
-		viewport.y = 0.f;
-		viewport.width = float(aWindow.swapchainExtent.width);
-		viewport.height = float(aWindow.swapchainExtent.height);
-		viewport.minDepth = 0.f;
-		viewport.maxDepth = 1.f;
-
-		VkRect2D scissor{};
-		scissor.offset = VkOffset2D{ 0,0 };
-		scissor.extent = VkExtent2D{ aWindow.swapchainExtent.width, aWindow.swapchainExtent.height };
-
+		//Viewport and scissor regions are dynamic state, set when recording
+		//commands. This way, the pipeline does not depend on the window size.
 		VkPipelineViewportStateCreateInfo viewportInfo{};
 		viewportInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
 		viewportInfo.viewportCount = 1;
-		viewportInfo.pViewports = &viewport;
+		viewportInfo.pViewports = nullptr;
 		viewportInfo.scissorCount = 1;
-		viewportInfo.pScissors = &scissor;
+		viewportInfo.pScissors = nullptr;
+
+		VkDynamicState const dynamicStates[] = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
+
+		VkPipelineDynamicStateCreateInfo dynamicInfo{};
+		dynamicInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+		dynamicInfo.dynamicStateCount = 2;
+		dynamicInfo.pDynamicStates = dynamicStates;
 
 		//Define rasterisation options
 		VkPipelineRasterizationStateCreateInfo rasterInfo{};
@@ -1517,12 +2881,13 @@ namespace
 		blendInfo.attachmentCount = 1;
 		blendInfo.pAttachments = blendStates;
 
-		//Define depth stencil state
+		//Define depth stencil state. After a depth pre-pass, only the
+		//fragments that are visible pass the depth test.
 		VkPipelineDepthStencilStateCreateInfo depthInfo{};
 		depthInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
 		depthInfo.depthTestEnable = VK_TRUE;
-		depthInfo.depthWriteEnable = VK_TRUE;
-		depthInfo.depthCompareOp = VK_COMPARE_OP_LESS_OR_EQUAL;
+		depthInfo.depthWriteEnable = aDepthEqual ? VK_FALSE : VK_TRUE;
+		depthInfo.depthCompareOp = aDepthEqual ? VK_COMPARE_OP_EQUAL : VK_COMPARE_OP_LESS_OR_EQUAL;
 		depthInfo.minDepthBounds = 0.f;
 		depthInfo.maxDepthBounds = 1.f;
 
@@ -1540,38 +2905,252 @@ namespace
 		pipeInfo.pMultisampleState = &samplingInfo;
 		pipeInfo.pDepthStencilState = &depthInfo;
 		pipeInfo.pColorBlendState = &blendInfo;
-		pipeInfo.pDynamicState = nullptr;
+		pipeInfo.pDynamicState = &dynamicInfo;
 		pipeInfo.layout = aPipelineLayout;
 		pipeInfo.renderPass = aRenderPass;
 		pipeInfo.subpass = 0;
 
 		VkPipeline pipe = VK_NULL_HANDLE;
-		if (auto const res = vkCreateGraphicsPipelines(aWindow.device, VK_NULL_HANDLE, 1, &pipeInfo, nullptr, &pipe); VK_SUCCESS != res)
+		if (auto const res = vkCreateGraphicsPipelines(aWindow.device, aPipelineCache, 1, &pipeInfo, nullptr, &pipe); VK_SUCCESS != res)
 		{
 			throw lut::Error("Unable to create textured pipeline\n" "vkCreateGraphicsPipelines() returned %s", lut::to_string(res).c_str());
 		}
 
 		return lut::Pipeline(aWindow.device, pipe);
 	}
-	/*
-	lut::Pipeline create_storage_pipeline(lut::VulkanWindow const& aWindow, VkRenderPass aRenderPass, VkPipelineLayout aPipelineLayout, const char* vertShaderPath, const char* fragShaderPath)
+
+	lut::Pipeline create_position_only_pipeline(lut::VulkanWindow const& aWindow, VkRenderPass aRenderPass, VkPipelineLayout aPipelineLayout, VkPipelineCache aPipelineCache, VkShaderModule aVert, VkShaderModule aFrag)
 	{
-		//Load shader modules
-		lut::ShaderModule vert = lut::load_shader_module(aWindow, vertShaderPath);
-		lut::ShaderModule frag = lut::load_shader_module(aWindow, fragShaderPath);
+		//The fragment shader is optional. Without one, only depth is written.
+		VkPipelineShaderStageCreateInfo stages[2]{};
+		stages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		stages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
+		stages[0].module = aVert;
+		stages[0].pName = "main";
+
+		stages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		stages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+		stages[1].module = aFrag;
+		stages[1].pName = "main";
+
+		//Positions only. Textured and coloured meshes both store positions
+		//as three floats.
+		VkVertexInputBindingDescription vertexInputs[1]{};
+		vertexInputs[0].binding = 0;
+		vertexInputs[0].stride = sizeof(float) * 3;
+		vertexInputs[0].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+
+		VkVertexInputAttributeDescription vertexAttributes[1]{};
+		vertexAttributes[0].binding = 0; //Must match binding above
+		vertexAttributes[0].location = 0; //Must match shader
+		vertexAttributes[0].format = VK_FORMAT_R32G32B32_SFLOAT;
+		vertexAttributes[0].offset = 0;
+
+		VkPipelineVertexInputStateCreateInfo inputInfo{};
+		inputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+		inputInfo.vertexBindingDescriptionCount = 1; //Number of vertexInputs
+		inputInfo.pVertexBindingDescriptions = vertexInputs;
+		inputInfo.vertexAttributeDescriptionCount = 1; //Number of vertexAttributes
+		inputInfo.pVertexAttributeDescriptions = vertexAttributes;
+
+		VkPipelineInputAssemblyStateCreateInfo assemblyInfo{};
+		assemblyInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+		assemblyInfo.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+		assemblyInfo.primitiveRestartEnable = VK_FALSE;
+
+		VkPipelineViewportStateCreateInfo viewportInfo{};
+		viewportInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+		viewportInfo.viewportCount = 1;
+		viewportInfo.pViewports = nullptr;
+		viewportInfo.scissorCount = 1;
+		viewportInfo.pScissors = nullptr;
 
+		VkDynamicState const dynamicStates[] = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
+
+		VkPipelineDynamicStateCreateInfo dynamicInfo{};
+		dynamicInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+		dynamicInfo.dynamicStateCount = 2;
+		dynamicInfo.pDynamicStates = dynamicStates;
+
+		//Must match the colour pipelines, so that the same fragments are
+		//generated
+		VkPipelineRasterizationStateCreateInfo rasterInfo{};
+		rasterInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+		rasterInfo.depthClampEnable = VK_FALSE;
+		rasterInfo.rasterizerDiscardEnable = VK_FALSE;
+		rasterInfo.polygonMode = VK_POLYGON_MODE_FILL;
+		rasterInfo.cullMode = VK_CULL_MODE_BACK_BIT;
+		rasterInfo.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+		rasterInfo.depthBiasEnable = VK_FALSE;
+		rasterInfo.lineWidth = 1.f;
+
+		VkPipelineMultisampleStateCreateInfo samplingInfo{};
+		samplingInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+		samplingInfo.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+
+		//The render pass has a colour attachment, which is left untouched
+		VkPipelineColorBlendAttachmentState blendStates[1]{};
+		blendStates[0].blendEnable = VK_FALSE;
+		blendStates[0].colorWriteMask = 0;
+
+		VkPipelineColorBlendStateCreateInfo blendInfo{};
+		blendInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+		blendInfo.logicOpEnable = VK_FALSE;
+		blendInfo.attachmentCount = 1;
+		blendInfo.pAttachments = blendStates;
+
+		VkPipelineDepthStencilStateCreateInfo depthInfo{};
+		depthInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+		depthInfo.depthTestEnable = VK_TRUE;
+		depthInfo.depthWriteEnable = VK_TRUE;
+		depthInfo.depthCompareOp = VK_COMPARE_OP_LESS_OR_EQUAL;
+		depthInfo.minDepthBounds = 0.f;
+		depthInfo.maxDepthBounds = 1.f;
+
+		VkGraphicsPipelineCreateInfo pipeInfo{};
+		pipeInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+		pipeInfo.stageCount = VK_NULL_HANDLE != aFrag ? 2 : 1;
+		pipeInfo.pStages = stages;
+
+		pipeInfo.pVertexInputState = &inputInfo;
+		pipeInfo.pInputAssemblyState = &assemblyInfo;
+		pipeInfo.pTessellationState = nullptr;
+		pipeInfo.pViewportState = &viewportInfo;
+		pipeInfo.pRasterizationState = &rasterInfo;
+		pipeInfo.pMultisampleState = &samplingInfo;
+		pipeInfo.pDepthStencilState = &depthInfo;
+		pipeInfo.pColorBlendState = &blendInfo;
+		pipeInfo.pDynamicState = &dynamicInfo;
+		pipeInfo.layout = aPipelineLayout;
+		pipeInfo.renderPass = aRenderPass;
+		pipeInfo.subpass = 0;
+
+		VkPipeline pipe = VK_NULL_HANDLE;
+		if (auto const res = vkCreateGraphicsPipelines(aWindow.device, aPipelineCache, 1, &pipeInfo, nullptr, &pipe); VK_SUCCESS != res)
+		{
+			throw lut::Error("Unable to create position-only pipeline\n" "vkCreateGraphicsPipelines() returned %s", lut::to_string(res).c_str());
+		}
+
+		return lut::Pipeline(aWindow.device, pipe);
+	}
+
+	void load_shader_modules(lut::VulkanContext const& aContext, PipelineDesc const* aDescs, std::size_t aCount, ShaderModuleMap& aModules)
+	{
+		for (std::size_t i = 0; i < aCount; ++i)
+		{
+			for (char const* path : { aDescs[i].vertShaderPath, aDescs[i].fragShaderPath })
+			{
+				if (aModules.find(path) == aModules.end())
+					aModules.emplace(path, lut::load_shader_module(aContext, path));
+			}
+		}
+	}
+
+	void create_pipelines(lut::VulkanWindow const& aWindow, VkRenderPass aRenderPass, VkPipelineLayout aColouredLayout, VkPipelineLayout aTexturedLayout, VkPipelineCache aPipelineCache, ShaderModuleMap const& aModules, PipelineDesc const* aDescs, std::size_t aCount)
+	{
+		//Pipeline caches are internally synchronized, so all threads can
+		//share one. Each thread writes to a distinct pipeline object.
+		lut::parallel_for(aCount, [&] (std::size_t aIndex) {
+			auto const& desc = aDescs[aIndex];
+
+			VkShaderModule const vert = aModules.at(desc.vertShaderPath).handle;
+			VkShaderModule const frag = aModules.at(desc.fragShaderPath).handle;
+
+			if (desc.textured)
+				*desc.pipeline = create_textured_pipeline(aWindow, aRenderPass, aTexturedLayout, aPipelineCache, vert, frag, desc.depthEqual);
+			else
+				*desc.pipeline = create_coloured_pipeline(aWindow, aRenderPass, aColouredLayout, aPipelineCache, vert, frag, desc.depthEqual);
+		});
+	}
+
+	lut::Pipeline create_compute_pipeline(lut::VulkanContext const& aContext, VkPipelineLayout aPipelineLayout, VkPipelineCache aPipelineCache, VkShaderModule aComp)
+	{
+		VkComputePipelineCreateInfo pipeInfo{};
+		pipeInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+		pipeInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		pipeInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+		pipeInfo.stage.module = aComp;
+		pipeInfo.stage.pName = "main";
+		pipeInfo.layout = aPipelineLayout;
+
+		VkPipeline pipe = VK_NULL_HANDLE;
+		if (auto const res = vkCreateComputePipelines(aContext.device, aPipelineCache, 1, &pipeInfo, nullptr, &pipe); VK_SUCCESS != res)
+		{
+			throw lut::Error("Unable to create compute pipeline\n" "vkCreateComputePipelines() returned %s", lut::to_string(res).c_str());
+		}
+
+		return lut::Pipeline(aContext.device, pipe);
+	}
+
+	lut::Pipeline create_overdraw_resolve_pipeline(lut::VulkanWindow const& aWindow, VkRenderPass aRenderPass, VkPipelineLayout aPipelineLayout, VkPipelineCache aPipelineCache, VkShaderModule aVert, VkShaderModule aFrag)
+	{
 		//Define shader stages in the pipeline
 		VkPipelineShaderStageCreateInfo stages[2]{};
 		stages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
 		stages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
-		stages[0].module = vert.handle;
+		stages[0].module = aVert;
 		stages[0].pName = "main";
 
 		stages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
 		stages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
-		stages[1].module = frag.handle;
+		stages[1].module = aFrag;
 		stages[1].pName = "main";
 
+		//The fullscreen triangle is generated in the vertex shader
+		VkPipelineVertexInputStateCreateInfo inputInfo{};
+		inputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+
+		VkPipelineInputAssemblyStateCreateInfo assemblyInfo{};
+		assemblyInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+		assemblyInfo.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+		assemblyInfo.primitiveRestartEnable = VK_FALSE;
+
+		VkPipelineViewportStateCreateInfo viewportInfo{};
+		viewportInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+		viewportInfo.viewportCount = 1;
+		viewportInfo.pViewports = nullptr;
+		viewportInfo.scissorCount = 1;
+		viewportInfo.pScissors = nullptr;
+
+		VkDynamicState const dynamicStates[] = { VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR };
+
+		VkPipelineDynamicStateCreateInfo dynamicInfo{};
+		dynamicInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+		dynamicInfo.dynamicStateCount = 2;
+		dynamicInfo.pDynamicStates = dynamicStates;
+
+		VkPipelineRasterizationStateCreateInfo rasterInfo{};
+		rasterInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+		rasterInfo.depthClampEnable = VK_FALSE;
+		rasterInfo.rasterizerDiscardEnable = VK_FALSE;
+		rasterInfo.polygonMode = VK_POLYGON_MODE_FILL;
+		rasterInfo.cullMode = VK_CULL_MODE_NONE;
+		rasterInfo.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+		rasterInfo.depthBiasEnable = VK_FALSE;
+		rasterInfo.lineWidth = 1.f;
+
+		VkPipelineMultisampleStateCreateInfo samplingInfo{};
+		samplingInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+		samplingInfo.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+
+		VkPipelineColorBlendAttachmentState blendStates[1]{};
+		blendStates[0].blendEnable = VK_FALSE;
+		blendStates[0].colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+
+		VkPipelineColorBlendStateCreateInfo blendInfo{};
+		blendInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+		blendInfo.logicOpEnable = VK_FALSE;
+		blendInfo.attachmentCount = 1;
+		blendInfo.pAttachments = blendStates;
+
+		//Covers the whole screen, regardless of depth
+		VkPipelineDepthStencilStateCreateInfo depthInfo{};
+		depthInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+		depthInfo.depthTestEnable = VK_FALSE;
+		depthInfo.depthWriteEnable = VK_FALSE;
+		depthInfo.depthCompareOp = VK_COMPARE_OP_ALWAYS;
+		depthInfo.minDepthBounds = 0.f;
+		depthInfo.maxDepthBounds = 1.f;
 
 		//We can now create the pipeline
 		VkGraphicsPipelineCreateInfo pipeInfo{};
@@ -1579,60 +3158,165 @@ namespace
 		pipeInfo.stageCount = 2;
 		pipeInfo.pStages = stages;
 
+		pipeInfo.pVertexInputState = &inputInfo;
+		pipeInfo.pInputAssemblyState = &assemblyInfo;
+		pipeInfo.pTessellationState = nullptr;
+		pipeInfo.pViewportState = &viewportInfo;
+		pipeInfo.pRasterizationState = &rasterInfo;
+		pipeInfo.pMultisampleState = &samplingInfo;
+		pipeInfo.pDepthStencilState = &depthInfo;
+		pipeInfo.pColorBlendState = &blendInfo;
+		pipeInfo.pDynamicState = &dynamicInfo;
 		pipeInfo.layout = aPipelineLayout;
 		pipeInfo.renderPass = aRenderPass;
 		pipeInfo.subpass = 0;
 
-		VkPipeline pipe = VK_NULL_HANDLE;
-		if (auto const res = vkCreateGraphicsPipelines(aWindow.device, VK_NULL_HANDLE, 1, &pipeInfo, nullptr, &pipe); VK_SUCCESS != res)
+		VkPipeline pipe = VK_NULL_HANDLE;
+		if (auto const res = vkCreateGraphicsPipelines(aWindow.device, aPipelineCache, 1, &pipeInfo, nullptr, &pipe); VK_SUCCESS != res)
+		{
+			throw lut::Error("Unable to create overdraw resolve pipeline\n" "vkCreateGraphicsPipelines() returned %s", lut::to_string(res).c_str());
+		}
+
+		return lut::Pipeline(aWindow.device, pipe);
+	}
+
+	void create_swapchain_framebuffers(lut::VulkanWindow const& aWindow, VkRenderPass aRenderPass, std::vector<lut::Framebuffer>& aFramebuffers, VkImageView aDepthView)
+	{
+		assert(aFramebuffers.empty());
+
+		for (std::size_t i = 0; i < aWindow.swapViews.size(); ++i)
+		{
+			VkImageView attachments[2] =
+			{
+				aWindow.swapViews[i],
+				aDepthView
+			};
+
+			VkFramebufferCreateInfo fbInfo{};
+			fbInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+			fbInfo.flags = 0;
+			fbInfo.renderPass = aRenderPass;
+			fbInfo.attachmentCount = 2;
+			fbInfo.pAttachments = attachments;
+			fbInfo.width = aWindow.swapchainExtent.width;
+			fbInfo.height = aWindow.swapchainExtent.height;
+			fbInfo.layers = 1;
+
+			VkFramebuffer fb = VK_NULL_HANDLE;
+			if (auto const res = vkCreateFramebuffer(aWindow.device, &fbInfo, nullptr, &fb); VK_SUCCESS != res)
+			{
+				throw lut::Error("Unable to create framebuffer for swap chain image %zu\n" "vkCreateFramebuffer() returned %s", i, lut::to_string(res).c_str());
+			}
+
+			aFramebuffers.emplace_back(lut::Framebuffer(aWindow.device, fb));
+		}
+
+		assert(aWindow.swapViews.size() == aFramebuffers.size());
+	}
+
+	lut::DescriptorSetLayout create_scene_descriptor_layout(lut::VulkanWindow const& aWindow)
+	{
+		VkDescriptorSetLayoutBinding bindings[1]{};
+		bindings[0].binding = 0; //Number must match the index of the corresponding *binding = N* declaration in shader
+		bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+		bindings[0].descriptorCount = 1;
+		bindings[0].stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+
+		VkDescriptorSetLayoutCreateInfo layoutInfo{};
+		layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+		layoutInfo.bindingCount = sizeof(bindings) / sizeof(bindings[0]);
+		layoutInfo.pBindings = bindings;
+
+		VkDescriptorSetLayout layout = VK_NULL_HANDLE;
+		if (auto const res = vkCreateDescriptorSetLayout(aWindow.device, &layoutInfo, nullptr, &layout); VK_SUCCESS != res)
+		{
+			throw lut::Error("Unable to create descriptor set layout\n" "vkCreateDescriptorSetLayout() returned %s", lut::to_string(res).c_str());
+		}
+
+		return lut::DescriptorSetLayout(aWindow.device, layout);
+
+	}
+	lut::DescriptorSetLayout create_object_descriptor_layout(lut::VulkanWindow const& aWindow, bool aBindless, std::uint32_t aMaxTextures)
+	{
+		//The texture array, without samplers. Its actual size is given when
+		//allocating the set, see alloc_texture_desc_set(). Without
+		//descriptor indexing, the set holds a single texture.
+		VkDescriptorSetLayoutBinding bindings[1]{};
+		bindings[0].binding = 0; //Number must match the index of the corresponding *binding = N* declaration in shader
+		bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+		bindings[0].descriptorCount = aBindless ? aMaxTextures : 1;
+		bindings[0].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+
+		VkDescriptorBindingFlags const bindingFlags[1] = { VK_DESCRIPTOR_BINDING_VARIABLE_DESCRIPTOR_COUNT_BIT };
+
+		VkDescriptorSetLayoutBindingFlagsCreateInfo flagsInfo{};
+		flagsInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
+		flagsInfo.bindingCount = sizeof(bindingFlags) / sizeof(bindingFlags[0]);
+		flagsInfo.pBindingFlags = bindingFlags;
+
+		VkDescriptorSetLayoutCreateInfo layoutInfo{};
+		layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+		layoutInfo.pNext = aBindless ? &flagsInfo : nullptr;
+		layoutInfo.bindingCount = sizeof(bindings) / sizeof(bindings[0]);
+		layoutInfo.pBindings = bindings;
+
+		VkDescriptorSetLayout layout = VK_NULL_HANDLE;
+		if (auto const res = vkCreateDescriptorSetLayout(aWindow.device, &layoutInfo, nullptr, &layout); VK_SUCCESS != res)
 		{
-			throw lut::Error("Unable to create textured pipeline\n" "vkCreateGraphicsPipelines() returned %s", lut::to_string(res).c_str());
+			throw lut::Error("Unable to create descriptor set layout\n" "vkCreateDescriptorSetLayout() returned %s", lut::to_string(res).c_str());
 		}
 
-		return lut::Pipeline(aWindow.device, pipe);
+		return lut::DescriptorSetLayout(aWindow.device, layout);
 	}
-	*/
-	void create_swapchain_framebuffers(lut::VulkanWindow const& aWindow, VkRenderPass aRenderPass, std::vector<lut::Framebuffer>& aFramebuffers, VkImageView aDepthView)
+
+	lut::DescriptorSetLayout create_cull_descriptor_layout(lut::VulkanWindow const& aWindow)
 	{
-		assert(aFramebuffers.empty());
+		//Draw infos, output commands, per-group draw counts, culling
+		//uniforms, the depth pyramid and the per-draw visibility
+		VkDescriptorType const types[] = {
+			VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+			VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+			VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+			VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
+			VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+			VK_DESCRIPTOR_TYPE_STORAGE_BUFFER
+		};
 
-		for (std::size_t i = 0; i < aWindow.swapViews.size(); ++i)
+		VkDescriptorSetLayoutBinding bindings[6]{};
+		for (std::uint32_t i = 0; i < 6; i++)
 		{
-			VkImageView attachments[2] =
-			{
-				aWindow.swapViews[i],
-				aDepthView
-			};
-
-			VkFramebufferCreateInfo fbInfo{};
-			fbInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
-			fbInfo.flags = 0;
-			fbInfo.renderPass = aRenderPass;
-			fbInfo.attachmentCount = 2;
-			fbInfo.pAttachments = attachments;
-			fbInfo.width = aWindow.swapchainExtent.width;
-			fbInfo.height = aWindow.swapchainExtent.height;
-			fbInfo.layers = 1;
+			bindings[i].binding = i; //Number must match the index of the corresponding *binding = N* declaration in shader
+			bindings[i].descriptorType = types[i];
+			bindings[i].descriptorCount = 1;
+			bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+		}
 
-			VkFramebuffer fb = VK_NULL_HANDLE;
-			if (auto const res = vkCreateFramebuffer(aWindow.device, &fbInfo, nullptr, &fb); VK_SUCCESS != res)
-			{
-				throw lut::Error("Unable to create framebuffer for swap chain image %zu\n" "vkCreateFramebuffer() returned %s", i, lut::to_string(res).c_str());
-			}
+		VkDescriptorSetLayoutCreateInfo layoutInfo{};
+		layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+		layoutInfo.bindingCount = sizeof(bindings) / sizeof(bindings[0]);
+		layoutInfo.pBindings = bindings;
 
-			aFramebuffers.emplace_back(lut::Framebuffer(aWindow.device, fb));
+		VkDescriptorSetLayout layout = VK_NULL_HANDLE;
+		if (auto const res = vkCreateDescriptorSetLayout(aWindow.device, &layoutInfo, nullptr, &layout); VK_SUCCESS != res)
+		{
+			throw lut::Error("Unable to create descriptor set layout\n" "vkCreateDescriptorSetLayout() returned %s", lut::to_string(res).c_str());
 		}
 
-		assert(aWindow.swapViews.size() == aFramebuffers.size());
+		return lut::DescriptorSetLayout(aWindow.device, layout);
 	}
 
-	lut::DescriptorSetLayout create_scene_descriptor_layout(lut::VulkanWindow const& aWindow)
+	lut::DescriptorSetLayout create_depth_reduce_descriptor_layout(lut::VulkanWindow const& aWindow)
 	{
-		VkDescriptorSetLayoutBinding bindings[1]{};
-		bindings[0].binding = 0; //Number must match the index of the corresponding *binding = N* declaration in shader
-		bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+		VkDescriptorSetLayoutBinding bindings[2]{};
+		bindings[0].binding = 0; //Source level (or depth buffer)
+		bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
 		bindings[0].descriptorCount = 1;
-		bindings[0].stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+		bindings[0].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+		bindings[1].binding = 1; //Destination level
+		bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+		bindings[1].descriptorCount = 1;
+		bindings[1].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
 
 		VkDescriptorSetLayoutCreateInfo layoutInfo{};
 		layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
@@ -1646,13 +3330,13 @@ namespace
 		}
 
 		return lut::DescriptorSetLayout(aWindow.device, layout);
-
 	}
-	lut::DescriptorSetLayout create_object_descriptor_layout(lut::VulkanWindow const& aWindow)
+
+	lut::DescriptorSetLayout create_storage_descriptor_layout(lut::VulkanWindow const& aWindow)
 	{
 		VkDescriptorSetLayoutBinding bindings[1]{};
 		bindings[0].binding = 0; //Number must match the index of the corresponding *binding = N* declaration in shader
-		bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
 		bindings[0].descriptorCount = 1;
 		bindings[0].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
 
@@ -1670,11 +3354,11 @@ namespace
 		return lut::DescriptorSetLayout(aWindow.device, layout);
 	}
 
-	/*lut::DescriptorSetLayout create_storage_descriptor_layout(lut::VulkanWindow const& aWindow)
+	lut::DescriptorSetLayout create_sampler_descriptor_layout(lut::VulkanWindow const& aWindow)
 	{
 		VkDescriptorSetLayoutBinding bindings[1]{};
 		bindings[0].binding = 0; //Number must match the index of the corresponding *binding = N* declaration in shader
-		bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+		bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_SAMPLER;
 		bindings[0].descriptorCount = 1;
 		bindings[0].stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
 
@@ -1691,7 +3375,6 @@ namespace
 
 		return lut::DescriptorSetLayout(aWindow.device, layout);
 	}
-	*/
 
 	void submit_commands(lut::VulkanWindow const& aWindow, VkCommandBuffer aCmdBuff, VkFence aFence, VkSemaphore aWaitSemaphore, VkSemaphore aSignalSemaphore)
 	{
@@ -1772,7 +3455,7 @@ namespace
 		imageInfo.arrayLayers = 1;
 		imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
 		imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
-		imageInfo.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+		imageInfo.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT; //Sampled by the depth pyramid reduction
 		imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
 		imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
 
@@ -1810,274 +3493,488 @@ namespace
 
 		return { std::move(depthImage), lut::ImageView(aWindow.device, view) };
 	}
-}
 
-namespace
-{
-	TexturedMesh create_textured_mesh(labutils::VulkanContext const& aContext, labutils::Allocator const& aAllocator, float aPositions[], float aTexCoords[], size_t aVertCount)
+	lut::Sampler create_point_sampler(lut::VulkanContext const& aContext)
 	{
+		//Used with texelFetch() only; depth formats need not support linear filtering
+		VkSamplerCreateInfo samplerInfo{};
+		samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+		samplerInfo.magFilter = VK_FILTER_NEAREST;
+		samplerInfo.minFilter = VK_FILTER_NEAREST;
+		samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+		samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+		samplerInfo.minLod = 0.f;
+		samplerInfo.maxLod = VK_LOD_CLAMP_NONE;
+
+		VkSampler sampler = VK_NULL_HANDLE;
+		if (auto const res = vkCreateSampler(aContext.device, &samplerInfo, nullptr, &sampler); VK_SUCCESS != res)
+		{
+			throw lut::Error("Unable to create sampler\n" "vkCreateSampler() returned %s", lut::to_string(res).c_str());
+		}
 
-		VkDeviceSize posSize = aVertCount * 3 * sizeof(float);
-		VkDeviceSize texSize = aVertCount * 2 * sizeof(float);
-
-		//Create final position and colour buffers
-		lut::Buffer vertexPosGPU = lut::create_buffer(
-			aAllocator,
-			posSize,
-			VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-			0, //No additional VmaAllocationCreateFlags
-			VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE //Can also be VMA_MEMORY_USAGE_AUTO
-		);
+		return lut::Sampler(aContext.device, sampler);
+	}
 
-		lut::Buffer vertexTexGPU = lut::create_buffer(
-			aAllocator,
-			texSize,
-			VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-			0, //No additional VmaAllocationCreateFlags
-			VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE //Can also be VMA_MEMORY_USAGE_AUTO
-		);
+	std::tuple<lut::Image, lut::ImageView> create_overdraw_image(lut::VulkanWindow const& aWindow, lut::Allocator const& aAllocator)
+	{
+		VkImageCreateInfo imageInfo{};
+		imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+		imageInfo.imageType = VK_IMAGE_TYPE_2D;
+		imageInfo.format = VK_FORMAT_R32_UINT; //Only need one channel (number of shader occurences)
+		imageInfo.extent.width = aWindow.swapchainExtent.width;
+		imageInfo.extent.height = aWindow.swapchainExtent.height;
+		imageInfo.extent.depth = 1;
+		imageInfo.mipLevels = 1;
+		imageInfo.arrayLayers = 1;
+		imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+		imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+		imageInfo.usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT; //Cleared every frame
+		imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+		imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
 
-		//Create staging buffers
-		lut::Buffer posStaging = lut::create_buffer(
-			aAllocator,
-			posSize,
-			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-			VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT
-		);
+		VmaAllocationCreateInfo allocInfo{};
+		allocInfo.flags = 0;
+		allocInfo.usage = VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE;
 
-		lut::Buffer texStaging = lut::create_buffer(
-			aAllocator,
-			texSize,
-			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-			VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT
-		);
+		VkImage image = VK_NULL_HANDLE;
+		VmaAllocation allocation = VK_NULL_HANDLE;
 
-		void* posPtr = nullptr;
-		if (auto const res = vmaMapMemory(aAllocator.allocator, posStaging.allocation, &posPtr); VK_SUCCESS != res)
+		if (auto const res = vmaCreateImage(aAllocator.allocator, &imageInfo, &allocInfo, &image, &allocation, nullptr); VK_SUCCESS != res)
 		{
-			throw lut::Error("Mapping memory for writing\n" "vmaMapMemory() returned %s", lut::to_string(res).c_str());
+			throw lut::Error("Unable to allocate storage image\n" "vmaCreateImage returned %s", lut::to_string(res).c_str());
 		}
 
-		std::memcpy(posPtr, aPositions, posSize);
-		vmaUnmapMemory(aAllocator.allocator, posStaging.allocation);
+		lut::Image storageImage(aAllocator.allocator, image, allocation);
+
+		//Create image view
+		VkImageViewCreateInfo viewInfo{};
+		viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+		viewInfo.image = storageImage.image;
+		viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+		viewInfo.format = VK_FORMAT_R32_UINT;
+		viewInfo.components = VkComponentMapping{}; // == Identity
+		viewInfo.subresourceRange = VkImageSubresourceRange{
+			VK_IMAGE_ASPECT_COLOR_BIT,
+			0, 1,
+			0, 1
+		};
 
-		void* colPtr = nullptr;
-		if (auto const res = vmaMapMemory(aAllocator.allocator, texStaging.allocation, &colPtr); VK_SUCCESS != res)
+		VkImageView view = VK_NULL_HANDLE;
+		if (auto const res = vkCreateImageView(aWindow.device, &viewInfo, nullptr, &view); VK_SUCCESS != res)
 		{
-			throw lut::Error("Mapping memory for writing\n" "vmaMapMemory() returned %s", lut::to_string(res).c_str());
+			throw lut::Error("Unable to allocate storage image view\n" "vkCreateImageView returned %s", lut::to_string(res).c_str());
 		}
 
-		std::memcpy(colPtr, aTexCoords, texSize);
-		vmaUnmapMemory(aAllocator.allocator, texStaging.allocation);
+		return { std::move(storageImage), lut::ImageView(aWindow.device, view) };
+	}
 
-		//Prepare for issuing the transfer commands that copy data from staging buffers to final on-GPU buffers
-		//First, ensure that Vulkan resources are alive until all transfers are completed
-		lut::Fence uploadComplete = lut::create_fence(aContext);
+	void update_overdraw_descriptors(lut::VulkanContext const& aContext, VkDescriptorSet aSet, VkImageView aOverdrawView)
+	{
+		VkDescriptorImageInfo storageInfo{};
+		storageInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+		storageInfo.imageView = aOverdrawView;
+		storageInfo.sampler = VK_NULL_HANDLE; //No need for a sampler
 
-		//Queue data uploads from staging buffers to final buffers
-		//Use a separate command pool for simplicity
-		lut::CommandPool uploadPool = lut::create_command_pool(aContext);
-		VkCommandBuffer uploadCmd = lut::alloc_command_buffer(aContext, uploadPool.handle);
+		VkWriteDescriptorSet desc[1]{};
+		desc[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		desc[0].dstSet = aSet;
+		desc[0].dstBinding = 0;
+		desc[0].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+		desc[0].descriptorCount = 1;
+		desc[0].pImageInfo = &storageInfo;
 
-		//Record copy commands into command buffer
-		VkCommandBufferBeginInfo beginInfo{};
-		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-		beginInfo.flags = 0;
-		beginInfo.pInheritanceInfo = nullptr;
+		constexpr auto numSets = sizeof(desc) / sizeof(desc[0]);
+		vkUpdateDescriptorSets(aContext.device, numSets, desc, 0, nullptr);
+	}
 
-		if (auto const res = vkBeginCommandBuffer(uploadCmd, &beginInfo); VK_SUCCESS != res)
+	VkDescriptorSet alloc_texture_desc_set(lut::VulkanContext const& aContext, VkDescriptorPool aPool, VkDescriptorSetLayout aSetLayout, std::uint32_t aTextureCount)
+	{
+		//The texture array holds exactly aTextureCount textures
+		VkDescriptorSetVariableDescriptorCountAllocateInfo countInfo{};
+		countInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_VARIABLE_DESCRIPTOR_COUNT_ALLOCATE_INFO;
+		countInfo.descriptorSetCount = 1;
+		countInfo.pDescriptorCounts = &aTextureCount;
+
+		VkDescriptorSetAllocateInfo allocInfo{};
+		allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+		allocInfo.pNext = &countInfo;
+		allocInfo.descriptorPool = aPool;
+		allocInfo.descriptorSetCount = 1;
+		allocInfo.pSetLayouts = &aSetLayout;
+
+		VkDescriptorSet dset = VK_NULL_HANDLE;
+		if (auto const res = vkAllocateDescriptorSets(aContext.device, &allocInfo, &dset); VK_SUCCESS != res)
 		{
-			throw lut::Error("Beginning command buffer recording\n" "vkBeginCommandBuffer() returned %s", lut::to_string(res).c_str());
+			throw lut::Error("Unable to allocate texture descriptor set\n" "vkAllocateDescriptorSets() returned %s", lut::to_string(res).c_str());
 		}
 
-		VkBufferCopy pcopy{};
-		pcopy.size = posSize;
+		return dset;
+	}
 
-		vkCmdCopyBuffer(uploadCmd, posStaging.buffer, vertexPosGPU.buffer, 1, &pcopy);
+	void update_texture_descriptors(lut::VulkanContext const& aContext, VkDescriptorSet aSet, std::vector<VkImageView> const& aViews)
+	{
+		if (aViews.empty())
+			return;
 
-		lut::buffer_barrier(
-			uploadCmd,
-			vertexPosGPU.buffer,
-			VK_ACCESS_TRANSFER_WRITE_BIT,
-			VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT,
-			VK_PIPELINE_STAGE_TRANSFER_BIT,
-			VK_PIPELINE_STAGE_VERTEX_INPUT_BIT
-		);
+		std::vector<VkDescriptorImageInfo> textureInfos(aViews.size());
+		for (std::size_t i = 0; i < aViews.size(); i++)
+		{
+			textureInfos[i].imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+			textureInfos[i].imageView = aViews[i];
+		}
+
+		VkWriteDescriptorSet desc[1]{};
+		desc[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		desc[0].dstSet = aSet;
+		desc[0].dstBinding = 0;
+		desc[0].dstArrayElement = 0;
+		desc[0].descriptorType = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+		desc[0].descriptorCount = std::uint32_t(textureInfos.size());
+		desc[0].pImageInfo = textureInfos.data();
 
-		VkBufferCopy tcopy{};
-		tcopy.size = texSize;
+		constexpr auto numSets = sizeof(desc) / sizeof(desc[0]);
+		vkUpdateDescriptorSets(aContext.device, numSets, desc, 0, nullptr);
+	}
 
-		vkCmdCopyBuffer(uploadCmd, texStaging.buffer, vertexTexGPU.buffer, 1, &tcopy);
+	void update_sampler_descriptors(lut::VulkanContext const& aContext, VkDescriptorSet aSet, VkSampler aSampler)
+	{
+		VkDescriptorImageInfo samplerInfo{};
+		samplerInfo.sampler = aSampler;
 
-		lut::buffer_barrier(
-			uploadCmd,
-			vertexTexGPU.buffer,
-			VK_ACCESS_TRANSFER_WRITE_BIT,
-			VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT,
-			VK_PIPELINE_STAGE_TRANSFER_BIT,
-			VK_PIPELINE_STAGE_VERTEX_INPUT_BIT
-		);
+		VkWriteDescriptorSet desc[1]{};
+		desc[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		desc[0].dstSet = aSet;
+		desc[0].dstBinding = 0;
+		desc[0].descriptorType = VK_DESCRIPTOR_TYPE_SAMPLER;
+		desc[0].descriptorCount = 1;
+		desc[0].pImageInfo = &samplerInfo;
+
+		constexpr auto numSets = sizeof(desc) / sizeof(desc[0]);
+		vkUpdateDescriptorSets(aContext.device, numSets, desc, 0, nullptr);
+	}
+
+	DepthPyramid create_depth_pyramid(lut::VulkanWindow const& aWindow, lut::Allocator const& aAllocator, VkDescriptorSetLayout aReduceLayout, VkImageView aDepthView, VkSampler aSampler)
+	{
+		DepthPyramid ret;
+		ret.width = std::max(1u, aWindow.swapchainExtent.width / 2);
+		ret.height = std::max(1u, aWindow.swapchainExtent.height / 2);
+		ret.levels = lut::compute_mip_level_count(ret.width, ret.height);
+
+		VkImageCreateInfo imageInfo{};
+		imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+		imageInfo.imageType = VK_IMAGE_TYPE_2D;
+		imageInfo.format = VK_FORMAT_R32_SFLOAT;
+		imageInfo.extent.width = ret.width;
+		imageInfo.extent.height = ret.height;
+		imageInfo.extent.depth = 1;
+		imageInfo.mipLevels = ret.levels;
+		imageInfo.arrayLayers = 1;
+		imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+		imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+		imageInfo.usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+		imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+		imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+		VmaAllocationCreateInfo allocInfo{};
+		allocInfo.usage = VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE;
+
+		VkImage image = VK_NULL_HANDLE;
+		VmaAllocation allocation = VK_NULL_HANDLE;
 
-		if (auto const res = vkEndCommandBuffer(uploadCmd); VK_SUCCESS != res)
+		if (auto const res = vmaCreateImage(aAllocator.allocator, &imageInfo, &allocInfo, &image, &allocation, nullptr); VK_SUCCESS != res)
 		{
-			throw lut::Error("Ending command buffer recording\n" "vkEndCommandBuffer() returned %s", lut::to_string(res).c_str());
+			throw lut::Error("Unable to allocate depth pyramid image.\n" "vmaCreateImage() returned %s", lut::to_string(res).c_str());
 		}
 
-		//Submit transfer commands
-		VkSubmitInfo submitInfo{};
-		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-		submitInfo.commandBufferCount = 1;
-		submitInfo.pCommandBuffers = &uploadCmd;
+		ret.image = lut::Image(aAllocator.allocator, image, allocation);
+
+		auto const create_view = [&] (std::uint32_t aBaseLevel, std::uint32_t aLevelCount) {
+			VkImageViewCreateInfo viewInfo{};
+			viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+			viewInfo.image = ret.image.image;
+			viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+			viewInfo.format = VK_FORMAT_R32_SFLOAT;
+			viewInfo.components = VkComponentMapping{};
+			viewInfo.subresourceRange = VkImageSubresourceRange{
+				VK_IMAGE_ASPECT_COLOR_BIT,
+				aBaseLevel, aLevelCount,
+				0, 1
+			};
+
+			VkImageView view = VK_NULL_HANDLE;
+			if (auto const res = vkCreateImageView(aWindow.device, &viewInfo, nullptr, &view); VK_SUCCESS != res)
+			{
+				throw lut::Error("Unable to create image view\n" "vkCreateImageView() returned %s", lut::to_string(res).c_str());
+			}
+
+			return lut::ImageView(aWindow.device, view);
+		};
 
-		if (auto const res = vkQueueSubmit(aContext.graphicsQueue, 1, &submitInfo, uploadComplete.handle); VK_SUCCESS != res)
+		ret.view = create_view(0, ret.levels);
+		for (std::uint32_t level = 0; level < ret.levels; level++)
+			ret.levelViews.emplace_back(create_view(level, 1));
+
+		//The sets are released together with the pool when the pyramid is
+		//recreated
+		ret.pool = lut::create_descriptor_pool(aWindow, 2 * ret.levels, ret.levels);
+
+		for (std::uint32_t level = 0; level < ret.levels; level++)
 		{
-			throw lut::Error("Submitting commands\n" "vkQueueSubmit() returned %s", lut::to_string(res).c_str());
+			VkDescriptorSet const set = lut::alloc_desc_set(aWindow, ret.pool.handle, aReduceLayout);
+			ret.reduceSets.emplace_back(set);
+
+			VkDescriptorImageInfo sourceInfo{};
+			sourceInfo.sampler = aSampler;
+			if (0 == level)
+			{
+				sourceInfo.imageView = aDepthView;
+				sourceInfo.imageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL;
+			}
+			else
+			{
+				sourceInfo.imageView = ret.levelViews[level - 1].handle;
+				sourceInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+			}
+
+			VkDescriptorImageInfo targetInfo{};
+			targetInfo.imageView = ret.levelViews[level].handle;
+			targetInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+			VkWriteDescriptorSet desc[2]{};
+			desc[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			desc[0].dstSet = set;
+			desc[0].dstBinding = 0;
+			desc[0].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+			desc[0].descriptorCount = 1;
+			desc[0].pImageInfo = &sourceInfo;
+
+			desc[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			desc[1].dstSet = set;
+			desc[1].dstBinding = 1;
+			desc[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+			desc[1].descriptorCount = 1;
+			desc[1].pImageInfo = &targetInfo;
+
+			constexpr auto numSets = sizeof(desc) / sizeof(desc[0]);
+			vkUpdateDescriptorSets(aWindow.device, numSets, desc, 0, nullptr);
 		}
 
-		//Wait for commands to finish before destroying temporary resources needed for transfers
-		if (auto const res = vkWaitForFences(aContext.device, 1, &uploadComplete.handle, VK_TRUE, std::numeric_limits<std::uint64_t>::max()); VK_SUCCESS != res)
+		return ret;
+	}
+
+	void update_cull_descriptors(lut::VulkanContext const& aContext, FrameResources const& aFrame, VkBuffer aDrawInfos, VkBuffer aVisibility, VkBuffer aUniforms, VkImageView aDepthPyramid, VkSampler aSampler)
+	{
+		VkDescriptorBufferInfo bufferInfo[5]{};
+		bufferInfo[0].buffer = aDrawInfos;
+		bufferInfo[0].range = VK_WHOLE_SIZE;
+		bufferInfo[1].buffer = aFrame.drawCommands.buffer;
+		bufferInfo[1].range = VK_WHOLE_SIZE;
+		bufferInfo[2].buffer = aFrame.drawCounts.buffer;
+		bufferInfo[2].range = VK_WHOLE_SIZE;
+		bufferInfo[3].buffer = aUniforms;
+		bufferInfo[3].range = sizeof(glsl::CullUniform);
+		bufferInfo[4].buffer = aVisibility;
+		bufferInfo[4].range = VK_WHOLE_SIZE;
+
+		VkDescriptorImageInfo pyramidInfo{};
+		pyramidInfo.sampler = aSampler;
+		pyramidInfo.imageView = aDepthPyramid;
+		pyramidInfo.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+
+		VkWriteDescriptorSet desc[6]{};
+		for (std::uint32_t i = 0; i < 6; i++)
 		{
-			throw lut::Error("Waiting for upload to complete\n" "vkWaitForFences() returned %s", lut::to_string(res).c_str());
+			desc[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+			desc[i].dstSet = aFrame.cullDescriptors;
+			desc[i].dstBinding = i;
+			desc[i].descriptorCount = 1;
 		}
 
-		TexturedMesh texMesh;
-		texMesh.positions = std::move(vertexPosGPU);
-		texMesh.texcoords = std::move(vertexTexGPU);
-		texMesh.vertexCount = std::uint32_t(aVertCount);
-		return texMesh;
+		for (std::uint32_t i = 0; i < 3; i++)
+		{
+			desc[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+			desc[i].pBufferInfo = &bufferInfo[i];
+		}
+
+		desc[3].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+		desc[3].pBufferInfo = &bufferInfo[3];
+
+		desc[4].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		desc[4].pImageInfo = &pyramidInfo;
+
+		desc[5].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		desc[5].pBufferInfo = &bufferInfo[4];
 
+		constexpr auto numSets = sizeof(desc) / sizeof(desc[0]);
+		vkUpdateDescriptorSets(aContext.device, numSets, desc, 0, nullptr);
 	}
+}
 
-	ColorizedMesh create_coloured_mesh(labutils::VulkanContext const& aContext, labutils::Allocator const& aAllocator, float aPositions[], float aColor[], size_t aVertCount)
+namespace
+{
+	MeshArena create_mesh_arena(lut::Allocator const& aAllocator, CachedModel const& aModel)
 	{
-		VkDeviceSize posSize = aVertCount * 3 * sizeof(float);
-		VkDeviceSize colSize = aVertCount * 3 * sizeof(float);
-
-		//Create final position and colour buffers
-		lut::Buffer vertexPosGPU = lut::create_buffer(
-			aAllocator,
-			posSize,
-			VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-			0, //No additional VmaAllocationCreateFlags
-			VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE //Can also be VMA_MEMORY_USAGE_AUTO
-		);
+		//Index data is aligned to the size of its index type, which adds at
+		//most a few bytes of padding per mesh
+		VkDeviceSize indexBytes = 0;
+		for (SimpleMeshInfo const& mesh : aModel.model.meshes)
+		{
+			VkDeviceSize const indexSize = VK_INDEX_TYPE_UINT16 == select_index_type(mesh.vertexCount) ? sizeof(std::uint16_t) : sizeof(std::uint32_t);
+			indexBytes += mesh.indexCount * indexSize + sizeof(std::uint32_t);
+		}
 
-		lut::Buffer vertexColGPU = lut::create_buffer(
-			aAllocator,
-			colSize,
-			VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-			0, //No additional VmaAllocationCreateFlags
-			VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE //Can also be VMA_MEMORY_USAGE_AUTO
-		);
+		VkBufferUsageFlags const vertexUsage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
 
-		//Create staging buffers
-		lut::Buffer posStaging = lut::create_buffer(
-			aAllocator,
-			posSize,
-			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-			VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT
-		);
+		MeshArena arena;
+		arena.texPositions = lut::create_mega_buffer(aAllocator, aModel.textured.positions.count * sizeof(glm::vec3), vertexUsage);
+		arena.texcoords = lut::create_mega_buffer(aAllocator, aModel.textured.texcoords.count * sizeof(glm::vec2), vertexUsage);
+		arena.colPositions = lut::create_mega_buffer(aAllocator, aModel.untextured.positions.count * sizeof(glm::vec3), vertexUsage);
+		arena.colColors = lut::create_mega_buffer(aAllocator, aModel.untextured.colors.count * sizeof(glm::vec3), vertexUsage);
+		arena.indices = lut::create_mega_buffer(aAllocator, indexBytes, VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT);
+		return arena;
+	}
 
-		lut::Buffer colStaging = lut::create_buffer(
-			aAllocator,
-			colSize,
-			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-			VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT
-				);
+	TexturedMesh create_textured_mesh(lut::UploadBatcher& aUploader, MeshArena& aArena, float const aPositions[], float const aTexCoords[], size_t aVertCount, std::uint8_t const aPackedIndices[], size_t aIndexCount)
+	{
+		//The indices are already packed to 16 bits whenever the mesh is
+		//small enough
+		VkIndexType const indexType = select_index_type(aVertCount);
+		VkDeviceSize const indexSize = VK_INDEX_TYPE_UINT16 == indexType ? sizeof(std::uint16_t) : sizeof(std::uint32_t);
 
-				void* posPtr = nullptr;
-				if (auto const res = vmaMapMemory(aAllocator.allocator, posStaging.allocation, &posPtr); VK_SUCCESS != res)
-				{
-					throw lut::Error("Mapping memory for writing\n" "vmaMapMemory() returned %s", lut::to_string(res).c_str());
-				}
+		VkDeviceSize posSize = aVertCount * 3 * sizeof(float);
+		VkDeviceSize texSize = aVertCount * 2 * sizeof(float);
+		VkDeviceSize idxSize = aIndexCount * indexSize;
 
-				std::memcpy(posPtr, aPositions, posSize);
-				vmaUnmapMemory(aAllocator.allocator, posStaging.allocation);
+		//Sub-allocate from the shared buffers. Aligning to the vertex stride
+		//lets the draw address the vertices with vertexOffset.
+		VkDeviceSize const posOffset = aArena.texPositions.allocate(posSize, 3 * sizeof(float));
+		VkDeviceSize const texOffset = aArena.texcoords.allocate(texSize, 2 * sizeof(float));
+		VkDeviceSize const idxOffset = aArena.indices.allocate(idxSize, indexSize);
 
-				void* colPtr = nullptr;
-				if (auto const res = vmaMapMemory(aAllocator.allocator, colStaging.allocation, &colPtr); VK_SUCCESS != res)
-				{
-					throw lut::Error("Mapping memory for writing\n" "vmaMapMemory() returned %s", lut::to_string(res).c_str());
-				}
+		//Both streams are indexed with the same vertexOffset
+		assert(posOffset / (3 * sizeof(float)) == texOffset / (2 * sizeof(float)));
 
-				std::memcpy(colPtr, aColor, colSize);
-				vmaUnmapMemory(aAllocator.allocator, colStaging.allocation);
+		//Queue the uploads; these complete when the batcher is flushed
+		aUploader.upload(aArena.texPositions.buffer.buffer, posOffset, aPositions, posSize);
+		aUploader.upload(aArena.texcoords.buffer.buffer, texOffset, aTexCoords, texSize);
+		aUploader.upload(aArena.indices.buffer.buffer, idxOffset, aPackedIndices, idxSize);
 
-				//Prepare for issuing the transfer commands that copy data from staging buffers to final on-GPU buffers
-				//First, ensure that Vulkan resources are alive until all transfers are completed
-				lut::Fence uploadComplete = lut::create_fence(aContext);
+		TexturedMesh texMesh;
+		texMesh.vertexOffset = std::int32_t(posOffset / (3 * sizeof(float)));
+		texMesh.vertexCount = std::uint32_t(aVertCount);
+		texMesh.firstIndex = std::uint32_t(idxOffset / indexSize);
+		texMesh.indexCount = std::uint32_t(aIndexCount);
+		texMesh.indexType = indexType;
+		return texMesh;
+	}
 
-				//Queue data uploads from staging buffers to final buffers
-				//Use a separate command pool for simplicity
-				lut::CommandPool uploadPool = lut::create_command_pool(aContext);
-				VkCommandBuffer uploadCmd = lut::alloc_command_buffer(aContext, uploadPool.handle);
+	ColorizedMesh create_coloured_mesh(lut::UploadBatcher& aUploader, MeshArena& aArena, float const aPositions[], float const aColor[], size_t aVertCount, std::uint8_t const aPackedIndices[], size_t aIndexCount)
+	{
+		//The indices are already packed to 16 bits whenever the mesh is
+		//small enough
+		VkIndexType const indexType = select_index_type(aVertCount);
+		VkDeviceSize const indexSize = VK_INDEX_TYPE_UINT16 == indexType ? sizeof(std::uint16_t) : sizeof(std::uint32_t);
 
-				//Record copy commands into command buffer
-				VkCommandBufferBeginInfo beginInfo{};
-				beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-				beginInfo.flags = 0;
-				beginInfo.pInheritanceInfo = nullptr;
+		VkDeviceSize posSize = aVertCount * 3 * sizeof(float);
+		VkDeviceSize colSize = aVertCount * 3 * sizeof(float);
+		VkDeviceSize idxSize = aIndexCount * indexSize;
+
+		//Sub-allocate from the shared buffers
+		VkDeviceSize const posOffset = aArena.colPositions.allocate(posSize, 3 * sizeof(float));
+		VkDeviceSize const colOffset = aArena.colColors.allocate(colSize, 3 * sizeof(float));
+		VkDeviceSize const idxOffset = aArena.indices.allocate(idxSize, indexSize);
+
+		assert(posOffset == colOffset);
+
+		//Queue the uploads; these complete when the batcher is flushed
+		aUploader.upload(aArena.colPositions.buffer.buffer, posOffset, aPositions, posSize);
+		aUploader.upload(aArena.colColors.buffer.buffer, colOffset, aColor, colSize);
+		aUploader.upload(aArena.indices.buffer.buffer, idxOffset, aPackedIndices, idxSize);
+
+		ColorizedMesh colorMesh;
+		colorMesh.vertexOffset = std::int32_t(posOffset / (3 * sizeof(float)));
+		colorMesh.vertexCount = std::uint32_t(aVertCount);
+		colorMesh.firstIndex = std::uint32_t(idxOffset / indexSize);
+		colorMesh.indexCount = std::uint32_t(aIndexCount);
+		colorMesh.indexType = indexType;
+		return colorMesh;
+	}
 
-				if (auto const res = vkBeginCommandBuffer(uploadCmd, &beginInfo); VK_SUCCESS != res)
-				{
-					throw lut::Error("Beginning command buffer recording\n" "vkBeginCommandBuffer() returned %s", lut::to_string(res).c_str());
-				}
+	VkIndexType select_index_type(size_t aVertCount)
+	{
+		//Must match the packing of the indices in the model
+		return sizeof(std::uint16_t) == packed_index_size(aVertCount) ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32;
+	}
 
-				VkBufferCopy pcopy{};
-				pcopy.size = posSize;
+	std::vector<glsl::DrawInfo> build_draw_groups(std::vector<TexturedMesh> const& aTextured, CullingBounds const& aTexturedBounds, std::vector<ColorizedMesh> const& aColoured, CullingBounds const& aColouredBounds, bool aGroupByTexture, std::vector<DrawGroup>& aGroups)
+	{
+		assert(aTextured.size() == aTexturedBounds.count);
+		assert(aColoured.size() == aColouredBounds.count);
 
-				vkCmdCopyBuffer(uploadCmd, posStaging.buffer, vertexPosGPU.buffer, 1, &pcopy);
+		aGroups.clear();
 
-				lut::buffer_barrier(
-					uploadCmd,
-					vertexPosGPU.buffer,
-					VK_ACCESS_TRANSFER_WRITE_BIT,
-					VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT,
-					VK_PIPELINE_STAGE_TRANSFER_BIT,
-					VK_PIPELINE_STAGE_VERTEX_INPUT_BIT
-				);
+		//Draws are grouped by pipeline (textured or coloured) and index type.
+		//Textures are selected per draw, so they only split groups if they
+		//are bound per group (aGroupByTexture).
+		auto find_group = [&aGroups] (bool aTex, std::uint32_t aTextureIndex, VkIndexType aIndexType) {
+			for (std::size_t i = 0; i < aGroups.size(); i++)
+			{
+				if (aGroups[i].textured == aTex && aGroups[i].textureIndex == aTextureIndex && aGroups[i].indexType == aIndexType)
+					return std::uint32_t(i);
+			}
 
-				VkBufferCopy ccopy{};
-				ccopy.size = colSize;
+			aGroups.emplace_back(DrawGroup{ aTex, aTextureIndex, aIndexType, 0, 0 });
+			return std::uint32_t(aGroups.size() - 1);
+		};
 
-				vkCmdCopyBuffer(uploadCmd, colStaging.buffer, vertexColGPU.buffer, 1, &ccopy);
+		std::vector<std::uint32_t> groupOf;
+		groupOf.reserve(aTextured.size() + aColoured.size());
 
-				lut::buffer_barrier(
-					uploadCmd,
-					vertexColGPU.buffer,
-					VK_ACCESS_TRANSFER_WRITE_BIT,
-					VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT,
-					VK_PIPELINE_STAGE_TRANSFER_BIT,
-					VK_PIPELINE_STAGE_VERTEX_INPUT_BIT
-				);
+		for (TexturedMesh const& mesh : aTextured)
+			groupOf.emplace_back(find_group(true, aGroupByTexture ? mesh.textureIndex : 0, mesh.indexType));
+		for (ColorizedMesh const& mesh : aColoured)
+			groupOf.emplace_back(find_group(false, 0, mesh.indexType));
 
-				if (auto const res = vkEndCommandBuffer(uploadCmd); VK_SUCCESS != res)
-				{
-					throw lut::Error("Ending command buffer recording\n" "vkEndCommandBuffer() returned %s", lut::to_string(res).c_str());
-				}
+		for (std::uint32_t group : groupOf)
+			++aGroups[group].capacity;
 
-				//Submit transfer commands
-				VkSubmitInfo submitInfo{};
-				submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-				submitInfo.commandBufferCount = 1;
-				submitInfo.pCommandBuffers = &uploadCmd;
+		//Each group owns a contiguous range of command slots
+		std::uint32_t base = 0;
+		for (DrawGroup& group : aGroups)
+		{
+			group.base = base;
+			base += group.capacity;
+		}
 
-				if (auto const res = vkQueueSubmit(aContext.graphicsQueue, 1, &submitInfo, uploadComplete.handle); VK_SUCCESS != res)
-				{
-					throw lut::Error("Submitting commands\n" "vkQueueSubmit() returned %s", lut::to_string(res).c_str());
-				}
+		std::vector<glsl::DrawInfo> ret;
+		ret.reserve(groupOf.size());
+
+		auto add_draw = [&] (CullingBounds const& aBounds, std::size_t aIndex, std::uint32_t aIndexCount, std::uint32_t aFirstIndex, std::int32_t aVertexOffset, std::uint32_t aTextureIndex) {
+			std::uint32_t const group = groupOf[ret.size()];
+
+			glsl::DrawInfo info{};
+			info.center = glm::vec4(aBounds.centerX[aIndex], aBounds.centerY[aIndex], aBounds.centerZ[aIndex], 1.f);
+			info.extent = glm::vec4(aBounds.extentX[aIndex], aBounds.extentY[aIndex], aBounds.extentZ[aIndex], 0.f);
+			info.indexCount = aIndexCount;
+			info.firstIndex = aFirstIndex;
+			info.vertexOffset = aVertexOffset;
+			info.group = group;
+			info.groupBase = aGroups[group].base;
+			info.textureIndex = aTextureIndex;
+			ret.emplace_back(info);
+		};
 
-				//Wait for commands to finish before destroying temporary resources needed for transfers
-				if (auto const res = vkWaitForFences(aContext.device, 1, &uploadComplete.handle, VK_TRUE, std::numeric_limits<std::uint64_t>::max()); VK_SUCCESS != res)
-				{
-					throw lut::Error("Waiting for upload to complete\n" "vkWaitForFences() returned %s", lut::to_string(res).c_str());
-				}
+		//The texture index becomes the draw's firstInstance. It stays 0 if
+		//textures are bound per group, which does not need the
+		//drawIndirectFirstInstance feature.
+		for (std::size_t i = 0; i < aTextured.size(); i++)
+			add_draw(aTexturedBounds, i, aTextured[i].indexCount, aTextured[i].firstIndex, aTextured[i].vertexOffset, aGroupByTexture ? 0 : aTextured[i].textureIndex);
+		for (std::size_t i = 0; i < aColoured.size(); i++)
+			add_draw(aColouredBounds, i, aColoured[i].indexCount, aColoured[i].firstIndex, aColoured[i].vertexOffset, 0);
 
-				ColorizedMesh colorMesh;
-				colorMesh.positions = std::move(vertexPosGPU);
-				colorMesh.colors = std::move(vertexColGPU);
-				colorMesh.vertexCount = std::uint32_t(aVertCount);
-				return colorMesh;
+		return ret;
 	}
 }
 
@@ -2140,39 +4037,6 @@ namespace {
 		vkFreeCommandBuffers(aContext.device, aCpool, 1, &commandBuffer);
 
 	}
-
-	void create_imgui_framebuffers(lut::VulkanWindow const& aWindow, VkRenderPass aRenderPass, std::vector<lut::Framebuffer>& aFramebuffers)
-	{
-		assert(aFramebuffers.empty());
-
-		for (std::size_t i = 0; i < aWindow.swapViews.size(); ++i)
-		{
-			VkImageView attachments[] =
-			{
-				aWindow.swapViews[i]
-			};
-
-			VkFramebufferCreateInfo fbInfo{};
-			fbInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
-			fbInfo.flags = 0;
-			fbInfo.renderPass = aRenderPass;
-			fbInfo.attachmentCount = 1;
-			fbInfo.pAttachments = attachments;
-			fbInfo.width = aWindow.swapchainExtent.width;
-			fbInfo.height = aWindow.swapchainExtent.height;
-			fbInfo.layers = 1;
-
-			VkFramebuffer fb = VK_NULL_HANDLE;
-			if (auto const res = vkCreateFramebuffer(aWindow.device, &fbInfo, nullptr, &fb); VK_SUCCESS != res)
-			{
-				throw lut::Error("Unable to create imgui framebuffer for swap chain image %zu\n" "vkCreateFramebuffer() returned %s", i, lut::to_string(res).c_str());
-			}
-
-			aFramebuffers.emplace_back(lut::Framebuffer(aWindow.device, fb));
-		}
-
-		assert(aWindow.swapViews.size() == aFramebuffers.size());
-	}
 }
 
 //EOF vim:syntax=cpp:foldmethod=marker:ts=4:noexpandtab: 
@@ -0,0 +1,723 @@
+#include "model_cache.hpp"
+
+#include <chrono>
+#include <memory>
+#include <vector>
+#include <algorithm>
+#include <filesystem>
+#include <type_traits>
+#include <system_error>
+
+#include <cstdio>
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+
+#if defined(_WIN32)
+#	if !defined(WIN32_LEAN_AND_MEAN)
+#		define WIN32_LEAN_AND_MEAN
+#	endif
+#	if !defined(NOMINMAX)
+#		define NOMINMAX
+#	endif
+#	include <windows.h>
+#else
+#	include <fcntl.h>
+#	include <unistd.h>
+#	include <sys/mman.h>
+#	include <sys/stat.h>
+#endif
+
+#include "load_model_obj.hpp"
+
+namespace fs = std::filesystem;
+
+namespace
+{
+	// File layout. All sections start at a multiple of kSectionAlign bytes:
+	//  - CacheHeader_
+	//  - source path (sourcePathBytes chars)
+	//  - string table (stringBytes chars); names are (offset, length) pairs
+	//  - CacheMaterial_[materialCount]
+	//  - CacheMesh_[meshCount]
+	//  - textured positions (vec3), texcoords (vec2), packed indices
+	//  - untextured positions (vec3), colors (vec3), packed indices
+	//
+	// Packed indices are stored per mesh, each mesh starting at a multiple
+	// of kIndexAlign bytes (see make_cached_model()).
+	//
+	// metadataChecksum covers the header (with the checksum set to zero) and
+	// all sections up to and including the mesh table.
+	//
+	// Bump kCacheVersion whenever the layout or the loader output changes.
+	constexpr char kCacheMagic[8] = { 'S', 'M', 'D', 'L', 'C', 'A', 'C', 'H' };
+	constexpr std::uint32_t kCacheVersion = 5;
+
+	constexpr std::uint64_t kSectionAlign = 16;
+	constexpr std::uint64_t kIndexAlign = 4;
+
+	struct CacheHeader_
+	{
+		char magic[8];
+		std::uint32_t version;
+		std::uint32_t headerBytes;
+
+		std::uint32_t mergedByMaterial;
+		std::uint32_t pad0;
+
+		std::uint64_t sourceSize;
+		std::int64_t sourceModTime;
+
+		std::uint64_t sourcePathBytes;
+		std::uint64_t stringBytes;
+
+		std::uint64_t materialCount;
+		std::uint64_t meshCount;
+
+		std::uint64_t texturedVertexCount;
+		std::uint64_t texturedIndexBytes;
+		std::uint64_t untexturedVertexCount;
+		std::uint64_t untexturedIndexBytes;
+
+		std::uint64_t metadataChecksum;
+	};
+
+	struct CacheString_
+	{
+		std::uint64_t offset;
+		std::uint64_t length;
+	};
+
+	struct CacheMaterial_
+	{
+		CacheString_ name;
+		CacheString_ diffuseTexturePath;
+		float diffuseColor[3];
+		std::uint32_t pad0;
+	};
+
+	struct CacheMesh_
+	{
+		CacheString_ name;
+		std::uint64_t materialIndex;
+		std::uint32_t textured;
+		std::uint32_t pad0;
+		std::uint64_t vertexStartIndex;
+		std::uint64_t vertexCount;
+		std::uint64_t indexStartIndex;
+		std::uint64_t indexCount;
+		std::uint64_t indexOffset; // bytes, into the packed indices
+		float aabbMin[3];
+		float aabbMax[3];
+		float sphere[4]; // center, radius
+	};
+
+	static_assert( std::is_trivially_copyable_v<CacheHeader_> );
+	static_assert( std::is_trivially_copyable_v<CacheMaterial_> );
+	static_assert( std::is_trivially_copyable_v<CacheMesh_> );
+
+	static_assert( sizeof(glm::vec2) == 2*sizeof(float), "glm::vec2 must be tightly packed" );
+	static_assert( sizeof(glm::vec3) == 3*sizeof(float), "glm::vec3 must be tightly packed" );
+
+	// Byte offsets of each section, derived from the header
+	struct CacheLayout_
+	{
+		std::uint64_t sourcePath;
+		std::uint64_t strings;
+		std::uint64_t materials;
+		std::uint64_t meshes;
+		std::uint64_t texPositions;
+		std::uint64_t texTexcoords;
+		std::uint64_t texIndices;
+		std::uint64_t untexPositions;
+		std::uint64_t untexColors;
+		std::uint64_t untexIndices;
+		std::uint64_t totalBytes;
+	};
+
+	constexpr std::uint64_t align_up_( std::uint64_t aValue, std::uint64_t aAlign = kSectionAlign )
+	{
+		return (aValue + aAlign - 1) / aAlign * aAlign;
+	}
+
+	CacheLayout_ compute_layout_( CacheHeader_ const& aHeader )
+	{
+		CacheLayout_ ret{};
+
+		std::uint64_t offset = align_up_( sizeof(CacheHeader_) );
+		auto section = [&offset] ( std::uint64_t aBytes ) {
+			auto const beg = offset;
+			offset = align_up_( offset + aBytes );
+			return beg;
+		};
+
+		ret.sourcePath      = section( aHeader.sourcePathBytes );
+		ret.strings         = section( aHeader.stringBytes );
+		ret.materials       = section( aHeader.materialCount * sizeof(CacheMaterial_) );
+		ret.meshes          = section( aHeader.meshCount * sizeof(CacheMesh_) );
+		ret.texPositions    = section( aHeader.texturedVertexCount * sizeof(glm::vec3) );
+		ret.texTexcoords    = section( aHeader.texturedVertexCount * sizeof(glm::vec2) );
+		ret.texIndices      = section( aHeader.texturedIndexBytes );
+		ret.untexPositions  = section( aHeader.untexturedVertexCount * sizeof(glm::vec3) );
+		ret.untexColors     = section( aHeader.untexturedVertexCount * sizeof(glm::vec3) );
+		ret.untexIndices    = section( aHeader.untexturedIndexBytes );
+		ret.totalBytes      = offset;
+
+		return ret;
+	}
+
+	// Identify the source file (size + modification time)
+	bool stat_source_( char const* aObjPath, std::uint64_t& aSize, std::int64_t& aModTime )
+	{
+		std::error_code ec;
+
+		auto const size = fs::file_size( aObjPath, ec );
+		if( ec ) return false;
+
+		auto const modTime = fs::last_write_time( aObjPath, ec );
+		if( ec ) return false;
+
+		aSize = std::uint64_t(size);
+		aModTime = std::int64_t(modTime.time_since_epoch().count());
+		return true;
+	}
+
+	// Read-only memory mapping of a whole file
+	class FileMapping_
+	{
+		public:
+			explicit FileMapping_( char const* aPath );
+			~FileMapping_();
+
+			FileMapping_( FileMapping_ const& ) = delete;
+			FileMapping_& operator= ( FileMapping_ const& ) = delete;
+
+			std::uint8_t const* data() const noexcept { return mData; }
+			std::uint64_t size() const noexcept { return mSize; }
+
+		private:
+			std::uint8_t const* mData = nullptr;
+			std::uint64_t mSize = 0;
+
+#			if defined(_WIN32)
+			HANDLE mFile = INVALID_HANDLE_VALUE;
+			HANDLE mMapping = nullptr;
+#			endif
+	};
+
+#	if defined(_WIN32)
+	FileMapping_::FileMapping_( char const* aPath )
+	{
+		mFile = CreateFileA( aPath, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr );
+		if( INVALID_HANDLE_VALUE == mFile )
+			return;
+
+		LARGE_INTEGER size;
+		if( !GetFileSizeEx( mFile, &size ) || 0 == size.QuadPart )
+			return;
+
+		mMapping = CreateFileMappingA( mFile, nullptr, PAGE_READONLY, 0, 0, nullptr );
+		if( !mMapping )
+			return;
+
+		if( auto* ptr = MapViewOfFile( mMapping, FILE_MAP_READ, 0, 0, 0 ) )
+		{
+			mData = static_cast<std::uint8_t const*>(ptr);
+			mSize = std::uint64_t(size.QuadPart);
+		}
+	}
+	FileMapping_::~FileMapping_()
+	{
+		if( mData )
+			UnmapViewOfFile( mData );
+		if( mMapping )
+			CloseHandle( mMapping );
+		if( INVALID_HANDLE_VALUE != mFile )
+			CloseHandle( mFile );
+	}
+#	else // !_WIN32
+	FileMapping_::FileMapping_( char const* aPath )
+	{
+		int const fd = ::open( aPath, O_RDONLY );
+		if( -1 == fd )
+			return;
+
+		struct stat st;
+		if( 0 == ::fstat( fd, &st ) && st.st_size > 0 )
+		{
+			void* ptr = ::mmap( nullptr, std::size_t(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0 );
+			if( MAP_FAILED != ptr )
+			{
+				// The whole file is consumed front to back right away
+				::madvise( ptr, std::size_t(st.st_size), MADV_WILLNEED );
+
+				mData = static_cast<std::uint8_t const*>(ptr);
+				mSize = std::uint64_t(st.st_size);
+			}
+		}
+
+		// The mapping remains valid after the descriptor is closed
+		::close( fd );
+	}
+	FileMapping_::~FileMapping_()
+	{
+		if( mData )
+			::munmap( const_cast<std::uint8_t*>(mData), std::size_t(mSize) );
+	}
+#	endif // ~ _WIN32
+
+	// 64-bit FNV-1a, continued from aHash
+	constexpr std::uint64_t kChecksumSeed = 0xcbf29ce484222325ull;
+
+	std::uint64_t checksum_( std::uint64_t aHash, void const* aData, std::uint64_t aBytes )
+	{
+		auto const* bytes = static_cast<std::uint8_t const*>(aData);
+		for( std::uint64_t i = 0; i < aBytes; ++i )
+		{
+			aHash ^= bytes[i];
+			aHash *= 0x100000001b3ull;
+		}
+
+		return aHash;
+	}
+
+	// The checksum covers the header (with metadataChecksum set to zero)
+	// followed by the file bytes [layout.sourcePath, layout.texPositions)
+	std::uint64_t metadata_checksum_( CacheHeader_ aHeader, std::uint8_t const* aMetadata, std::uint64_t aBytes )
+	{
+		aHeader.metadataChecksum = 0;
+
+		auto const hash = checksum_( kChecksumSeed, &aHeader, sizeof(CacheHeader_) );
+		return checksum_( hash, aMetadata, aBytes );
+	}
+
+	template< typename tType, typename tVector >
+	CachedArray<tType> view_( tVector const& aVector )
+	{
+		return CachedArray<tType>{ aVector.data(), aVector.size() };
+	}
+
+	template< typename tType >
+	CachedArray<tType> view_( std::uint8_t const* aBase, std::uint64_t aOffset, std::uint64_t aCount )
+	{
+		return CachedArray<tType>{ reinterpret_cast<tType const*>(aBase + aOffset), std::size_t(aCount) };
+	}
+
+	// Owns the packed indices of a model that did not come from the cache
+	struct PackedIndices_
+	{
+		std::vector<std::uint8_t> textured;
+		std::vector<std::uint8_t> untextured;
+	};
+
+	// Builds the string table when writing
+	struct StringTable_
+	{
+		std::string bytes;
+
+		CacheString_ add( std::string const& aString )
+		{
+			CacheString_ ret{ bytes.size(), aString.size() };
+			bytes += aString;
+			return ret;
+		}
+	};
+
+	// Sections are written front to back. The file is padded with zeros up
+	// to each section's offset; aPos tracks the current end of the file.
+	// This avoids seeking, as fseek() only takes 32-bit offsets on Windows.
+	bool pad_to_( std::FILE* aFile, std::uint64_t& aPos, std::uint64_t aOffset )
+	{
+		assert( aPos <= aOffset );
+
+		char const zeros[kSectionAlign] = {};
+		while( aPos < aOffset )
+		{
+			auto const bytes = std::min<std::uint64_t>( aOffset - aPos, sizeof(zeros) );
+			if( 1 != std::fwrite( zeros, std::size_t(bytes), 1, aFile ) )
+				return false;
+
+			aPos += bytes;
+		}
+
+		return true;
+	}
+
+	bool write_section_( std::FILE* aFile, std::uint64_t& aPos, std::uint64_t aOffset, void const* aData, std::uint64_t aBytes )
+	{
+		if( !pad_to_( aFile, aPos, aOffset ) )
+			return false;
+
+		if( 0 != aBytes && 1 != std::fwrite( aData, std::size_t(aBytes), 1, aFile ) )
+			return false;
+
+		aPos += aBytes;
+		return true;
+	}
+
+	// Checks that the range [aStart, aStart+aCount) lies within [0, aSize)
+	bool in_range_( std::uint64_t aStart, std::uint64_t aCount, std::uint64_t aSize )
+	{
+		return aStart <= aSize && aCount <= aSize - aStart;
+	}
+}
+
+std::string model_cache_path( char const* aObjPath, bool aMergeByMaterial )
+{
+	assert( aObjPath );
+	return std::string( aObjPath ) + (aMergeByMaterial ? ".merged.meshcache" : ".meshcache");
+}
+
+std::size_t packed_index_size( std::size_t aVertexCount )
+{
+	return aVertexCount <= 0xffff ? sizeof(std::uint16_t) : sizeof(std::uint32_t);
+}
+
+CachedModel load_cached_wavefront_obj( char const* aObjPath, bool aMergeByMaterial )
+{
+	assert( aObjPath );
+
+	auto const startTime = std::chrono::steady_clock::now();
+
+	CachedModel ret;
+	if( try_load_model_cache( aObjPath, aMergeByMaterial, ret ) )
+	{
+		auto const ms = std::chrono::duration<double, std::milli>( std::chrono::steady_clock::now() - startTime ).count();
+		std::fprintf( stderr, "Loaded '%s' from mesh cache in %.1f ms (%zu draw calls%s)\n",
+			aObjPath, ms, ret.model.meshes.size(), aMergeByMaterial ? ", merged by material" : ""
+		);
+		return ret;
+	}
+
+	ret = make_cached_model( load_simple_wavefront_obj( aObjPath, aMergeByMaterial ) );
+
+	auto const ms = std::chrono::duration<double, std::milli>( std::chrono::steady_clock::now() - startTime ).count();
+	std::fprintf( stderr, "Parsed '%s' in %.1f ms (mesh cache miss)\n", aObjPath, ms );
+
+	if( !write_model_cache( aObjPath, aMergeByMaterial, ret ) )
+		std::fprintf( stderr, "Warning: unable to write mesh cache '%s'\n", model_cache_path( aObjPath, aMergeByMaterial ).c_str() );
+
+	return ret;
+}
+
+bool try_load_model_cache( char const* aObjPath, bool aMergeByMaterial, CachedModel& aModel )
+{
+	assert( aObjPath );
+
+	std::uint64_t sourceSize = 0;
+	std::int64_t sourceModTime = 0;
+	if( !stat_source_( aObjPath, sourceSize, sourceModTime ) )
+		return false;
+
+	auto const mapping = std::make_shared<FileMapping_ const>( model_cache_path( aObjPath, aMergeByMaterial ).c_str() );
+	if( !mapping->data() || mapping->size() < sizeof(CacheHeader_) )
+		return false;
+
+	auto const* base = mapping->data();
+
+	CacheHeader_ header;
+	std::memcpy( &header, base, sizeof(CacheHeader_) );
+
+	if( 0 != std::memcmp( header.magic, kCacheMagic, sizeof(kCacheMagic) ) )
+		return false;
+	if( kCacheVersion != header.version || sizeof(CacheHeader_) != header.headerBytes )
+		return false;
+	if( sourceSize != header.sourceSize || sourceModTime != header.sourceModTime )
+		return false;
+	if( std::uint32_t(aMergeByMaterial) != header.mergedByMaterial )
+		return false;
+
+	// Each count is bounded by the file size, so that compute_layout_()
+	// cannot overflow. The layout is then checked against the file size.
+	for( auto const count : { header.sourcePathBytes, header.stringBytes, header.materialCount, header.meshCount, header.texturedVertexCount, header.texturedIndexBytes, header.untexturedVertexCount, header.untexturedIndexBytes } )
+	{
+		if( count > mapping->size() )
+			return false;
+	}
+
+	auto const layout = compute_layout_( header );
+	if( mapping->size() < layout.totalBytes )
+		return false;
+
+	if( header.metadataChecksum != metadata_checksum_( header, base + layout.sourcePath, layout.texPositions - layout.sourcePath ) )
+		return false;
+
+	std::string sourcePath( reinterpret_cast<char const*>(base + layout.sourcePath), std::size_t(header.sourcePathBytes) );
+	if( sourcePath != aObjPath )
+		return false;
+
+	// Strings. Any value read from the file is validated, as a corrupt cache
+	// must be rejected (and rebuilt) rather than read out of bounds.
+	char const* strings = reinterpret_cast<char const*>(base + layout.strings);
+	auto get_string = [&] ( CacheString_ const& aStr, std::string& aOut ) {
+		if( !in_range_( aStr.offset, aStr.length, header.stringBytes ) )
+			return false;
+
+		aOut.assign( strings + aStr.offset, std::size_t(aStr.length) );
+		return true;
+	};
+
+	CachedModel ret;
+	ret.model.modelSourcePath = std::move(sourcePath);
+
+	// Materials and meshes
+	ret.model.materials.reserve( std::size_t(header.materialCount) );
+	for( std::uint64_t i = 0; i < header.materialCount; ++i )
+	{
+		CacheMaterial_ mat;
+		std::memcpy( &mat, base + layout.materials + i*sizeof(CacheMaterial_), sizeof(CacheMaterial_) );
+
+		SimpleMaterialInfo mi;
+		if( !get_string( mat.name, mi.materialName ) || !get_string( mat.diffuseTexturePath, mi.diffuseTexturePath ) )
+			return false;
+
+		mi.diffuseColor        = glm::vec3( mat.diffuseColor[0], mat.diffuseColor[1], mat.diffuseColor[2] );
+
+		ret.model.materials.emplace_back( std::move(mi) );
+	}
+
+	ret.model.meshes.reserve( std::size_t(header.meshCount) );
+	ret.indexOffsets.reserve( std::size_t(header.meshCount) );
+	for( std::uint64_t i = 0; i < header.meshCount; ++i )
+	{
+		CacheMesh_ mesh;
+		std::memcpy( &mesh, base + layout.meshes + i*sizeof(CacheMesh_), sizeof(CacheMesh_) );
+
+		// Ranges must lie within the arrays that the mesh draws from. The
+		// index count is bounded first, so that the byte size cannot
+		// overflow.
+		auto const vertexTotal = mesh.textured ? header.texturedVertexCount : header.untexturedVertexCount;
+		auto const indexBytes = mesh.textured ? header.texturedIndexBytes : header.untexturedIndexBytes;
+
+		if( mesh.materialIndex >= header.materialCount )
+			return false;
+		if( !in_range_( mesh.vertexStartIndex, mesh.vertexCount, vertexTotal ) )
+			return false;
+		if( mesh.indexCount > indexBytes || 0 != mesh.indexOffset % kIndexAlign )
+			return false;
+		if( !in_range_( mesh.indexOffset, mesh.indexCount * packed_index_size( std::size_t(mesh.vertexCount) ), indexBytes ) )
+			return false;
+
+		std::string meshName;
+		if( !get_string( mesh.name, meshName ) )
+			return false;
+
+		ret.model.meshes.emplace_back( SimpleMeshInfo{
+			std::move(meshName),
+			std::size_t(mesh.materialIndex),
+			0 != mesh.textured,
+			std::size_t(mesh.vertexStartIndex),
+			std::size_t(mesh.vertexCount),
+			std::size_t(mesh.indexStartIndex),
+			std::size_t(mesh.indexCount),
+			glm::vec3( mesh.aabbMin[0], mesh.aabbMin[1], mesh.aabbMin[2] ),
+			glm::vec3( mesh.aabbMax[0], mesh.aabbMax[1], mesh.aabbMax[2] ),
+			glm::vec3( mesh.sphere[0], mesh.sphere[1], mesh.sphere[2] ),
+			mesh.sphere[3]
+		} );
+		ret.indexOffsets.emplace_back( mesh.indexOffset );
+	}
+
+	// Vertex and index data is used in place
+	ret.textured.positions    = view_<glm::vec3>( base, layout.texPositions, header.texturedVertexCount );
+	ret.textured.texcoords    = view_<glm::vec2>( base, layout.texTexcoords, header.texturedVertexCount );
+	ret.textured.indices      = view_<std::uint8_t>( base, layout.texIndices, header.texturedIndexBytes );
+
+	ret.untextured.positions  = view_<glm::vec3>( base, layout.untexPositions, header.untexturedVertexCount );
+	ret.untextured.colors     = view_<glm::vec3>( base, layout.untexColors, header.untexturedVertexCount );
+	ret.untextured.indices    = view_<std::uint8_t>( base, layout.untexIndices, header.untexturedIndexBytes );
+
+	ret.storage = mapping;
+
+	aModel = std::move(ret);
+	return true;
+}
+
+bool write_model_cache( char const* aObjPath, bool aMergeByMaterial, CachedModel const& aModel )
+{
+	assert( aObjPath );
+	assert( aModel.textured.positions.count == aModel.textured.texcoords.count );
+	assert( aModel.untextured.positions.count == aModel.untextured.colors.count );
+	assert( aModel.model.meshes.size() == aModel.indexOffsets.size() );
+
+	CacheHeader_ header{};
+	std::memcpy( header.magic, kCacheMagic, sizeof(kCacheMagic) );
+	header.version      = kCacheVersion;
+	header.headerBytes  = sizeof(CacheHeader_);
+
+	header.mergedByMaterial = aMergeByMaterial ? 1 : 0;
+
+	if( !stat_source_( aObjPath, header.sourceSize, header.sourceModTime ) )
+		return false;
+
+	std::string const sourcePath = aObjPath;
+
+	// Flatten materials and meshes
+	StringTable_ strings;
+
+	std::vector<CacheMaterial_> materials;
+	materials.reserve( aModel.model.materials.size() );
+	for( auto const& mat : aModel.model.materials )
+	{
+		CacheMaterial_ cm{};
+		cm.name                = strings.add( mat.materialName );
+		cm.diffuseTexturePath  = strings.add( mat.diffuseTexturePath );
+		cm.diffuseColor[0]     = mat.diffuseColor.r;
+		cm.diffuseColor[1]     = mat.diffuseColor.g;
+		cm.diffuseColor[2]     = mat.diffuseColor.b;
+		materials.emplace_back( cm );
+	}
+
+	std::vector<CacheMesh_> meshes;
+	meshes.reserve( aModel.model.meshes.size() );
+	for( std::size_t i = 0; i < aModel.model.meshes.size(); ++i )
+	{
+		auto const& mesh = aModel.model.meshes[i];
+
+		CacheMesh_ cm{};
+		cm.name              = strings.add( mesh.meshName );
+		cm.materialIndex     = mesh.materialIndex;
+		cm.textured          = mesh.textured ? 1 : 0;
+		cm.vertexStartIndex  = mesh.vertexStartIndex;
+		cm.vertexCount       = mesh.vertexCount;
+		cm.indexStartIndex   = mesh.indexStartIndex;
+		cm.indexCount        = mesh.indexCount;
+		cm.indexOffset       = aModel.indexOffsets[i];
+		for( int j = 0; j < 3; ++j )
+		{
+			cm.aabbMin[j]    = mesh.aabbMin[j];
+			cm.aabbMax[j]    = mesh.aabbMax[j];
+			cm.sphere[j]     = mesh.sphereCenter[j];
+		}
+		cm.sphere[3]         = mesh.sphereRadius;
+		meshes.emplace_back( cm );
+	}
+
+	auto const& tex = aModel.textured;
+	auto const& untex = aModel.untextured;
+
+	header.sourcePathBytes        = sourcePath.size();
+	header.stringBytes            = strings.bytes.size();
+	header.materialCount          = materials.size();
+	header.meshCount              = meshes.size();
+	header.texturedVertexCount    = tex.positions.count;
+	header.texturedIndexBytes     = tex.indices.count;
+	header.untexturedVertexCount  = untex.positions.count;
+	header.untexturedIndexBytes   = untex.indices.count;
+
+	auto const layout = compute_layout_( header );
+
+	// The checksum is computed over the metadata exactly as it is laid out
+	// in the file, including the padding between sections
+	{
+		std::vector<std::uint8_t> metadata( std::size_t(layout.texPositions - layout.sourcePath), 0 );
+		auto place = [&] ( std::uint64_t aOffset, void const* aData, std::size_t aBytes ) {
+			if( aBytes )
+				std::memcpy( metadata.data() + (aOffset - layout.sourcePath), aData, aBytes );
+		};
+
+		place( layout.sourcePath, sourcePath.data(), sourcePath.size() );
+		place( layout.strings, strings.bytes.data(), strings.bytes.size() );
+		place( layout.materials, materials.data(), materials.size() * sizeof(CacheMaterial_) );
+		place( layout.meshes, meshes.data(), meshes.size() * sizeof(CacheMesh_) );
+
+		header.metadataChecksum = metadata_checksum_( header, metadata.data(), metadata.size() );
+	}
+
+	// Write to a temporary file first, and move it into place once complete.
+	// This way, an interrupted write never leaves a truncated cache behind.
+	auto const cachePath = model_cache_path( aObjPath, aMergeByMaterial );
+	auto const tempPath = cachePath + ".tmp";
+
+	std::FILE* file = std::fopen( tempPath.c_str(), "wb" );
+	if( !file )
+		return false;
+
+	std::uint64_t pos = 0;
+	bool ok = write_section_( file, pos, 0, &header, sizeof(header) )
+		&& write_section_( file, pos, layout.sourcePath, sourcePath.data(), sourcePath.size() )
+		&& write_section_( file, pos, layout.strings, strings.bytes.data(), strings.bytes.size() )
+		&& write_section_( file, pos, layout.materials, materials.data(), materials.size() * sizeof(CacheMaterial_) )
+		&& write_section_( file, pos, layout.meshes, meshes.data(), meshes.size() * sizeof(CacheMesh_) )
+		&& write_section_( file, pos, layout.texPositions, tex.positions.data, tex.positions.count * sizeof(glm::vec3) )
+		&& write_section_( file, pos, layout.texTexcoords, tex.texcoords.data, tex.texcoords.count * sizeof(glm::vec2) )
+		&& write_section_( file, pos, layout.texIndices, tex.indices.data, tex.indices.count )
+		&& write_section_( file, pos, layout.untexPositions, untex.positions.data, untex.positions.count * sizeof(glm::vec3) )
+		&& write_section_( file, pos, layout.untexColors, untex.colors.data, untex.colors.count * sizeof(glm::vec3) )
+		&& write_section_( file, pos, layout.untexIndices, untex.indices.data, untex.indices.count )
+	;
+
+	// Pad the file to its full (aligned) size; the reader checks against it
+	ok = ok && pad_to_( file, pos, layout.totalBytes );
+
+	ok = (0 == std::fclose( file )) && ok;
+
+	std::error_code ec;
+	if( ok )
+		fs::rename( tempPath, cachePath, ec );
+
+	if( !ok || ec )
+	{
+		fs::remove( tempPath, ec );
+		return false;
+	}
+
+	return true;
+}
+
+CachedModel make_cached_model( SimpleModel aModel )
+{
+	CachedModel ret;
+	ret.model = std::move(aModel);
+
+	auto const& model = ret.model;
+
+	// Pack each mesh's indices to the size used on the GPU. This is the only
+	// pass over the indices; cache hits use the packed indices as they are.
+	auto packed = std::make_shared<PackedIndices_>();
+
+	ret.indexOffsets.reserve( model.meshes.size() );
+	for( auto const& mesh : model.meshes )
+	{
+		auto const& in = mesh.textured ? model.dataTextured.indices : model.dataUntextured.indices;
+		auto& out = mesh.textured ? packed->textured : packed->untextured;
+
+		assert( mesh.indexStartIndex + mesh.indexCount <= in.size() );
+
+		auto const offset = std::size_t(align_up_( out.size(), kIndexAlign ));
+		auto const indexSize = packed_index_size( mesh.vertexCount );
+		out.resize( offset + mesh.indexCount * indexSize );
+
+		std::uint32_t const* src = in.data() + mesh.indexStartIndex;
+		std::uint8_t* dst = out.data() + offset;
+
+		if( sizeof(std::uint32_t) == indexSize )
+		{
+			if( mesh.indexCount )
+				std::memcpy( dst, src, mesh.indexCount * sizeof(std::uint32_t) );
+		}
+		else
+		{
+			for( std::size_t i = 0; i < mesh.indexCount; ++i )
+			{
+				assert( src[i] <= 0xffff );
+
+				auto const index = std::uint16_t(src[i]);
+				std::memcpy( dst + i*sizeof(std::uint16_t), &index, sizeof(std::uint16_t) );
+			}
+		}
+
+		ret.indexOffsets.emplace_back( offset );
+	}
+
+	ret.textured.positions    = view_<glm::vec3>( model.dataTextured.positions );
+	ret.textured.texcoords    = view_<glm::vec2>( model.dataTextured.texcoords );
+	ret.textured.indices      = view_<std::uint8_t>( packed->textured );
+
+	ret.untextured.positions  = view_<glm::vec3>( model.dataUntextured.positions );
+	ret.untextured.colors     = view_<glm::vec3>( model.dataUntextured.colors );
+	ret.untextured.indices    = view_<std::uint8_t>( packed->untextured );
+
+	ret.storage = std::move(packed);
+	return ret;
+}
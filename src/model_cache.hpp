@@ -0,0 +1,111 @@
+#ifndef MODEL_CACHE_HPP_5A0E3C71_9D2B_4F6A_B1E8_2C47D9A3F610
+#define MODEL_CACHE_HPP_5A0E3C71_9D2B_4F6A_B1E8_2C47D9A3F610
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <cstddef>
+#include <cstdint>
+
+#include <glm/vec2.hpp>
+#include <glm/vec3.hpp>
+
+#include "simple_model.hpp"
+
+// Binary mesh cache
+//
+// Parsing and triangulating a large OBJ file dominates start-up time. The
+// functions below store the final model (materials, mesh table and the raw
+// vertex/index arrays) in a binary file next to the OBJ file. The arrays
+// are stored in the layout that is uploaded to the GPU: vertex arrays as in
+// SimpleModel, and each mesh's indices already packed to 16 or 32 bits (see
+// packed_index_size()). Loading a cached model maps the file into memory;
+// the arrays are uploaded straight from the mapping without being copied or
+// touched on the CPU first.
+//
+// A cache file is only used if its format version matches and if the source
+// path, size and modification time of the OBJ file match the ones recorded
+// in the cache. Otherwise the OBJ file is loaded and the cache is rewritten.
+// Models loaded with and without aMergeByMaterial (see load_model_obj.hpp)
+// are cached in separate files.
+//
+// The header, string table, material table and mesh table are protected by
+// a checksum, and every count, offset and range read from them is checked
+// against the file size. The bulk vertex and index arrays are not checked
+// value by value (doing so would touch every byte on each load); the cache
+// is written to a temporary file and only moved into place once complete.
+//
+// The cache is not portable between machines with different endianness.
+std::string model_cache_path( char const* aObjPath, bool aMergeByMaterial );
+
+// Size in bytes (2 or 4) of each packed index of a mesh with aVertexCount
+// vertices.
+std::size_t packed_index_size( std::size_t aVertexCount );
+
+// Read-only view of an array owned by a CachedModel
+template< typename tType >
+struct CachedArray
+{
+	tType const* data = nullptr;
+	std::size_t count = 0;
+
+	tType const& operator[] ( std::size_t aIndex ) const { return data[aIndex]; }
+};
+
+// A model ready for upload.
+//
+// `model` holds the source path, materials and meshes. Its vertex and index
+// vectors are only filled if the model was parsed from the OBJ file; use the
+// arrays below instead, which are valid in both cases. They point either
+// into the memory-mapped cache file or into `model`, and stay valid for as
+// long as the CachedModel exists.
+//
+// Mesh `i` finds its packed indices at byte offset `indexOffsets[i]` in the
+// `indices` array of its data block. The offset is a multiple of four.
+struct CachedModel
+{
+	CachedModel() = default;
+
+	CachedModel( CachedModel const& ) = delete;
+	CachedModel& operator= ( CachedModel const& ) = delete;
+
+	CachedModel( CachedModel&& ) = default;
+	CachedModel& operator= ( CachedModel&& ) = default;
+
+	SimpleModel model;
+
+	struct Textured_
+	{
+		CachedArray<glm::vec3> positions;
+		CachedArray<glm::vec2> texcoords;
+		CachedArray<std::uint8_t> indices;
+	} textured;
+
+	struct Untextured_
+	{
+		CachedArray<glm::vec3> positions;
+		CachedArray<glm::vec3> colors;
+		CachedArray<std::uint8_t> indices;
+	} untextured;
+
+	std::vector<std::uint64_t> indexOffsets;
+
+	// Keeps the storage behind the arrays alive (file mapping or packed
+	// indices)
+	std::shared_ptr<void const> storage;
+};
+
+// Load a Wavefront OBJ model, using the binary cache when it is valid.
+CachedModel load_cached_wavefront_obj( char const* aObjPath, bool aMergeByMaterial = false );
+
+// Low-level access. try_load_model_cache() returns false if the cache does
+// not exist or does not match the source file. write_model_cache() returns
+// false if the cache could not be written; this is not a fatal error.
+bool try_load_model_cache( char const* aObjPath, bool aMergeByMaterial, CachedModel& aModel );
+bool write_model_cache( char const* aObjPath, bool aMergeByMaterial, CachedModel const& aModel );
+
+// Prepare a freshly parsed model for upload (and for write_model_cache())
+CachedModel make_cached_model( SimpleModel aModel );
+
+#endif // MODEL_CACHE_HPP_5A0E3C71_9D2B_4F6A_B1E8_2C47D9A3F610
@@ -13,6 +13,9 @@ layout (set = 0, binding = 0) uniform UScene
 layout(location = 0) out vec3 color;
 
 
+//Must match depthOnly.vert for the depth pre-pass
+invariant gl_Position;
+
 void main()
 {
 	color = iColor;
@@ -12,9 +12,16 @@ layout (set = 0, binding = 0) uniform UScene
 
 layout(location = 0) out vec2 v2fTexCoord;
 
+//Index into the texture array, passed as the draw's firstInstance
+layout(location = 1) flat out uint v2fTextureIndex;
+
+
+//Must match depthOnly.vert for the depth pre-pass
+invariant gl_Position;
 
 void main()
 {
 	v2fTexCoord = iTexCoord;
+	v2fTextureIndex = uint(gl_InstanceIndex);
 	gl_Position = uScene.projCam * vec4(iPosition, 1.f);
 }
\ No newline at end of file
@@ -0,0 +1,16 @@
+#version 450
+
+layout (location = 0) in vec2 v2fTexCoord;
+
+//The draw's texture, see create_object_descriptor_layout(). Used when the
+//device does not support descriptor indexing; each texture then has its own
+//descriptor set. The sampler is bound separately and shared by all textures.
+layout(set = 1, binding = 0) uniform texture2D uTexture;
+layout(set = 2, binding = 0) uniform sampler uSampler;
+
+layout(location = 0) out vec4 oColor;
+
+void main()
+{
+	oColor = vec4(texture(sampler2D(uTexture, uSampler), v2fTexCoord).rgb, 1.f);
+}
\ No newline at end of file
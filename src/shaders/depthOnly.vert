@@ -0,0 +1,20 @@
+#version 450
+
+layout (location = 0) in vec3 iPosition;
+
+layout (set = 0, binding = 0) uniform UScene
+{
+	mat4 camera;
+	mat4 projection;
+	mat4 projCam;
+}	uScene;
+
+//The colour pass tests against this depth with EQUAL, so the position must
+//be computed exactly as in the other vertex shaders
+invariant gl_Position;
+
+
+void main()
+{
+	gl_Position = uScene.projCam * vec4(iPosition, 1.f);
+}
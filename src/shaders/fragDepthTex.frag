@@ -1,8 +1,7 @@
 #version 450
 
 layout (location = 0) in vec2 v2fTexCoord;
-
-layout(set = 1, binding = 0) uniform sampler2D uTexColor;
+layout (location = 1) flat in uint v2fTextureIndex;
 
 layout(location = 0) out vec4 oColor;
 
@@ -1,8 +1,14 @@
 #version 450
+#extension GL_EXT_nonuniform_qualifier : require
 
 layout (location = 0) in vec2 v2fTexCoord;
+layout (location = 1) flat in uint v2fTextureIndex;
 
-layout(set = 1, binding = 0) uniform sampler2D uTexColor;
+//All textures, see create_object_descriptor_layout(). The index is the same
+//for the whole draw, so it does not need nonuniformEXT(). The sampler is
+//bound separately and shared by all textures.
+layout(set = 1, binding = 0) uniform texture2D uTextures[];
+layout(set = 2, binding = 0) uniform sampler uSampler;
 
 layout(location = 0) out vec4 oColor;
 
@@ -22,7 +28,7 @@ void main()
 	
 
 	//Extract mipmap level
-	vec2 lodInfo = textureQueryLod(uTexColor, v2fTexCoord);
+	vec2 lodInfo = textureQueryLod(sampler2D(uTextures[v2fTextureIndex], uSampler), v2fTexCoord);
 	int mipmapLevel = int(floor(lodInfo.y));
 
 	//Wrap around the levels back to the start
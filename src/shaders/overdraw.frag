@@ -0,0 +1,13 @@
+#version 450
+
+//Run the depth test before the shader, so that only the fragments that are
+//actually shaded are counted. Without this, writing to a storage image
+//disables early depth testing.
+layout(early_fragment_tests) in;
+
+layout(set = 1, binding = 0, r32ui) uniform coherent uimage2D uOverdraw;
+
+void main()
+{
+	imageAtomicAdd(uOverdraw, ivec2(gl_FragCoord.xy), 1u);
+}
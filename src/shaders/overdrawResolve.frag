@@ -0,0 +1,32 @@
+#version 450
+
+layout(set = 1, binding = 0, r32ui) uniform readonly uimage2D uOverdraw;
+
+layout(location = 0) out vec4 oColor;
+
+//Number of fragments per pixel that maps to the end of the ramp
+const float kMaxOverdraw = 8.f;
+
+//Heat ramp: black (nothing drawn), blue (drawn once), cyan, green, yellow,
+//red (kMaxOverdraw or more)
+const vec3 kRamp[6] = vec3[](
+	vec3(0.f, 0.f, 0.f),
+	vec3(0.f, 0.f, 1.f),
+	vec3(0.f, 1.f, 1.f),
+	vec3(0.f, 1.f, 0.f),
+	vec3(1.f, 1.f, 0.f),
+	vec3(1.f, 0.f, 0.f)
+);
+
+void main()
+{
+	uint count = imageLoad(uOverdraw, ivec2(gl_FragCoord.xy)).r;
+
+	//Zero and one map exactly onto the first two entries
+	float t = count <= 1u
+		? float(count)
+		: 1.f + 4.f * clamp((float(count) - 1.f) / (kMaxOverdraw - 1.f), 0.f, 1.f);
+
+	int i = min(int(t), 4);
+	oColor = vec4(mix(kRamp[i], kRamp[i + 1], t - float(i)), 1.f);
+}
@@ -0,0 +1,8 @@
+#version 450
+
+//Fullscreen triangle, generated from the vertex index (no vertex buffers)
+void main()
+{
+	vec2 uv = vec2((gl_VertexIndex << 1) & 2, gl_VertexIndex & 2);
+	gl_Position = vec4(uv * 2.f - 1.f, 0.f, 1.f);
+}
@@ -39,7 +39,19 @@ struct SimpleMaterialInfo
 // `SimpleModel::dataTextured::texcoords` arrays. For untextured meshes
 // (`textured` set to `false`), the vertices are instead found in the
 // `SimpleModel::dataUntextured::positions` array (and do not have any texture
-// coordinates).
+// coordinates). Untextured vertices additionally carry their material's
+// diffuse color in `SimpleModel::dataUntextured::colors`, so that the arrays
+// can be uploaded to the GPU as-is.
+//
+// Vertices are deduplicated when loading, so meshes are indexed. The mesh's
+// indices are found in the `indices` array of the same data block, starting
+// at `indexStartIndex` and spanning `indexCount` entries. Indices are
+// relative to the mesh's first vertex (i.e., an index of 0 refers to the
+// vertex at `vertexStartIndex`). Every three indices form a triangle.
+//
+// Each mesh has an axis-aligned bounding box (`aabbMin`, `aabbMax`) and a
+// bounding sphere (`sphereCenter`, `sphereRadius`) in model space, which can
+// be used for visibility culling.
 struct SimpleMeshInfo
 {
 	std::string meshName;  // This is purely informational and for debugging
@@ -50,6 +62,15 @@ struct SimpleMeshInfo
 
 	std::size_t vertexStartIndex;
 	std::size_t vertexCount;
+
+	std::size_t indexStartIndex;
+	std::size_t indexCount;
+
+	glm::vec3 aabbMin;
+	glm::vec3 aabbMax;
+
+	glm::vec3 sphereCenter;
+	float sphereRadius;
 };
 
 // Simple model.
@@ -67,11 +88,14 @@ struct SimpleModel
 	{
 		std::vector<glm::vec3> positions;
 		std::vector<glm::vec2> texcoords;
+		std::vector<std::uint32_t> indices;
 	} dataTextured;
 
 	struct Data2_
 	{
 		std::vector<glm::vec3> positions;
+		std::vector<glm::vec3> colors;
+		std::vector<std::uint32_t> indices;
 	} dataUntextured;
 };
 
@@ -0,0 +1,473 @@
+// Offline texture converter
+//
+// Converts images (JPEG, PNG, ...) to the .btex container (see
+// labutils/btex.hpp): BC1 compressed, with a full mip chain. Mip levels are
+// filtered in linear space, and then encoded back to sRGB.
+//
+// Usage:
+//   texconv [--force] [files or directories...]
+//
+// Directories are searched recursively for .jpg/.jpeg/.png/.tga/.bmp
+// images. Without arguments, assets/src/textures is converted. Each image
+// "foo.jpg" produces "foo.jpg.btex" next to it. Outputs that are newer than
+// their source are skipped, unless --force is given.
+
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <chrono>
+#include <limits>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <exception>
+#include <filesystem>
+#include <stdexcept>
+#include <system_error>
+
+#include <cctype>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+
+#include <stb_image.h>
+
+#include "../../labutils/btex.hpp"
+#include "../../labutils/parallel.hpp"
+namespace lut = labutils;
+namespace fs = std::filesystem;
+
+namespace
+{
+	struct Rgba8
+	{
+		std::uint8_t r, g, b, a;
+	};
+
+	struct LinearImage
+	{
+		std::uint32_t width = 0, height = 0;
+		std::vector<float> texels; //RGBA, linear color, linear alpha
+	};
+
+	//sRGB <-> linear conversion
+	float srgb_to_linear(float aValue)
+	{
+		return aValue <= 0.04045f ? aValue / 12.92f : std::pow((aValue + 0.055f) / 1.055f, 2.4f);
+	}
+	float linear_to_srgb(float aValue)
+	{
+		return aValue <= 0.0031308f ? aValue * 12.92f : 1.055f * std::pow(aValue, 1.f / 2.4f) - 0.055f;
+	}
+
+	std::uint8_t to_unorm8(float aValue)
+	{
+		return std::uint8_t(std::clamp(aValue, 0.f, 1.f) * 255.f + 0.5f);
+	}
+
+	LinearImage to_linear(Rgba8 const* aTexels, std::uint32_t aWidth, std::uint32_t aHeight)
+	{
+		static auto const kLut = [] {
+			std::array<float, 256> ret{};
+			for (std::size_t i = 0; i < 256; ++i)
+				ret[i] = srgb_to_linear(float(i) / 255.f);
+			return ret;
+		}();
+
+		LinearImage ret;
+		ret.width = aWidth;
+		ret.height = aHeight;
+		ret.texels.resize(std::size_t(aWidth) * aHeight * 4);
+
+		for (std::size_t i = 0; i < std::size_t(aWidth) * aHeight; ++i)
+		{
+			ret.texels[i * 4 + 0] = kLut[aTexels[i].r];
+			ret.texels[i * 4 + 1] = kLut[aTexels[i].g];
+			ret.texels[i * 4 + 2] = kLut[aTexels[i].b];
+			ret.texels[i * 4 + 3] = aTexels[i].a / 255.f;
+		}
+
+		return ret;
+	}
+
+	std::vector<Rgba8> to_srgb8(LinearImage const& aImage)
+	{
+		std::vector<Rgba8> ret(std::size_t(aImage.width) * aImage.height);
+		for (std::size_t i = 0; i < ret.size(); ++i)
+		{
+			ret[i].r = to_unorm8(linear_to_srgb(aImage.texels[i * 4 + 0]));
+			ret[i].g = to_unorm8(linear_to_srgb(aImage.texels[i * 4 + 1]));
+			ret[i].b = to_unorm8(linear_to_srgb(aImage.texels[i * 4 + 2]));
+			ret[i].a = to_unorm8(aImage.texels[i * 4 + 3]);
+		}
+		return ret;
+	}
+
+	//Next mip level with a 2x2 box filter. Odd sizes clamp at the edge.
+	LinearImage downsample(LinearImage const& aSrc)
+	{
+		LinearImage ret;
+		ret.width = std::max(1u, aSrc.width / 2);
+		ret.height = std::max(1u, aSrc.height / 2);
+		ret.texels.resize(std::size_t(ret.width) * ret.height * 4);
+
+		for (std::uint32_t y = 0; y < ret.height; ++y)
+		{
+			std::uint32_t const y0 = std::min(2 * y, aSrc.height - 1);
+			std::uint32_t const y1 = std::min(2 * y + 1, aSrc.height - 1);
+
+			for (std::uint32_t x = 0; x < ret.width; ++x)
+			{
+				std::uint32_t const x0 = std::min(2 * x, aSrc.width - 1);
+				std::uint32_t const x1 = std::min(2 * x + 1, aSrc.width - 1);
+
+				for (std::uint32_t c = 0; c < 4; ++c)
+				{
+					float const sum = aSrc.texels[(std::size_t(y0) * aSrc.width + x0) * 4 + c]
+						+ aSrc.texels[(std::size_t(y0) * aSrc.width + x1) * 4 + c]
+						+ aSrc.texels[(std::size_t(y1) * aSrc.width + x0) * 4 + c]
+						+ aSrc.texels[(std::size_t(y1) * aSrc.width + x1) * 4 + c];
+
+					ret.texels[(std::size_t(y) * ret.width + x) * 4 + c] = sum * 0.25f;
+				}
+			}
+		}
+
+		return ret;
+	}
+
+	//BC1 helpers
+	std::uint16_t pack_565(float aR, float aG, float aB)
+	{
+		auto const r = std::uint16_t(std::clamp(aR, 0.f, 255.f) * 31.f / 255.f + 0.5f);
+		auto const g = std::uint16_t(std::clamp(aG, 0.f, 255.f) * 63.f / 255.f + 0.5f);
+		auto const b = std::uint16_t(std::clamp(aB, 0.f, 255.f) * 31.f / 255.f + 0.5f);
+		return std::uint16_t((r << 11) | (g << 5) | b);
+	}
+
+	std::array<int, 3> unpack_565(std::uint16_t aColor)
+	{
+		int const r = (aColor >> 11) & 31;
+		int const g = (aColor >> 5) & 63;
+		int const b = aColor & 31;
+		return { (r << 3) | (r >> 2), (g << 2) | (g >> 4), (b << 3) | (b >> 2) };
+	}
+
+	//Encode one 4x4 block. Endpoints are chosen along the principal axis of
+	//the block's colors. Blocks with transparent texels use BC1's 3-color
+	//mode, where index 3 is transparent black.
+	void encode_bc1_block(Rgba8 const aBlock[16], std::uint8_t aOut[8])
+	{
+		bool transparent[16];
+		float mean[3] = {};
+		int opaqueCount = 0;
+
+		for (int i = 0; i < 16; ++i)
+		{
+			transparent[i] = aBlock[i].a < 128;
+			if (transparent[i])
+				continue;
+
+			mean[0] += aBlock[i].r;
+			mean[1] += aBlock[i].g;
+			mean[2] += aBlock[i].b;
+			++opaqueCount;
+		}
+
+		bool const threeColor = opaqueCount < 16;
+
+		//Fully transparent block
+		if (0 == opaqueCount)
+		{
+			std::uint16_t const c0 = 0, c1 = 0;
+			std::uint32_t const indices = 0xffffffffu;
+			std::memcpy(aOut + 0, &c0, 2);
+			std::memcpy(aOut + 2, &c1, 2);
+			std::memcpy(aOut + 4, &indices, 4);
+			return;
+		}
+
+		for (float& m : mean)
+			m /= float(opaqueCount);
+
+		//Covariance of the opaque texels
+		float cov[6] = {};
+		for (int i = 0; i < 16; ++i)
+		{
+			if (transparent[i])
+				continue;
+
+			float const d[3] = { aBlock[i].r - mean[0], aBlock[i].g - mean[1], aBlock[i].b - mean[2] };
+			cov[0] += d[0] * d[0]; cov[1] += d[0] * d[1]; cov[2] += d[0] * d[2];
+			cov[3] += d[1] * d[1]; cov[4] += d[1] * d[2]; cov[5] += d[2] * d[2];
+		}
+
+		//Principal axis by power iteration
+		float axis[3] = { 1.f, 1.f, 1.f };
+		for (int iter = 0; iter < 8; ++iter)
+		{
+			float const next[3] = {
+				cov[0] * axis[0] + cov[1] * axis[1] + cov[2] * axis[2],
+				cov[1] * axis[0] + cov[3] * axis[1] + cov[4] * axis[2],
+				cov[2] * axis[0] + cov[4] * axis[1] + cov[5] * axis[2]
+			};
+
+			float const len = std::sqrt(next[0] * next[0] + next[1] * next[1] + next[2] * next[2]);
+			if (len < 1e-6f)
+				break;
+
+			for (int c = 0; c < 3; ++c)
+				axis[c] = next[c] / len;
+		}
+
+		//Project onto the axis to find the extremes
+		float tMin = 0.f, tMax = 0.f;
+		for (int i = 0; i < 16; ++i)
+		{
+			if (transparent[i])
+				continue;
+
+			float const t = (aBlock[i].r - mean[0]) * axis[0] + (aBlock[i].g - mean[1]) * axis[1] + (aBlock[i].b - mean[2]) * axis[2];
+			tMin = std::min(tMin, t);
+			tMax = std::max(tMax, t);
+		}
+
+		std::uint16_t c0 = pack_565(mean[0] + tMax * axis[0], mean[1] + tMax * axis[1], mean[2] + tMax * axis[2]);
+		std::uint16_t c1 = pack_565(mean[0] + tMin * axis[0], mean[1] + tMin * axis[1], mean[2] + tMin * axis[2]);
+
+		//The endpoint order selects the mode: c0 > c1 is 4-color mode,
+		//c0 <= c1 is 3-color mode (with transparency)
+		if (threeColor ? c0 > c1 : c0 < c1)
+			std::swap(c0, c1);
+
+		auto const e0 = unpack_565(c0);
+		auto const e1 = unpack_565(c1);
+
+		std::array<int, 3> palette[4];
+		palette[0] = e0;
+		palette[1] = e1;
+
+		int paletteSize = 4;
+		if (threeColor || c0 == c1)
+		{
+			for (int c = 0; c < 3; ++c)
+				palette[2][c] = (e0[c] + e1[c]) / 2;
+			paletteSize = 3;
+		}
+		else
+		{
+			for (int c = 0; c < 3; ++c)
+			{
+				palette[2][c] = (2 * e0[c] + e1[c]) / 3;
+				palette[3][c] = (e0[c] + 2 * e1[c]) / 3;
+			}
+		}
+
+		std::uint32_t indices = 0;
+		for (int i = 0; i < 16; ++i)
+		{
+			std::uint32_t best = 3;
+			if (!transparent[i])
+			{
+				int bestDist = std::numeric_limits<int>::max();
+				for (int p = 0; p < paletteSize; ++p)
+				{
+					int const dr = aBlock[i].r - palette[p][0];
+					int const dg = aBlock[i].g - palette[p][1];
+					int const db = aBlock[i].b - palette[p][2];
+					int const dist = dr * dr + dg * dg + db * db;
+					if (dist < bestDist)
+					{
+						bestDist = dist;
+						best = std::uint32_t(p);
+					}
+				}
+			}
+
+			indices |= best << (2 * i);
+		}
+
+		//Block layout is little-endian
+		aOut[0] = std::uint8_t(c0 & 0xff); aOut[1] = std::uint8_t(c0 >> 8);
+		aOut[2] = std::uint8_t(c1 & 0xff); aOut[3] = std::uint8_t(c1 >> 8);
+		for (int i = 0; i < 4; ++i)
+			aOut[4 + i] = std::uint8_t(indices >> (8 * i));
+	}
+
+	std::vector<std::uint8_t> encode_bc1(std::vector<Rgba8> const& aTexels, std::uint32_t aWidth, std::uint32_t aHeight)
+	{
+		std::uint32_t const blocksX = (aWidth + 3) / 4;
+		std::uint32_t const blocksY = (aHeight + 3) / 4;
+
+		std::vector<std::uint8_t> ret(lut::btex::bc1_level_size(aWidth, aHeight));
+
+		for (std::uint32_t by = 0; by < blocksY; ++by)
+		{
+			for (std::uint32_t bx = 0; bx < blocksX; ++bx)
+			{
+				//Gather the block; texels outside the image repeat the edge
+				Rgba8 block[16];
+				for (std::uint32_t y = 0; y < 4; ++y)
+				{
+					std::uint32_t const sy = std::min(by * 4 + y, aHeight - 1);
+					for (std::uint32_t x = 0; x < 4; ++x)
+					{
+						std::uint32_t const sx = std::min(bx * 4 + x, aWidth - 1);
+						block[y * 4 + x] = aTexels[std::size_t(sy) * aWidth + sx];
+					}
+				}
+
+				encode_bc1_block(block, ret.data() + (std::size_t(by) * blocksX + bx) * 8);
+			}
+		}
+
+		return ret;
+	}
+
+	void convert(fs::path const& aInput, fs::path const& aOutput)
+	{
+		int w, h, channels;
+		stbi_uc* data = stbi_load(aInput.string().c_str(), &w, &h, &channels, 4);
+		if (!data)
+			throw std::runtime_error(aInput.string() + ": unable to load image (" + stbi_failure_reason() + ")");
+
+		auto const width = std::uint32_t(w);
+		auto const height = std::uint32_t(h);
+
+		//Filter in linear space
+		LinearImage level = to_linear(reinterpret_cast<Rgba8 const*>(data), width, height);
+		std::vector<Rgba8> levelTexels(reinterpret_cast<Rgba8 const*>(data), reinterpret_cast<Rgba8 const*>(data) + std::size_t(width) * height);
+		stbi_image_free(data);
+
+		std::vector<std::vector<std::uint8_t>> levelData;
+		for (;;)
+		{
+			levelData.emplace_back(encode_bc1(levelTexels, level.width, level.height));
+
+			if (1 == level.width && 1 == level.height)
+				break;
+
+			level = downsample(level);
+			levelTexels = to_srgb8(level);
+		}
+
+		//Write the file
+		lut::btex::Header header{};
+		std::memcpy(header.magic, lut::btex::kMagic, sizeof(header.magic));
+		header.version = lut::btex::kVersion;
+		header.format = lut::btex::Format::bc1RgbaSrgb;
+		header.width = width;
+		header.height = height;
+		header.mipCount = std::uint32_t(levelData.size());
+
+		std::vector<lut::btex::Level> levels(levelData.size());
+
+		std::uint64_t offset = sizeof(header) + levels.size() * sizeof(lut::btex::Level);
+		for (std::size_t i = 0; i < levels.size(); ++i)
+		{
+			levels[i].offset = offset;
+			levels[i].size = levelData[i].size();
+			levels[i].width = std::max(1u, width >> i);
+			levels[i].height = std::max(1u, height >> i);
+			offset += levelData[i].size();
+		}
+
+		auto const tempPath = fs::path(aOutput.string() + ".tmp");
+
+		std::FILE* file = std::fopen(tempPath.string().c_str(), "wb");
+		if (!file)
+			throw std::runtime_error(tempPath.string() + ": unable to open for writing");
+
+		bool ok = 1 == std::fwrite(&header, sizeof(header), 1, file);
+		ok = ok && levels.size() == std::fwrite(levels.data(), sizeof(lut::btex::Level), levels.size(), file);
+		for (auto const& bytes : levelData)
+			ok = ok && 1 == std::fwrite(bytes.data(), bytes.size(), 1, file);
+
+		ok = (0 == std::fclose(file)) && ok;
+		if (!ok)
+		{
+			std::error_code ec;
+			fs::remove(tempPath, ec);
+			throw std::runtime_error(aOutput.string() + ": write failed");
+		}
+
+		fs::rename(tempPath, aOutput);
+	}
+
+	bool is_image(fs::path const& aPath)
+	{
+		auto ext = aPath.extension().string();
+		std::transform(ext.begin(), ext.end(), ext.begin(), [] (char c) { return char(std::tolower((unsigned char)c)); });
+		return ".jpg" == ext || ".jpeg" == ext || ".png" == ext || ".tga" == ext || ".bmp" == ext;
+	}
+}
+
+int main(int aArgc, char* aArgv[]) try
+{
+	bool force = false;
+	std::vector<fs::path> inputs;
+
+	for (int i = 1; i < aArgc; ++i)
+	{
+		if (0 == std::strcmp(aArgv[i], "--force"))
+			force = true;
+		else
+			inputs.emplace_back(aArgv[i]);
+	}
+
+	if (inputs.empty())
+		inputs.emplace_back("assets/src/textures");
+
+	//Collect images
+	std::vector<fs::path> images;
+	for (auto const& input : inputs)
+	{
+		if (fs::is_directory(input))
+		{
+			for (auto const& entry : fs::recursive_directory_iterator(input))
+			{
+				if (entry.is_regular_file() && is_image(entry.path()))
+					images.emplace_back(entry.path());
+			}
+		}
+		else
+		{
+			images.emplace_back(input);
+		}
+	}
+
+	std::sort(images.begin(), images.end());
+
+	//Must match the runtime loader, which flips images on load. This is a
+	//global stb_image setting, so set it before starting any threads.
+	stbi_set_flip_vertically_on_load(1);
+
+	auto const start = std::chrono::steady_clock::now();
+
+	std::atomic<std::size_t> converted{ 0 }, skipped{ 0 };
+	lut::parallel_for(images.size(), [&] (std::size_t aIndex) {
+		auto const& input = images[aIndex];
+		auto const output = fs::path(input.string() + lut::btex::kExtension);
+
+		std::error_code ec;
+		if (!force && fs::exists(output, ec) && fs::last_write_time(output, ec) >= fs::last_write_time(input, ec))
+		{
+			++skipped;
+			return;
+		}
+
+		convert(input, output);
+		std::fprintf(stderr, "  %s\n", output.string().c_str());
+		++converted;
+	});
+
+	auto const ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	std::fprintf(stderr, "Converted %zu images (%zu up to date) in %.1f ms\n", converted.load(), skipped.load(), ms);
+
+	return 0;
+}
+catch (std::exception const& eErr)
+{
+	std::fprintf(stderr, "Error: %s\n", eErr.what());
+	return 1;
+}